@@ -0,0 +1,13 @@
+set(BENCHMARK_ENABLE_TESTING OFF CACHE INTERNAL "")
+set(BENCHMARK_ENABLE_INSTALL OFF CACHE INTERNAL "")
+set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE INTERNAL "")
+FetchContent_Declare(com.github.google.benchmark
+  GIT_REPOSITORY https://github.com/google/benchmark.git
+  GIT_TAG        v1.7.1
+  GIT_SHALLOW    TRUE)
+FetchContent_MakeAvailable(com.github.google.benchmark)
+
+bottle_library(
+  NAME benchmark
+  DEPS benchmark::benchmark
+)
@@ -0,0 +1,17 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include "mcpt/misc/logging.hpp"
+
+int main(int argc, char* argv[]) {
+  mcpt::misc::InitLogger("bench_main", ".", false);
+  // keep the console for the benchmark reports
+  spdlog::set_level(spdlog::level::warn);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
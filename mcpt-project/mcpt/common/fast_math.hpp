@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace mcpt {
+
+/**
+ * polynomial approximations of the transcendental functions in the sampling routines, in single
+ * precision & with bounded errors
+ *
+ * the kernels have no branches & no table lookups, so the loops over them, i.e. the batch versions
+ * below, are vectorized by the compiler
+ */
+namespace fast_math {
+
+namespace detail {
+
+inline int32_t as_int(float x) {
+  int32_t bits;
+  std::memcpy(&bits, &x, sizeof(x));
+  return bits;
+}
+
+inline float as_float(int32_t bits) {
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+}  // namespace detail
+
+// log2(x) for positive normal x, absolute error below 2e-7 * max(1, |log2(x)|)
+inline float Log2(float x) {
+  // x = 2^e * m, with m in [sqrt(1/2), sqrt(2))
+  constexpr int32_t SQRT_HALF_BITS = 0x3F3504F3;
+  int32_t bits = detail::as_int(x);
+  int32_t e = (bits - SQRT_HALF_BITS) >> 23;
+  float m = detail::as_float(bits - e * (1 << 23));
+
+  // log2(m) = 2/ln(2) * atanh(s), with |s| <= 0.172
+  float s = (m - 1.0F) / (m + 1.0F);
+  float s2 = s * s;
+  float p = 2.8853900817779268F +
+            s2 * (0.9617966939259756F +
+                  s2 * (0.5770780163555853F +
+                        s2 * (0.4121985831111324F + s2 * 0.3205988979753252F)));
+  return float(e) + s * p;
+}
+
+// 2^x for |x| < 2^30, relative error below 2e-7, flushed to 0 below 2^-126.5 & saturated above
+// 2^127.5
+inline float Exp2(float x) {
+  // x = i + f, f in [-1/2, 1/2]
+  auto i = int32_t(x + (x < 0.0F ? -0.5F : 0.5F));
+  float f = x - float(i);
+  // clamp the exponent, not x, the conversion of a clamped float is not vectorized
+  i = i < -127 ? -127 : i;
+  i = i > 127 ? 127 : i;
+
+  // 2^f = exp(f * ln(2)), exact at f = 0
+  float p = 1.0F +
+            f * (0.6931471805599453F +
+                 f * (0.2402265069591007F +
+                      f * (0.05550410866482158F +
+                           f * (0.009618129107628477F +
+                                f * (0.0013333558146428443F +
+                                     f * (0.0001540353039338161F + f * 1.525273380405984e-05F))))));
+  // 2^-127 has all the exponent bits cleared, i.e. is 0
+  return p * detail::as_float((i + 127) << 23);
+}
+
+// x^y for x >= 0, relative error below 4e-7 + 2e-7 * |y * log2(x)|
+inline float Pow(float x, float y) {
+  // log2(0) = -127, so that 0^0 = 2^0 = 1, the other powers of 0 are masked out, by the bits as a
+  // select is not always vectorized
+  float r = Exp2(y * Log2(x));
+  int32_t mask = -int32_t(x > 0.0F || y == 0.0F);
+  return detail::as_float(detail::as_int(r) & mask);
+}
+
+// sin(x) & cos(x) for |x| <= 8192, absolute error below 2e-7
+inline void SinCos(float x, float& sin, float& cos) {
+  // x = k * pi/2 + r, r in [-pi/4, pi/4], with pi/2 split in 3 parts to keep k * pi/2 exact
+  constexpr float TWO_OVER_PI = 0.6366197723675814F;
+  constexpr float HALF_PI_1 = 1.5703125F;
+  constexpr float HALF_PI_2 = 4.837512969970703125e-4F;
+  constexpr float HALF_PI_3 = 7.54978995489188216e-8F;
+  float k_f = x * TWO_OVER_PI;
+  auto k = int32_t(k_f + (k_f < 0.0F ? -0.5F : 0.5F));
+  k_f = float(k);
+  float r = ((x - k_f * HALF_PI_1) - k_f * HALF_PI_2) - k_f * HALF_PI_3;
+
+  float r2 = r * r;
+  float sin_r = r + r * r2 *
+                        (-1.6666666666666666e-1F +
+                         r2 * (8.333333333333333e-3F +
+                               r2 * (-1.984126984126984e-4F + r2 * 2.755731922398589e-6F)));
+  float cos_r = 1.0F + r2 * (-0.5F + r2 * (4.1666666666666664e-2F +
+                                           r2 * (-1.388888888888889e-3F +
+                                                 r2 * 2.48015873015873e-5F)));
+
+  // rotate by k quarter turns
+  bool swap = k & 1;
+  float s = swap ? cos_r : sin_r;
+  float c = swap ? sin_r : cos_r;
+  sin = (k & 2) ? -s : s;
+  cos = ((k + 1) & 2) ? -c : c;
+}
+
+inline void Pow(const float* x, float y, float* out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = Pow(x[i], y);
+}
+
+inline void Pow(const float* x, const float* y, float* out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = Pow(x[i], y[i]);
+}
+
+inline void SinCos(const float* x, float* sin, float* cos, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    SinCos(x[i], sin[i], cos[i]);
+}
+
+}  // namespace fast_math
+
+// the batch functions, which take the vectorized fast_math kernels in single precision if built
+// with MCPT_FAST_MATH, the standard library functions otherwise
+//
+// NOTE the scalar kernels alone are slower than those of glibc, so only the batches are dispatched
+namespace math {
+
+#ifdef MCPT_FAST_MATH
+inline constexpr bool FAST_MATH = true;
+#else
+inline constexpr bool FAST_MATH = false;
+#endif
+
+template <typename T>
+void Pow(const T* x, T y, T* out, size_t n) {
+  if constexpr (FAST_MATH && std::is_same_v<T, float>) {
+    fast_math::Pow(x, y, out, n);
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = std::pow(x[i], y);
+  }
+}
+
+template <typename T>
+void Pow(const T* x, const T* y, T* out, size_t n) {
+  if constexpr (FAST_MATH && std::is_same_v<T, float>) {
+    fast_math::Pow(x, y, out, n);
+  } else {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = std::pow(x[i], y[i]);
+  }
+}
+
+template <typename T>
+void SinCos(const T* x, T* sin, T* cos, size_t n) {
+  if constexpr (FAST_MATH && std::is_same_v<T, float>) {
+    fast_math::SinCos(x, sin, cos, n);
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      sin[i] = std::sin(x[i]);
+      cos[i] = std::cos(x[i]);
+    }
+  }
+}
+
+}  // namespace math
+
+}  // namespace mcpt
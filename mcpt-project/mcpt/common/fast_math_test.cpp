@@ -0,0 +1,87 @@
+#include "mcpt/common/fast_math.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("fast math kernels have bounded errors", "[fast_math]") {
+
+SECTION("log2 of normal floats") {
+  double max_error = 0.0;
+  // every 97th float, to cover all the exponents & mantissas
+  for (uint32_t bits = 0x00800000U; bits < 0x7F800000U; bits += 97U) {
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    double expected = std::log2(double(x));
+    double error = std::abs(mcpt::fast_math::Log2(x) - expected);
+    max_error = std::max(max_error, error / std::max(1.0, std::abs(expected)));
+  }
+  CHECK(max_error < 2.0e-7);
+}
+
+SECTION("exp2 in the normal range") {
+  double max_error = 0.0;
+  for (double x = -125.9; x < 127.4; x += 1.0e-4) {
+    double expected = std::exp2(double(float(x)));
+    max_error = std::max(max_error, std::abs(mcpt::fast_math::Exp2(x) - expected) / expected);
+  }
+  CHECK(max_error < 2.0e-7);
+  CHECK(mcpt::fast_math::Exp2(-200.0F) == 0.0F);
+}
+
+SECTION("pow of the cosines") {
+  double max_excess = 0.0;
+  for (float y : {0.5F, 1.0F, 2.0F, 7.3F, 50.0F, 1000.0F}) {
+    for (int i = 1; i <= 100000; ++i) {
+      float x = float(i) / 100000.0F;
+      double expected = std::pow(double(x), double(y));
+      if (expected < 1.0e-37)
+        continue;
+      double error = std::abs(mcpt::fast_math::Pow(x, y) - expected) / expected;
+      double bound = 4.0e-7 + 2.0e-7 * std::abs(y * std::log2(double(x)));
+      max_excess = std::max(max_excess, error - bound);
+    }
+  }
+  CHECK(max_excess <= 0.0);
+  CHECK(mcpt::fast_math::Pow(0.0F, 2.0F) == 0.0F);
+  CHECK(mcpt::fast_math::Pow(0.0F, 0.0F) == 1.0F);
+  CHECK(mcpt::fast_math::Pow(1.0F, 1000.0F) == 1.0F);
+}
+
+SECTION("sin & cos over the reduced domain") {
+  double max_error = 0.0;
+  for (double x = -8192.0; x <= 8192.0; x += 1.0e-3) {
+    float sin;
+    float cos;
+    mcpt::fast_math::SinCos(float(x), sin, cos);
+    max_error = std::max(max_error, std::abs(sin - std::sin(double(float(x)))));
+    max_error = std::max(max_error, std::abs(cos - std::cos(double(float(x)))));
+  }
+  CHECK(max_error < 2.0e-7);
+}
+
+// the vectorized loops may contract the multiply-adds differently
+SECTION("batch versions match the scalar kernels") {
+  std::vector<float> x;
+  for (int i = 0; i < 1000; ++i)
+    x.push_back(float(i) / 1000.0F);
+  std::vector<float> pow(x.size());
+  std::vector<float> sin(x.size());
+  std::vector<float> cos(x.size());
+  mcpt::fast_math::Pow(x.data(), 3.5F, pow.data(), x.size());
+  mcpt::fast_math::SinCos(x.data(), sin.data(), cos.data(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    float s;
+    float c;
+    mcpt::fast_math::SinCos(x[i], s, c);
+    CHECK(std::abs(pow[i] - mcpt::fast_math::Pow(x[i], 3.5F)) <= 1.0e-6F);
+    CHECK(std::abs(sin[i] - s) <= 1.0e-6F);
+    CHECK(std::abs(cos[i] - c) <= 1.0e-6F);
+  }
+}
+
+}
@@ -35,6 +35,12 @@ public:
 
   Eigen::Matrix<T, 3, 1> GetDiagonal() const { return m_max_vertex - m_min_vertex; };
 
+  // zero for the empty box
+  T GetSurfaceArea() const {
+    Eigen::Matrix<T, 3, 1> d = GetDiagonal().cwiseMax(T(0));
+    return T(2) * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+  }
+
 private:
   using Vector3 = Eigen::Matrix<T, 3, 1>;
 
@@ -83,4 +83,11 @@ SECTION("test envelop") {
   REQUIRE(aabb.GetDiagonal() == Vector3::Constant(2.0));
 }
 
+SECTION("surface area") {
+  CHECK(AABB{}.GetSurfaceArea() == 0.0);
+  CHECK(AABB(Vector3::Ones(), Vector3::Ones()).GetSurfaceArea() == 0.0);
+  CHECK(AABB(Vector3::Zero(), Vector3(1.0, 2.0, 0.0)).GetSurfaceArea() == 4.0);
+  CHECK(AABB(-Vector3::Ones(), Vector3::Ones()).GetSurfaceArea() == 24.0);
+}
+
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/assert.hpp"
+
+#include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/bvh_tree.hpp"
+
+namespace mcpt {
+
+// a bottom level BVH tree placed in the world by an affine transform
+// the leaves of the top level BVH tree refer to the instances (cref), so that the meshes of the
+// bottom level tree are shared by all the instances
+template <typename T>
+struct BVHInstance {
+  using Scalar = T;
+  using Transform = Eigen::Transform<T, 3, Eigen::Affine>;
+
+  std::reference_wrapper<const BVHTree<T>> bvh_tree;
+
+  Transform to_world;
+  Transform to_local;
+  // inverse transpose of the linear part, maps the local normals to the world space
+  Eigen::Matrix<T, 3, 3> normal_to_world;
+
+  // bounding box of the transformed bottom level tree in the world space
+  AABB<T> aabb;
+
+  BVHInstance(const BVHTree<T>& bvh_tree, const Eigen::Matrix<T, 3, 4>& transform);
+};
+
+template <typename T>
+BVHInstance<T>::BVHInstance(const BVHTree<T>& bvh_tree, const Eigen::Matrix<T, 3, 4>& transform)
+    : bvh_tree(bvh_tree) {
+  DASSERT(bvh_tree.root, "bottom level BVH tree must be constructed before instancing");
+  to_world.matrix().template topRows<3>() = transform;
+  to_world.matrix().row(3) << 0, 0, 0, 1;
+  ASSERT(to_world.linear().determinant() != 0, "instance transform must be invertible");
+  to_local = to_world.inverse(Eigen::Affine);
+  normal_to_world = to_local.linear().transpose();
+
+  // transform the corners of the bottom level bounding box
+  const auto& local_aabb = bvh_tree.root->aabb;
+  for (int i = 0; i < 8; ++i) {
+    Eigen::Matrix<T, 3, 1> corner;
+    for (int axis = 0; axis < 3; ++axis) {
+      corner.coeffRef(axis) = (i >> axis) & 1 ? local_aabb.max_vertex().coeff(axis)
+                                              : local_aabb.min_vertex().coeff(axis);
+    }
+    aabb.Update(to_world * corner);
+  }
+}
+
+}  // namespace mcpt
@@ -5,6 +5,7 @@
 #include <iterator>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <Eigen/Eigen>
 
@@ -26,14 +27,30 @@ struct BVHNode {
   // only leaf nodes have corresponding mesh (cref)
   std::any mesh;
 
-  std::unique_ptr<const BVHNode> l_child;
-  std::unique_ptr<const BVHNode> r_child;
+  // SAH cost at the last (re)build, i.e. the expected number of nodes visited by a ray which hits
+  // the current node, taking the same cost for traversal steps & intersection tests
+  T sah_cost = T(1);
+
+  std::unique_ptr<BVHNode> l_child;
+  std::unique_ptr<BVHNode> r_child;
 
   BVHNode() = default;
   explicit BVHNode(const AABB<T>& aabb) : aabb(aabb) {}
 
   template <typename InputIt>
   void Split(InputIt first, InputIt last);
+
+  // update the bounds bottom-up by `leaf_bounds(mesh) -> AABB<T>', the subtrees whose SAH cost
+  // grows more than `max_cost_ratio' times are rebuilt, return the SAH cost after refitting
+  template <typename LeafBounds>
+  T Refit(const LeafBounds& leaf_bounds, T max_cost_ratio, size_t& num_rebuilt_leaves);
+
+  // SAH cost of the current node given the SAH costs of the children
+  T GetSAHCost(T l_cost, T r_cost) const;
+
+private:
+  static void ReleaseLeaves(std::unique_ptr<BVHNode>& node,
+                            std::vector<std::unique_ptr<BVHNode>>& leaves);
 };
 
 template <typename T>
@@ -76,6 +93,57 @@ void BVHNode<T>::Split(InputIt first, InputIt last) {
     node->Split(first + l, last);
     r_child = std::move(node);
   }
+
+  sah_cost = GetSAHCost(l_child->sah_cost, r_child->sah_cost);
+}
+
+template <typename T>
+template <typename LeafBounds>
+T BVHNode<T>::Refit(const LeafBounds& leaf_bounds, T max_cost_ratio, size_t& num_rebuilt_leaves) {
+  if (mesh.has_value()) {
+    aabb = leaf_bounds(std::as_const(mesh));
+    return sah_cost;
+  }
+
+  T l_cost = l_child->Refit(leaf_bounds, max_cost_ratio, num_rebuilt_leaves);
+  T r_cost = r_child->Refit(leaf_bounds, max_cost_ratio, num_rebuilt_leaves);
+  aabb = l_child->aabb;
+  aabb.Update(r_child->aabb);
+
+  T cost = GetSAHCost(l_cost, r_cost);
+  if (cost <= sah_cost * max_cost_ratio)
+    return cost;
+
+  // the children overlap too much after moving, rebuild the subtree
+  std::vector<std::unique_ptr<BVHNode>> leaves;
+  ReleaseLeaves(l_child, leaves);
+  ReleaseLeaves(r_child, leaves);
+  num_rebuilt_leaves += leaves.size();
+  Split(leaves.begin(), leaves.end());
+  return sah_cost;
+}
+
+template <typename T>
+T BVHNode<T>::GetSAHCost(T l_cost, T r_cost) const {
+  // the children of a degenerated node (a segment or a point) are degenerated as well
+  T area = aabb.GetSurfaceArea();
+  if (area <= T(0))
+    return T(1) + l_cost + r_cost;
+  T l_area = l_child->aabb.GetSurfaceArea();
+  T r_area = r_child->aabb.GetSurfaceArea();
+  return T(1) + (l_area * l_cost + r_area * r_cost) / area;
+}
+
+template <typename T>
+void BVHNode<T>::ReleaseLeaves(std::unique_ptr<BVHNode>& node,
+                               std::vector<std::unique_ptr<BVHNode>>& leaves) {
+  if (node->mesh.has_value()) {
+    leaves.push_back(std::move(node));
+    return;
+  }
+  ReleaseLeaves(node->l_child, leaves);
+  ReleaseLeaves(node->r_child, leaves);
+  node.reset();
 }
 
 }  // namespace mcpt
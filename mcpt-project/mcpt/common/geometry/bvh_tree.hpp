@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "mcpt/common/assert.hpp"
+#include "mcpt/common/trace.hpp"
 
 #include "mcpt/common/geometry/aabb.hpp"
 #include "mcpt/common/geometry/bvh_node.hpp"
@@ -18,20 +19,69 @@ template <typename T>
 struct BVHTree {
   using Scalar = T;
 
+  struct RefitStats {
+    size_t num_rebuilt_leaves = 0;
+    T sah_cost_before = T(0);  // at the last (re)build
+    T sah_cost_after = T(0);
+  };
+
+  // rebuild the subtrees whose SAH cost grows more than 20% by default
+  static constexpr T MAX_REFIT_COST_RATIO = T(1.2);
+
   size_t num_leaves = 0;
-  std::unique_ptr<const BVHNode<T>> root;
+  std::unique_ptr<BVHNode<T>> root;
 
   template <typename InputIt>
   void Construct(InputIt first, InputIt last);
+
+  // construct a top level tree over the meshes & the instances of other trees (BVHInstance)
+  template <typename MeshIt, typename InstanceIt>
+  void Construct(MeshIt first, MeshIt last, InstanceIt inst_first, InstanceIt inst_last);
+
+  // update the bounds after the leaf geometries moved, without changing the leaves
+  // the leaf bounds are given by `leaf_bounds(mesh) -> AABB<T>' where mesh is the std::any of leaf
+  template <typename LeafBounds>
+  RefitStats Refit(const LeafBounds& leaf_bounds, T max_cost_ratio = MAX_REFIT_COST_RATIO);
+
+private:
+  using Leaves = std::vector<std::unique_ptr<BVHNode<T>>>;
+
+  template <typename InputIt>
+  static void AppendMeshLeaves(InputIt first, InputIt last, Leaves& leaves);
+
+  void Build(Leaves leaves);
 };
 
 template <typename T>
 template <typename InputIt>
 void BVHTree<T>::Construct(InputIt first, InputIt last) {
+  TRACE_ZONE("construct BVH");
   DASSERT(first != last);
-  num_leaves = std::distance(first, last);
 
-  std::vector<std::unique_ptr<BVHNode<T>>> leaves;
+  Leaves leaves;
+  AppendMeshLeaves(first, last, leaves);
+  Build(std::move(leaves));
+}
+
+template <typename T>
+template <typename MeshIt, typename InstanceIt>
+void BVHTree<T>::Construct(MeshIt first, MeshIt last, InstanceIt inst_first, InstanceIt inst_last) {
+  TRACE_ZONE("construct top level BVH");
+  DASSERT(first != last || inst_first != inst_last);
+
+  Leaves leaves;
+  AppendMeshLeaves(first, last, leaves);
+  for (; inst_first != inst_last; ++inst_first) {
+    auto node = std::make_unique<BVHNode<T>>(inst_first->aabb);
+    node->mesh = std::cref(*inst_first);
+    leaves.push_back(std::move(node));
+  }
+  Build(std::move(leaves));
+}
+
+template <typename T>
+template <typename InputIt>
+void BVHTree<T>::AppendMeshLeaves(InputIt first, InputIt last, Leaves& leaves) {
   for (; first != last; ++first) {
     AABB<T> leaf_aabb;
     for (const auto& v : first->polygon.vertices)
@@ -41,7 +91,24 @@ void BVHTree<T>::Construct(InputIt first, InputIt last) {
     node->mesh = std::cref(*first);
     leaves.push_back(std::move(node));
   }
+}
 
+template <typename T>
+template <typename LeafBounds>
+typename BVHTree<T>::RefitStats BVHTree<T>::Refit(const LeafBounds& leaf_bounds,
+                                                  T max_cost_ratio) {
+  TRACE_ZONE("refit BVH");
+  DASSERT(root, "BVH tree must be constructed before refitting");
+  RefitStats stats;
+  stats.sah_cost_before = root->sah_cost;
+  stats.sah_cost_after = root->Refit(leaf_bounds, max_cost_ratio, stats.num_rebuilt_leaves);
+  return stats;
+}
+
+// link the leaves into a binary tree
+template <typename T>
+void BVHTree<T>::Build(Leaves leaves) {
+  num_leaves = leaves.size();
   if (leaves.size() == 1) {
     root = std::move(leaves.front());
     return;
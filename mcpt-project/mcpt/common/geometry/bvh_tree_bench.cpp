@@ -0,0 +1,68 @@
+#include "mcpt/common/geometry/bvh_tree.hpp"
+
+#include <any>
+#include <functional>
+
+#include <Eigen/Eigen>
+#include <benchmark/benchmark.h>
+
+#include "mcpt/common/object/bench_helper.hpp"
+#include "mcpt/common/object/mesh.hpp"
+#include "mcpt/common/random.hpp"
+
+namespace {
+
+void BM_BVHTreeConstruct(benchmark::State& state) {
+  auto meshes = mcpt::bench::RandomTriangleMeshes(state.range(0));
+
+  for (auto _ : state) {
+    mcpt::BVHTree<float> bvh_tree;
+    bvh_tree.Construct(meshes.cbegin(), meshes.cend());
+    benchmark::DoNotOptimize(bvh_tree.root.get());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BVHTreeConstruct)
+    ->RangeMultiplier(10)
+    ->Range(1'000, 10'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+// moves every triangle slightly per frame, then refits the tree instead of constructing it again
+void BM_BVHTreeRefit(benchmark::State& state) {
+  static constexpr float MAX_OFFSET = 0.1F;
+  auto meshes = mcpt::bench::RandomTriangleMeshes(state.range(0));
+  mcpt::BVHTree<float> bvh_tree;
+  bvh_tree.Construct(meshes.cbegin(), meshes.cend());
+
+  auto leaf_bounds = [](const std::any& leaf) {
+    mcpt::AABB<float> aabb;
+    const mcpt::Mesh& mesh = std::any_cast<std::reference_wrapper<const mcpt::Mesh>>(leaf);
+    for (const auto& v : mesh.polygon.vertices)
+      aabb.Update(v);
+    return aabb;
+  };
+
+  mcpt::Uniform<float> uniform;
+  size_t num_rebuilt_leaves = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (auto& mesh : meshes) {
+      Eigen::Vector3f offset(uniform.Random(), uniform.Random(), uniform.Random());
+      for (auto& v : mesh.polygon.vertices)
+        v += (offset * 2.0F - Eigen::Vector3f::Ones()) * MAX_OFFSET;
+    }
+    state.ResumeTiming();
+
+    num_rebuilt_leaves += bvh_tree.Refit(leaf_bounds).num_rebuilt_leaves;
+    benchmark::DoNotOptimize(bvh_tree.root.get());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["rebuilt_leaves"] =
+      benchmark::Counter(num_rebuilt_leaves, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_BVHTreeRefit)
+    ->RangeMultiplier(10)
+    ->Range(1'000, 1'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
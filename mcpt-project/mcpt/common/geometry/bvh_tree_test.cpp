@@ -1,12 +1,23 @@
 #include "mcpt/common/geometry/bvh_tree.hpp"
 
+#include <algorithm>
+#include <any>
 #include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <set>
 #include <string_view>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
 
+#include <Eigen/Eigen>
 #include <catch2/catch_test_macros.hpp>
 
+#include "mcpt/common/geometry/bvh_instance.hpp"
+#include "mcpt/common/geometry/quantized_bvh.hpp"
+#include "mcpt/common/geometry/sbvh_builder.hpp"
 #include "mcpt/common/object/object.hpp"
 #include "mcpt/parser/obj_parser/parser.hpp"
 #include "mcpt/parser/obj_parser/test_mock.hpp"
@@ -65,4 +76,238 @@ SECTION("traverse the BVH tree") {
   CHECK(num_meshes == num_bvh_leaves);
 }
 
+SECTION("build the BVH tree with spatial splits") {
+  size_t num_meshes = 0;
+  for (const auto& groups : object.mesh_groups())
+    num_meshes += groups.mesh_index.size();
+  CAPTURE(num_meshes);
+
+  BVHTree bvh_tree = object.CreateBVHTree(true);
+  CHECK(bvh_tree.num_leaves >= num_meshes);
+  CHECK(bvh_tree.num_leaves <= num_meshes * 3 / 2);
+
+  // the leaves refer to all the meshes, the clipped bounds overlap the meshes
+  std::set<const mcpt::Mesh*> referred_meshes;
+  size_t num_bvh_leaves = 0;
+  for (std::deque queue{bvh_tree.root.get()}; !queue.empty(); queue.pop_front()) {
+    auto node = queue.front();
+    CHECK(node->mesh.has_value() == (!node->l_child && !node->r_child));
+    if (node->l_child && node->r_child) {
+      for (const auto& child : {node->l_child.get(), node->r_child.get()}) {
+        CHECK((node->aabb.min_vertex().array() <= child->aabb.min_vertex().array()).all());
+        CHECK((node->aabb.max_vertex().array() >= child->aabb.max_vertex().array()).all());
+        queue.push_back(child);
+      }
+      continue;
+    }
+
+    ++num_bvh_leaves;
+    const mcpt::Mesh& mesh = std::any_cast<std::reference_wrapper<const mcpt::Mesh>>(node->mesh);
+    referred_meshes.insert(&mesh);
+    mcpt::AABB<float> mesh_aabb;
+    for (const auto& v : mesh.polygon.vertices)
+      mesh_aabb.Update(v);
+    CHECK((node->aabb.min_vertex().array() >= mesh_aabb.min_vertex().array() - 1e-4F).all());
+    CHECK((node->aabb.max_vertex().array() <= mesh_aabb.max_vertex().array() + 1e-4F).all());
+  }
+  CHECK(num_bvh_leaves == bvh_tree.num_leaves);
+  CHECK(referred_meshes.size() == num_meshes);
+
+  // no worse than the median split tree
+  mcpt::obj_parser::Parser median_parser(obj_path);
+  BVHTree median_bvh_tree = median_parser.object().CreateBVHTree();
+  CHECK(bvh_tree.root->sah_cost <= median_bvh_tree.root->sah_cost);
+  CHECK(bvh_tree.root->aabb.min_vertex().isApprox(median_bvh_tree.root->aabb.min_vertex()));
+  CHECK(bvh_tree.root->aabb.max_vertex().isApprox(median_bvh_tree.root->aabb.max_vertex()));
+}
+
+SECTION("build the BVH tree with spatial splits in a tight duplication budget") {
+  // two clusters of slivers bridged by a few large triangles, the spatial split between the
+  // clusters duplicates all the large ones at once
+  std::vector<mcpt::Mesh> meshes;
+  auto add_triangle = [&meshes](float x0, float x1, float y0, float y1) {
+    std::vector<Eigen::Vector3f> vertices{{x0, y0, 0.0F}, {x1, y0, 0.0F}, {x0, y1, 0.0F}};
+    std::vector<Eigen::Vector2f> text_coords(3, Eigen::Vector2f::Zero());
+    meshes.push_back(
+        {"", mcpt::ConvexPolygon{vertices}, mcpt::Polygon2D{text_coords}, Eigen::Vector3f::UnitZ()});
+  };
+  for (int i = 0; i < 10; ++i) {
+    add_triangle(-10.0F + 0.1F * i, -9.9F + 0.1F * i, -10.0F, 10.0F);
+    add_triangle(9.0F + 0.1F * i, 9.1F + 0.1F * i, -10.0F, 10.0F);
+  }
+  for (int i = 0; i < 8; ++i)
+    add_triangle(-10.0F, 10.0F, -10.0F, 10.0F);
+
+  for (float budget : {0.0F, 0.1F, 0.5F}) {
+    CAPTURE(budget);
+    mcpt::SBVHBuilder<float>::Options options;
+    options.duplication_budget = budget;
+    mcpt::SBVHBuilder<float> builder(options);
+    builder.AddMeshes(meshes.cbegin(), meshes.cend());
+    BVHTree bvh_tree = builder.Build();
+    CHECK(bvh_tree.num_leaves == builder.stats().num_references);
+    CHECK(bvh_tree.num_leaves <= meshes.size() + size_t(meshes.size() * budget));
+    if (budget > 0.2F)
+      CHECK(builder.stats().num_spatial_splits > 0);
+  }
+}
+
+SECTION("quantize the BVH tree") {
+  using QuantizedBVH = mcpt::QuantizedBVH<float>;
+
+  BVHTree bvh_tree = object.CreateBVHTree();
+  QuantizedBVH quantized_bvh(bvh_tree);
+  CHECK(sizeof(QuantizedBVH::Node) == 36);
+  CHECK(quantized_bvh.leaves().size() == bvh_tree.num_leaves);
+  CHECK(quantized_bvh.nodes().size() == bvh_tree.num_leaves - 1);
+  CHECK(quantized_bvh.aabb().min_vertex() == bvh_tree.root->aabb.min_vertex());
+  CHECK(quantized_bvh.aabb().max_vertex() == bvh_tree.root->aabb.max_vertex());
+
+  // the decoded bounds contain the source bounds
+  auto contains = [](const mcpt::AABB<float>& lhs, const mcpt::AABB<float>& rhs) {
+    return (lhs.min_vertex().array() <= rhs.min_vertex().array()).all() &&
+           (lhs.max_vertex().array() >= rhs.max_vertex().array()).all();
+  };
+  using Item = std::tuple<uint32_t, const mcpt::BVHNode<float>*, mcpt::AABB<float>>;
+  std::deque<Item> queue{{quantized_bvh.root(), bvh_tree.root.get(), quantized_bvh.aabb()}};
+  for (; !queue.empty(); queue.pop_front()) {
+    auto [index, node, aabb] = queue.front();
+    if (QuantizedBVH::IsLeaf(index)) {
+      CHECK(quantized_bvh.GetLeaf(index) == node);
+      continue;
+    }
+
+    REQUIRE(node->l_child);
+    REQUIRE(node->r_child);
+    const auto& q_node = quantized_bvh.nodes()[index];
+    const mcpt::BVHNode<float>* children[] = {node->l_child.get(), node->r_child.get()};
+    for (int i = 0; i < 2; ++i) {
+      auto child_aabb = quantized_bvh.GetChildBounds(q_node, i);
+      CHECK(contains(child_aabb, children[i]->aabb));
+      // no looser than 2 steps of the grid on each side
+      Eigen::Vector3f max_error = 2.0F * aabb.GetDiagonal() / 255.0F;
+      CHECK(((children[i]->aabb.min_vertex() - child_aabb.min_vertex()).array() <=
+             max_error.array()).all());
+      CHECK(((child_aabb.max_vertex() - children[i]->aabb.max_vertex()).array() <=
+             max_error.array()).all());
+      queue.emplace_back(q_node.children[i], children[i], child_aabb);
+    }
+  }
+}
+
+SECTION("refit the BVH tree after moving the vertices") {
+  BVHTree bvh_tree = object.CreateBVHTree();
+  size_t num_leaves = bvh_tree.num_leaves;
+  Eigen::Vector3f min_vertex = bvh_tree.root->aabb.min_vertex();
+  Eigen::Vector3f max_vertex = bvh_tree.root->aabb.max_vertex();
+
+  // check the bounds & count the leaves
+  auto traverse = [](const BVHTree& bvh_tree) {
+    size_t num_bvh_leaves = 0;
+    for (std::deque queue{bvh_tree.root.get()}; !queue.empty(); queue.pop_front()) {
+      auto node = queue.front();
+      if (node->l_child && node->r_child) {
+        const auto& l = node->l_child;
+        const auto& r = node->r_child;
+        CHECK(node->aabb.min_vertex() == l->aabb.min_vertex().cwiseMin(r->aabb.min_vertex()));
+        CHECK(node->aabb.max_vertex() == l->aabb.max_vertex().cwiseMax(r->aabb.max_vertex()));
+        queue.push_back(l.get());
+        queue.push_back(r.get());
+        continue;
+      }
+
+      REQUIRE(node->mesh.has_value());
+      ++num_bvh_leaves;
+      const mcpt::Mesh& mesh = std::any_cast<std::reference_wrapper<const mcpt::Mesh>>(node->mesh);
+      for (const auto& v : mesh.polygon.vertices) {
+        CHECK((node->aabb.min_vertex().array() <= v.array()).all());
+        CHECK((node->aabb.max_vertex().array() >= v.array()).all());
+      }
+    }
+    return num_bvh_leaves;
+  };
+
+  SECTION("translate all the vertices") {
+    Eigen::Vector3f offset(1.0F, 2.0F, 4.0F);
+    for (auto& v : object.vertices())
+      v += offset;
+
+    auto stats = object.UpdateBVHTree(bvh_tree);
+    CHECK(stats.num_rebuilt_leaves == 0);
+    CHECK(traverse(bvh_tree) == num_leaves);
+    CHECK(bvh_tree.root->aabb.min_vertex().isApprox(min_vertex + offset));
+    CHECK(bvh_tree.root->aabb.max_vertex().isApprox(max_vertex + offset));
+  }
+
+  SECTION("shuffle the vertices") {
+    auto& vertices = object.vertices();
+    std::rotate(vertices.begin(), vertices.begin() + vertices.size() / 3, vertices.end());
+
+    auto stats = object.UpdateBVHTree(bvh_tree);
+    CHECK(stats.num_rebuilt_leaves > 0);
+    CHECK(traverse(bvh_tree) == num_leaves);
+    CHECK(bvh_tree.num_leaves == num_leaves);
+  }
+}
+
+SECTION("instance the bottom level BVH tree") {
+  static constexpr std::string_view INSTANCED_OBJ_CONTENT = R"(
+mtllib mock.mtl
+v 0.0 0.0 0.0
+v 1.0 0.0 0.0
+v 0.0 1.0 0.0
+v 0.0 0.0 1.0
+vt 0.0 0.0
+vn 0.0 0.0 1.0
+proto tetrahedron
+usemtl lambert2SG
+f 1/1/1 3/1/1 2/1/1
+f 1/1/1 2/1/1 4/1/1
+f 1/1/1 4/1/1 3/1/1
+f 2/1/1 3/1/1 4/1/1
+g default
+inst tetrahedron 1 0 0 0 0 1 0 0 0 0 1 0
+inst tetrahedron 1 0 0 5 0 1 0 0 0 0 1 0
+inst tetrahedron 2 0 0 0 0 2 0 5 0 0 2 0
+)";
+
+  auto instanced_obj_path = mockfile("instanced.obj", INSTANCED_OBJ_CONTENT);
+  mcpt::obj_parser::Parser instanced_parser(instanced_obj_path);
+  mcpt::Object& instanced_object = instanced_parser.object();
+  REQUIRE(instanced_object.mesh_groups().empty());
+  REQUIRE(instanced_object.prototypes().size() == 1);
+  REQUIRE(instanced_object.instances().size() == 3);
+
+  BVHTree bvh_tree = instanced_object.CreateBVHTree();
+  CHECK(bvh_tree.num_leaves == 3);
+
+  // all the instances share one bottom level tree
+  const BVHTree* bottom_level = nullptr;
+  mcpt::AABB<float> root_aabb;
+  for (std::deque queue{bvh_tree.root.get()}; !queue.empty(); queue.pop_front()) {
+    auto node = queue.front();
+    if (node->l_child)
+      queue.push_back(node->l_child.get());
+    if (node->r_child)
+      queue.push_back(node->r_child.get());
+    if (!node->mesh.has_value())
+      continue;
+
+    using InstanceRef = std::reference_wrapper<const mcpt::BVHInstance<float>>;
+    REQUIRE(node->mesh.type() == typeid(InstanceRef));
+    const auto& instance = std::any_cast<InstanceRef>(node->mesh).get();
+    if (!bottom_level)
+      bottom_level = &instance.bvh_tree.get();
+    CHECK(&instance.bvh_tree.get() == bottom_level);
+    CHECK(instance.bvh_tree.get().num_leaves == 4);
+    CHECK((instance.to_local * instance.to_world).matrix().isIdentity());
+    root_aabb.Update(instance.aabb);
+  }
+
+  CHECK(root_aabb.min_vertex() == Eigen::Vector3f(0.0F, 0.0F, 0.0F));
+  CHECK(root_aabb.max_vertex() == Eigen::Vector3f(6.0F, 7.0F, 2.0F));
+  CHECK(bvh_tree.root->aabb.min_vertex() == root_aabb.min_vertex());
+  CHECK(bvh_tree.root->aabb.max_vertex() == root_aabb.max_vertex());
+}
+
 }
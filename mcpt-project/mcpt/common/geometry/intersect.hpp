@@ -2,14 +2,18 @@
 
 #include <cmath>
 #include <algorithm>
+#include <limits>
 #include <numeric>
 #include <tuple>
 #include <vector>
 
 #include <Eigen/Eigen>
-#include <spdlog/spdlog.h>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/stats.hpp"
 
 #include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/ray_packet.hpp"
 #include "mcpt/common/geometry/types.hpp"
 
 namespace mcpt {
@@ -54,14 +58,36 @@ public:
   // return point at infinity if not intersectant
   Vector4 Get(const Ray<T>& r, const ConvexPolygon<T>& ply) const {
     Vector4 x = Get(r, static_cast<const Plane<T>&>(ply));
-    if (x.w() == 0.0 || !Inside(x.template head<3>(), ply))
+    if (x.w() == 0.0)
+      return Vector4::Zero();
+    if (!Inside(x.template head<3>(), ply)) {
+      STATS_INC(INSIDE_REJECTIONS);
       return Vector4::Zero();
+    }
     return x;
   }
 
   // return whether a ray and an AABB intersect
-  // TODO improve the performance
-  bool Test(const Ray<T>& r, const AABB<T>& aabb) const;
+  bool Test(const Ray<T>& r, const AABB<T>& aabb) const {
+    T t_enter;
+    T t_exit;
+    return Test(r, aabb, t_enter, t_exit);
+  }
+
+  // return whether a ray and an AABB intersect, and the entry & exit distances along the ray
+  // the entry distance is negative if the ray starts inside the AABB
+  bool Test(const Ray<T>& r, const AABB<T>& aabb, T& t_enter, T& t_exit) const;
+
+  // return whether each active ray of a packet and an AABB intersect, and the entry distances
+  template <int N>
+  Eigen::Array<bool, N, 1> Test(const RayPacket<T, N>& p,
+                                const AABB<T>& aabb,
+                                Eigen::Array<T, N, 1>& t_enter) const;
+
+  // return whether the frustum of a coherent packet may intersect an AABB
+  // return true for incoherent packets
+  template <int N>
+  bool TestFrustum(const RayPacket<T, N>& p, const AABB<T>& aabb) const;
 
 private:
   std::tuple<bool, T, T> TestParallel(const Line<T>& l, const Plane<T>& pi) const {
@@ -108,38 +134,82 @@ private:
  *   O
  */
 template <typename T>
-bool Intersect<T>::Test(const Ray<T>& r, const AABB<T>& aabb) const {
-  static const Eigen::IOFormat FMT{Eigen::StreamPrecision, Eigen::DontAlignCols, " ", " "};
-
-  // avoid computing invalid ray or AABB
-  if (!r.direction.allFinite() || (r.direction.array() == 0.0).all()) {
-    spdlog::error("invalid ray: direction = {}", r.direction.format(FMT));
-    return false;
+bool Intersect<T>::Test(const Ray<T>& r, const AABB<T>& aabb, T& t_enter, T& t_exit) const {
+  DASSERT(r.direction.allFinite() && !(r.direction.array() == 0.0).all(),
+          "invalid ray: direction = {} {} {}",
+          r.direction.x(),
+          r.direction.y(),
+          r.direction.z());
+
+  // the sign of the direction selects the near & far slabs of each axis
+  // a zero direction component gives infinite distances if the ray starts out of the slabs, which
+  // miss correctly, or NaN (0 * inf) if it starts on some slab, the comparisons are false for NaN
+  // so the bound is kept, i.e. the boundary is inclusive
+  const Vector3* bounds[] = {&aabb.min_vertex(), &aabb.max_vertex()};
+  T t_en = std::numeric_limits<T>::lowest();
+  T t_ex = std::numeric_limits<T>::max();
+  for (Eigen::Index i = 0; i < 3; ++i) {
+    T origin = r.point_a.coeff(i);
+    T t_near = (bounds[r.sign[i]]->coeff(i) - origin) * r.inv_direction.coeff(i);
+    T t_far = (bounds[1 - r.sign[i]]->coeff(i) - origin) * r.inv_direction.coeff(i);
+    t_en = t_near > t_en ? t_near : t_en;
+    t_ex = t_far < t_ex ? t_far : t_ex;
   }
 
-  const auto& v_min = aabb.min_vertex();
-  const auto& v_max = aabb.max_vertex();
-  if ((v_min.array() < v_max.array()).count() <= 1) {
-    spdlog::error("invalid AABB: min = {}, max = {}", v_min.format(FMT), v_max.format(FMT));
-    return false;
-  }
+  t_enter = t_en;
+  t_exit = t_ex;
+  return t_en <= t_ex && t_ex >= 0.0;
+}
 
-  Vector3 slab_t_min = (v_min - r.point_a).cwiseQuotient(r.direction);
-  Vector3 slab_t_max = (v_max - r.point_a).cwiseQuotient(r.direction);
+template <typename T>
+template <int N>
+Eigen::Array<bool, N, 1> Intersect<T>::Test(const RayPacket<T, N>& p,
+                                            const AABB<T>& aabb,
+                                            Eigen::Array<T, N, 1>& t_enter) const {
+  using Matrix3N = typename RayPacket<T, N>::Matrix3N;
+
+  if (!TestFrustum(p, aabb))
+    return Eigen::Array<bool, N, 1>::Constant(false);
+
+  // same slab test as a single ray but for all the rays at once
+  Matrix3N slab_t_min = -(p.origin.colwise() - aabb.min_vertex().array()) * p.inv_direction;
+  Matrix3N slab_t_max = -(p.origin.colwise() - aabb.max_vertex().array()) * p.inv_direction;
+  t_enter = slab_t_min.min(slab_t_max).colwise().maxCoeff().transpose();
+  Eigen::Array<T, N, 1> t_exit = slab_t_min.max(slab_t_max).colwise().minCoeff().transpose();
+  return p.active && t_enter <= t_exit && t_exit >= 0.0;
+}
+
+/**
+ * interval arithmetic over the packet: every ray's origin lies in [O_min, O_max] and inverse
+ * direction in [D_min, D_max], so the entry distance on each axis is no less than the lower bound
+ * of (near - O) * D and the exit distance is no greater than the upper bound of (far - O) * D
+ */
+template <typename T>
+template <int N>
+bool Intersect<T>::TestFrustum(const RayPacket<T, N>& p, const AABB<T>& aabb) const {
+  if (!p.coherent)
+    return true;
 
   T t_en = std::numeric_limits<T>::lowest();
   T t_ex = std::numeric_limits<T>::max();
   for (Eigen::Index i = 0; i < 3; ++i) {
-    if (r.direction.coeff(i) == 0.0) {
-      // parallel or outside box
-      if (r.point_a.coeff(i) < v_min.coeff(i) || r.point_a.coeff(i) > v_max.coeff(i))
-        return false;
-    } else {
-      DASSERT(std::isfinite(slab_t_min.coeff(i)) && std::isfinite(slab_t_max.coeff(i)));
-      auto [t_min, t_max] = std::minmax(slab_t_min.coeff(i), slab_t_max.coeff(i));
-      t_en = std::max(t_en, t_min);
-      t_ex = std::min(t_ex, t_max);
-    }
+    // all the rays point to the same side on each axis
+    bool positive = p.min_inv_direction.coeff(i) > 0.0;
+    T near = positive ? aabb.min_vertex().coeff(i) : aabb.max_vertex().coeff(i);
+    T far = positive ? aabb.max_vertex().coeff(i) : aabb.min_vertex().coeff(i);
+
+    T d_lo = p.min_inv_direction.coeff(i);
+    T d_hi = p.max_inv_direction.coeff(i);
+    T n_lo = std::min({(near - p.min_origin.coeff(i)) * d_lo,
+                      (near - p.min_origin.coeff(i)) * d_hi,
+                      (near - p.max_origin.coeff(i)) * d_lo,
+                      (near - p.max_origin.coeff(i)) * d_hi});
+    T f_hi = std::max({(far - p.min_origin.coeff(i)) * d_lo,
+                      (far - p.min_origin.coeff(i)) * d_hi,
+                      (far - p.max_origin.coeff(i)) * d_lo,
+                      (far - p.max_origin.coeff(i)) * d_hi});
+    t_en = std::max(t_en, n_lo);
+    t_ex = std::min(t_ex, f_hi);
   }
   return t_en <= t_ex && t_ex >= 0.0;
 }
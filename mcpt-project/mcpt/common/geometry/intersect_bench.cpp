@@ -0,0 +1,57 @@
+#include "mcpt/common/geometry/intersect.hpp"
+
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <benchmark/benchmark.h>
+
+#include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/types.hpp"
+#include "mcpt/common/object/bench_helper.hpp"
+
+namespace {
+
+using mcpt::bench::GetRandomScene;
+
+constexpr size_t NUM_TRIANGLES = 1024;
+
+void BM_IntersectTestAABB(benchmark::State& state) {
+  const auto& scene = GetRandomScene(NUM_TRIANGLES);
+  mcpt::Intersect<float> intersect(Eigen::NumTraits<float>::dummy_precision());
+
+  std::vector<mcpt::AABB<float>> aabbs;
+  for (const auto& mesh : scene.meshes) {
+    mcpt::AABB<float> aabb;
+    for (const auto& v : mesh.polygon.vertices)
+      aabb.Update(v);
+    aabbs.push_back(aabb);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& ray = scene.rays[i % scene.rays.size()];
+    benchmark::DoNotOptimize(intersect.Test(ray, aabbs[i % aabbs.size()]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IntersectTestAABB);
+
+void BM_IntersectGetPolygon(benchmark::State& state) {
+  const auto& scene = GetRandomScene(NUM_TRIANGLES);
+  mcpt::Intersect<float> intersect(Eigen::NumTraits<float>::dummy_precision());
+
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& ray = scene.rays[i % scene.rays.size()];
+    // half of the tests hit the target polygon
+    const auto& mesh = i % 2 ? *scene.targets[i % scene.rays.size()]
+                             : scene.meshes[i % scene.meshes.size()];
+    benchmark::DoNotOptimize(intersect.Get(ray, mesh.polygon));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IntersectGetPolygon);
+
+}  // namespace
@@ -5,6 +5,7 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/ray_packet.hpp"
 #include "mcpt/common/geometry/types.hpp"
 
 TEST_CASE("intersect computes intersection of line/ray and shape", "[geometry][intersect]") {
@@ -304,22 +305,18 @@ SECTION("intersection of ray and AABB") {
 }
 
 SECTION("intersection of ray and AABB degenerated cases") {
-  SECTION("ray is invalid") {
-    Ray r(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
-    mcpt::AABB<double> aabb(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
-    CHECK_FALSE(intersect.Test(r, aabb));
-  }
-
   SECTION("AABB is a single point") {
-    Ray r(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
-    mcpt::AABB<double> aabb(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
-    CHECK_FALSE(intersect.Test(r, aabb));
+    mcpt::AABB<double> aabb(Eigen::Vector3d::Ones(), Eigen::Vector3d::Ones());
+    CHECK(intersect.Test(Ray(Eigen::Vector3d::Zero(), Eigen::Vector3d::Ones()), aabb));
+    CHECK_FALSE(intersect.Test(Ray(Eigen::Vector3d::Zero(), Eigen::Vector3d::UnitX()), aabb));
   }
 
   SECTION("AABB is a line") {
-    Ray r(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+    // the ray lies on the slabs of the Z axis
     mcpt::AABB<double> aabb(Eigen::Vector3d::Zero(), Eigen::Vector3d::UnitX());
-    CHECK_FALSE(intersect.Test(r, aabb));
+    Eigen::Vector3d start_point(0.5, -1.0, 0.0);
+    CHECK(intersect.Test(Ray(start_point, Eigen::Vector3d::UnitY()), aabb));
+    CHECK_FALSE(intersect.Test(Ray(start_point, -Eigen::Vector3d::UnitY()), aabb));
   }
 
   SECTION("AABB is on XY plane") {
@@ -341,4 +338,102 @@ SECTION("intersection of ray and AABB degenerated cases") {
   }
 }
 
+SECTION("entry & exit distances of ray and AABB") {
+  mcpt::AABB<double> aabb(Eigen::Vector3d::Zero(), Eigen::Vector3d::Ones());
+  double t_enter = 0.0;
+  double t_exit = 0.0;
+
+  SECTION("starting from outside") {
+    Ray r(Eigen::Vector3d(0.5, 0.5, -1.0), Eigen::Vector3d::UnitZ());
+    REQUIRE(intersect.Test(r, aabb, t_enter, t_exit));
+    CHECK(t_enter == 1.0);
+    CHECK(t_exit == 2.0);
+  }
+
+  SECTION("starting from inside") {
+    Ray r(Eigen::Vector3d::Constant(0.5), -Eigen::Vector3d::Ones());
+    REQUIRE(intersect.Test(r, aabb, t_enter, t_exit));
+    CHECK(t_enter == Approx(-std::sqrt(0.75)));
+    CHECK(t_exit == Approx(std::sqrt(0.75)));
+  }
+
+  SECTION("starting from -0 & pointing to -0") {
+    // -0 direction components pick the max vertex as the near slab
+    Ray r(Eigen::Vector3d(-0.0, 0.5, -1.0), Eigen::Vector3d(-0.0, -0.0, 1.0));
+    REQUIRE(r.sign == decltype(r.sign){1, 1, 0});
+    REQUIRE(intersect.Test(r, aabb, t_enter, t_exit));
+    CHECK(t_enter == 1.0);
+    CHECK(t_exit == 2.0);
+  }
+
+  SECTION("parallel out of the slabs") {
+    Ray r(Eigen::Vector3d(1.5, 0.5, -1.0), Eigen::Vector3d::UnitZ());
+    CHECK_FALSE(intersect.Test(r, aabb, t_enter, t_exit));
+  }
+
+  SECTION("behind") {
+    Ray r(Eigen::Vector3d(0.5, 0.5, 2.0), Eigen::Vector3d::UnitZ());
+    CHECK_FALSE(intersect.Test(r, aabb, t_enter, t_exit));
+    CHECK(t_exit == -1.0);
+  }
+}
+
+SECTION("intersection of ray packet and AABB") {
+  mcpt::AABB<double> aabb(Eigen::Vector3d::Zero(), Eigen::Vector3d::Ones());
+
+  // a fan of rays sweeping across the box on the XY plane
+  auto make_rays = [](const Eigen::Vector3d& start_point, int n) {
+    std::vector<Ray> rays;
+    for (int i = 0; i < n; ++i) {
+      Eigen::Vector3d pointing_to(-0.5 + 0.25 * i, 0.5, 0.5);
+      rays.emplace_back(start_point, pointing_to - start_point);
+    }
+    return rays;
+  };
+
+  SECTION("same as testing each ray") {
+    auto rays = make_rays(Eigen::Vector3d(0.5, -1.0, 0.5), 8);
+    mcpt::RayPacket<double, 8> packet(rays.cbegin(), rays.cend());
+    REQUIRE(packet.coherent == false);
+
+    Eigen::Array<double, 8, 1> t_enter;
+    auto mask = intersect.Test(packet, aabb, t_enter);
+    for (int i = 0; i < 8; ++i) {
+      CAPTURE(i);
+      CHECK(mask.coeff(i) == intersect.Test(rays[i], aabb));
+    }
+  }
+
+  SECTION("partial packet") {
+    std::vector<Ray> rays;
+    for (double x : {-1.0, 0.5, 2.0})
+      rays.emplace_back(Eigen::Vector3d(x, -1.0, 0.5), Eigen::Vector3d::UnitY());
+    mcpt::RayPacket<double, 4> packet(rays.cbegin(), rays.cend());
+
+    Eigen::Array<double, 4, 1> t_enter;
+    auto mask = intersect.Test(packet, aabb, t_enter);
+    CHECK_FALSE(mask.coeff(0));
+    CHECK(mask.coeff(1));
+    CHECK_FALSE(mask.coeff(2));
+    CHECK_FALSE(mask.coeff(3));
+    CHECK(t_enter.coeff(1) == Catch::Approx(1.0));
+  }
+
+  SECTION("frustum culling") {
+    auto rays = make_rays(Eigen::Vector3d(2.5, -1.0, 0.5), 4);
+    mcpt::RayPacket<double, 4> packet(rays.cbegin(), rays.cend());
+    REQUIRE(packet.coherent == true);
+
+    // box on the path of the fan
+    CHECK(intersect.TestFrustum(packet, mcpt::AABB<double>(
+        Eigen::Vector3d(-1.0, 0.0, 0.0), Eigen::Vector3d(3.0, 1.0, 1.0))));
+    // box behind the fan
+    CHECK_FALSE(intersect.TestFrustum(packet, mcpt::AABB<double>(
+        Eigen::Vector3d(1.0, -3.0, 0.0), Eigen::Vector3d(3.0, -2.0, 1.0))));
+    // box beside the fan
+    CHECK_FALSE(intersect.TestFrustum(packet, mcpt::AABB<double>(
+        Eigen::Vector3d(1.0, 0.0, 2.0), Eigen::Vector3d(3.0, 1.0, 3.0))));
+  }
+}
+
 }
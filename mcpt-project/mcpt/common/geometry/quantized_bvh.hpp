@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/trace.hpp"
+
+#include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/bvh_node.hpp"
+#include "mcpt/common/geometry/bvh_tree.hpp"
+
+namespace mcpt {
+
+// compressed copy of a BVH tree, the internal nodes are flattened into an array in depth-first
+// order & store the bounds of both children quantized to 8 bits relative to the node's own box
+// the leaves refer to the leaf nodes of the source tree, which must outlive the compressed one
+template <typename T>
+class QuantizedBVH {
+public:
+  using Scalar = T;
+
+  // the children with this bit set are the indices of the leaves
+  static constexpr uint32_t LEAF_BIT = uint32_t(1) << 31;
+
+  struct Node {
+    // the grid of the node box: origin + q * 2^exponent for q in [0, 255]
+    Eigen::Matrix<T, 3, 1> origin;
+    std::array<int8_t, 3> exponent;
+
+    std::array<std::array<uint8_t, 3>, 2> q_min;
+    std::array<std::array<uint8_t, 3>, 2> q_max;
+    std::array<uint32_t, 2> children;
+  };
+
+  explicit QuantizedBVH(const BVHTree<T>& bvh_tree);
+
+  // full precision bounds of the root
+  auto& aabb() const noexcept { return m_aabb; }
+  uint32_t root() const noexcept { return m_root; }
+
+  auto& nodes() const noexcept { return m_nodes; }
+  auto& leaves() const noexcept { return m_leaves; }
+
+  static bool IsLeaf(uint32_t index) noexcept { return index & LEAF_BIT; }
+  const BVHNode<T>* GetLeaf(uint32_t index) const { return m_leaves[index & ~LEAF_BIT]; }
+
+  // decoded bounds of the i-th child, never smaller than the ones of the source tree
+  AABB<T> GetChildBounds(const Node& node, int i) const;
+
+  // bytes of the nodes & leaves
+  size_t GetMemoryUsage() const noexcept {
+    return m_nodes.size() * sizeof(Node) + m_leaves.size() * sizeof(const BVHNode<T>*);
+  }
+
+private:
+  uint32_t Append(const BVHNode<T>* node, const AABB<T>& aabb);
+
+  // q * scale is exact, so the decoding rounds the same with or without FMA
+  static T Decode(T origin, uint8_t q, T scale) { return origin + T(q) * scale; }
+
+  // 2^exponent, avoids calling ldexp in the traversal
+  static T GetScale(int exponent) {
+    if constexpr (std::is_same_v<T, float>) {
+      if (exponent >= std::numeric_limits<float>::min_exponent - 1) {
+        auto bits = uint32_t(exponent + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+        return scale;
+      }
+    }
+    return std::ldexp(T(1), exponent);
+  }
+
+  AABB<T> m_aabb;
+  uint32_t m_root = LEAF_BIT;
+  std::vector<Node> m_nodes;
+  std::vector<const BVHNode<T>*> m_leaves;
+};
+
+template <typename T>
+QuantizedBVH<T>::QuantizedBVH(const BVHTree<T>& bvh_tree) {
+  TRACE_ZONE("quantize BVH");
+  DASSERT(bvh_tree.root, "BVH tree must be constructed before quantizing");
+  m_nodes.reserve(bvh_tree.num_leaves);
+  m_leaves.reserve(bvh_tree.num_leaves);
+  m_aabb = bvh_tree.root->aabb;
+  m_root = Append(bvh_tree.root.get(), m_aabb);
+}
+
+template <typename T>
+uint32_t QuantizedBVH<T>::Append(const BVHNode<T>* node, const AABB<T>& aabb) {
+  if (!node->l_child || !node->r_child) {
+    DASSERT(node->mesh.has_value());
+    ASSERT(m_leaves.size() < LEAF_BIT, "too many leaves to quantize");
+    m_leaves.push_back(node);
+    return uint32_t(m_leaves.size() - 1) | LEAF_BIT;
+  }
+
+  uint32_t index = m_nodes.size();
+  Node& q_node = m_nodes.emplace_back();
+  q_node.origin = aabb.min_vertex();
+  for (int axis = 0; axis < 3; ++axis) {
+    // the smallest power of 2 whose 255 steps cover the extent
+    T origin = aabb.min_vertex().coeff(axis);
+    T extent = aabb.max_vertex().coeff(axis) - origin;
+    int exponent = 0;
+    std::frexp(extent / T(255), &exponent);
+    exponent = std::max<int>(exponent, std::numeric_limits<int8_t>::min());
+    while (Decode(origin, 255, GetScale(exponent)) < aabb.max_vertex().coeff(axis))
+      ++exponent;
+    ASSERT(exponent <= std::numeric_limits<int8_t>::max(), "too large box to quantize");
+    q_node.exponent[axis] = int8_t(exponent);
+
+    // round outwards, then fix the rounding of the decoding
+    T scale = GetScale(exponent);
+    const BVHNode<T>* children[] = {node->l_child.get(), node->r_child.get()};
+    for (int i = 0; i < 2; ++i) {
+      T lo = children[i]->aabb.min_vertex().coeff(axis);
+      T hi = children[i]->aabb.max_vertex().coeff(axis);
+      auto q_min = uint8_t(std::clamp(std::floor((lo - origin) / scale), T(0), T(255)));
+      auto q_max = uint8_t(std::clamp(std::ceil((hi - origin) / scale), T(0), T(255)));
+      while (q_min > 0 && Decode(origin, q_min, scale) > lo)
+        --q_min;
+      while (q_max < 255 && Decode(origin, q_max, scale) < hi)
+        ++q_max;
+      q_node.q_min[i][axis] = q_min;
+      q_node.q_max[i][axis] = q_max;
+    }
+  }
+
+  // the decoded bounds are the boxes of the children, `q_node' is invalidated by appending
+  AABB<T> l_aabb = GetChildBounds(q_node, 0);
+  AABB<T> r_aabb = GetChildBounds(q_node, 1);
+  uint32_t l_index = Append(node->l_child.get(), l_aabb);
+  uint32_t r_index = Append(node->r_child.get(), r_aabb);
+  m_nodes[index].children = {l_index, r_index};
+  return index;
+}
+
+template <typename T>
+AABB<T> QuantizedBVH<T>::GetChildBounds(const Node& node, int i) const {
+  Eigen::Matrix<T, 3, 1> min_vertex;
+  Eigen::Matrix<T, 3, 1> max_vertex;
+  for (int axis = 0; axis < 3; ++axis) {
+    T scale = GetScale(node.exponent[axis]);
+    min_vertex.coeffRef(axis) = Decode(node.origin.coeff(axis), node.q_min[i][axis], scale);
+    max_vertex.coeffRef(axis) = Decode(node.origin.coeff(axis), node.q_max[i][axis], scale);
+  }
+  return AABB<T>(min_vertex, max_vertex);
+}
+
+}  // namespace mcpt
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <Eigen/Eigen>
+
+namespace mcpt {
+
+/**
+ * return the origin of a ray leaving a surface at `point', moved off the surface just enough that
+ * the rounding errors of the intersection point can not bring it back to the side of the surface
+ * the ray leaves from (Wachter & Binder, "A Fast and Robust Method for Avoiding Self-Intersection")
+ *
+ * the point is moved along the geometric normal, flipped to the side of `direction', by a number
+ * of ULPs of each coordinate, so the offset scales with the magnitude of the coordinates instead
+ * of a scene-scale constant; the coordinates close to zero, whose ULPs are too small, are moved by
+ * a fixed distance instead
+ *
+ *            direction
+ *         N     /
+ *         |    /
+ *         |   O
+ *         |  .
+ *    _____|_X_________
+ */
+template <typename T>
+Eigen::Matrix<T, 3, 1> OffsetRayOrigin(const Eigen::Matrix<T, 3, 1>& point,
+                                       const Eigen::Matrix<T, 3, 1>& normal,
+                                       const Eigen::Matrix<T, 3, 1>& direction) {
+  static_assert(std::is_same_v<T, float>, "the offsets are tuned for single precision");
+
+  // below this magnitude the coordinates are moved by FLOAT_SCALE * normal
+  constexpr T ORIGIN = T(1) / T(32);
+  constexpr T FLOAT_SCALE = T(1) / T(65536);
+  // ULPs moved along a unit normal component
+  constexpr T INT_SCALE = T(256);
+
+  Eigen::Matrix<T, 3, 1> n = normal.dot(direction) < T(0) ? -normal : normal;
+  Eigen::Matrix<T, 3, 1> origin;
+  for (int i = 0; i < 3; ++i) {
+    T p = point.coeff(i);
+    if (std::abs(p) < ORIGIN) {
+      origin.coeffRef(i) = p + FLOAT_SCALE * n.coeff(i);
+      continue;
+    }
+
+    // moving the bits of a negative number up moves it towards -inf
+    auto ulps = int32_t(INT_SCALE * n.coeff(i));
+    int32_t bits;
+    std::memcpy(&bits, &p, sizeof(p));
+    bits += p < T(0) ? -ulps : ulps;
+    std::memcpy(&p, &bits, sizeof(p));
+    origin.coeffRef(i) = p;
+  }
+  return origin;
+}
+
+}  // namespace mcpt
@@ -0,0 +1,78 @@
+#include "mcpt/common/geometry/ray_offset.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcpt/common/geometry/intersect.hpp"
+#include "mcpt/common/geometry/types.hpp"
+
+TEST_CASE("offset ray origin avoids self-intersection", "[geometry][ray_offset]") {
+
+std::mt19937 gen(42);
+std::uniform_real_distribution<float> uni(-1.0F, 1.0F);
+auto random_vector = [&] { return Eigen::Vector3f(uni(gen), uni(gen), uni(gen)); };
+
+mcpt::Intersect<float> intersect(Eigen::NumTraits<float>::dummy_precision());
+
+// hits on random triangles, the hit points are not exactly on the triangles
+struct Hit {
+  mcpt::ConvexPolygon<float> tri;
+  Eigen::Vector3f start;
+  Eigen::Vector3f direction;
+  Eigen::Vector3f point;
+};
+std::vector<Hit> hits;
+
+// far from the world origin, the hit points have large rounding errors
+for (float scale : {0.01F, 1.0F, 100.0F, 10000.0F}) {
+  for (size_t num_hits = hits.size() + 1000; hits.size() < num_hits;) {
+    Eigen::Vector3f center = scale * (Eigen::Vector3f::Constant(2.0F) + random_vector());
+    mcpt::ConvexPolygon<float> tri(center + scale * random_vector(),
+                                   center + scale * random_vector(),
+                                   center + scale * random_vector());
+
+    // aim at the triangle from either side
+    const auto& v = tri.vertices;
+    Eigen::Vector3f target = (v[0] + v[1] + v[2]) / 3.0F;
+    Eigen::Vector3f start = target + scale * random_vector();
+    mcpt::Ray<float> ray(start, target - start);
+    Eigen::Vector4f point_h = intersect.Get(ray, tri);
+    if (point_h.w() != 0.0F)
+      hits.push_back({tri, start, ray.direction, point_h.head<3>()});
+  }
+}
+
+// the exact side of a point to the plane of the triangle
+auto side = [](const mcpt::ConvexPolygon<float>& tri, const Eigen::Vector3f& p) {
+  Eigen::Vector3d a = tri.vertices[0].cast<double>();
+  Eigen::Vector3d b = tri.vertices[1].cast<double>();
+  Eigen::Vector3d c = tri.vertices[2].cast<double>();
+  return (b - a).cross(c - a).dot(p.cast<double>() - a);
+};
+
+SECTION("reflected ray starts in front of the surface") {
+  for (const auto& [tri, start, direction, point] : hits) {
+    CAPTURE(point.transpose());
+    Eigen::Vector3f normal = tri.coeffs.head<3>();
+    Eigen::Vector3f reflected = direction - 2.0F * normal.dot(direction) * normal;
+    Eigen::Vector3f origin = mcpt::OffsetRayOrigin(point, normal, reflected);
+    CHECK(side(tri, origin) * side(tri, start) > 0.0);
+    CHECK((origin - point).norm() <= 1.0e-4F * std::max(point.norm(), 1.0F));
+  }
+}
+
+SECTION("transmitted ray starts behind the surface") {
+  for (const auto& [tri, start, direction, point] : hits) {
+    CAPTURE(point.transpose());
+    Eigen::Vector3f normal = tri.coeffs.head<3>();
+    Eigen::Vector3f origin = mcpt::OffsetRayOrigin(point, normal, direction);
+    CHECK(side(tri, origin) * side(tri, start) < 0.0);
+    CHECK((origin - point).norm() <= 1.0e-4F * std::max(point.norm(), 1.0F));
+  }
+}
+
+}
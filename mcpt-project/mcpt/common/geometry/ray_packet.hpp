@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cmath>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/assert.hpp"
+
+#include "mcpt/common/geometry/types.hpp"
+
+namespace mcpt {
+
+// a packet of up to N coherent rays traced together
+//
+// rays are stored both as `Ray' objects (for exact per-ray tests) and in SoA layout (for testing
+// all the rays against an AABB at once), the frustum bounds the origins and inverse directions of
+// all the active rays and is valid only if every active ray points to the same octant
+//
+// the storage is fixed to N rays so that a packet lives on the stack, N should match the tiles of
+// the caller, e.g. Wavefront::TILE_SIZE^2
+template <typename T, int N>
+struct RayPacket {
+  STATIC_ASSERT(N == 4 || N == 8 || N == 16, "packet size should be 4, 8 or 16");
+
+  using Scalar = T;
+  using Mask = Eigen::Array<bool, N, 1>;
+  using Vector3 = Eigen::Matrix<T, 3, 1>;
+  using Matrix3N = Eigen::Array<T, 3, N>;
+
+  static constexpr int SIZE = N;
+
+  // inactive lanes replicate the first ray so they never widen the frustum
+  std::array<Ray<T>, N> rays;
+  int num_rays;
+
+  Matrix3N origin;
+  Matrix3N inv_direction;
+  Mask active;
+
+  bool coherent = false;
+  Vector3 min_origin;
+  Vector3 max_origin;
+  Vector3 min_inv_direction;
+  Vector3 max_inv_direction;
+
+  // the rays are taken from a random access range of 1 to N rays
+  template <typename RandomIt>
+  RayPacket(RandomIt first, RandomIt last);
+
+  int size() const noexcept { return num_rays; }
+
+private:
+  template <typename RandomIt, size_t... I>
+  static std::array<Ray<T>, N> Gather(RandomIt first, int size, std::index_sequence<I...>) {
+    DASSERT(size > 0 && size <= N, "invalid packet size: {}", size);
+    return {{*(first + (int(I) < size ? int(I) : 0))...}};
+  }
+};
+
+template <typename T, int N>
+template <typename RandomIt>
+RayPacket<T, N>::RayPacket(RandomIt first, RandomIt last)
+    : rays(Gather(first, int(std::distance(first, last)), std::make_index_sequence<N>{}))
+    , num_rays(int(std::distance(first, last))) {
+  for (int i = 0; i < N; ++i) {
+    const auto& r = rays[i];
+    origin.col(i) = r.point_a;
+    for (int k = 0; k < 3; ++k) {
+      // replace zero components with the tiniest value of the same sign to keep the slab test
+      // free of `0 * inf'
+      T d = r.direction.coeff(k);
+      if (d == 0.0)
+        d = std::copysign(std::numeric_limits<T>::min(), d);
+      inv_direction(k, i) = 1.0 / d;
+    }
+    active.coeffRef(i) = i < size();
+  }
+
+  min_origin = origin.rowwise().minCoeff();
+  max_origin = origin.rowwise().maxCoeff();
+  min_inv_direction = inv_direction.rowwise().minCoeff();
+  max_inv_direction = inv_direction.rowwise().maxCoeff();
+  coherent = ((min_inv_direction.array() > 0.0) || (max_inv_direction.array() < 0.0)).all();
+}
+
+}  // namespace mcpt
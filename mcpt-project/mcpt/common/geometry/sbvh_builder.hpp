@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/trace.hpp"
+
+#include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/geometry/bvh_node.hpp"
+#include "mcpt/common/geometry/bvh_tree.hpp"
+
+namespace mcpt {
+
+// spatial split BVH builder (SBVH), see "Spatial Splits in Bounding Volume Hierarchies" (Stich et
+// al. 2009)
+// besides the binned SAH object splits, a node may be split by a plane which clips the polygons
+// crossing it, so that large polygons are referred by multiple leaves with tighter bounds
+template <typename T>
+class SBVHBuilder {
+public:
+  struct Options {
+    size_t num_bins = 32;
+    // maximum number of extra references relative to the number of primitives
+    T duplication_budget = T(0.5);
+    // try spatial splits only if the children of the object split overlap more than this ratio of
+    // the root surface area
+    T min_overlap_ratio = T(1e-5);
+  };
+
+  struct Stats {
+    size_t num_primitives = 0;
+    size_t num_references = 0;  // number of leaves
+    size_t num_spatial_splits = 0;
+  };
+
+  SBVHBuilder() = default;
+  explicit SBVHBuilder(const Options& options) : m_options(options) {}
+
+  auto& stats() const noexcept { return m_stats; }
+
+  template <typename MeshIt>
+  void AddMeshes(MeshIt first, MeshIt last);
+
+  // the instances (BVHInstance) are clipped as boxes
+  template <typename InstanceIt>
+  void AddInstances(InstanceIt first, InstanceIt last);
+
+  // build the tree over the added primitives, which are released afterwards
+  BVHTree<T> Build();
+
+private:
+  using Vector3 = Eigen::Matrix<T, 3, 1>;
+
+  struct Reference {
+    std::any leaf;
+    const std::vector<Vector3>* vertices = nullptr;  // polygon of the mesh, null for instances
+    AABB<T> aabb;                                    // clipped bounds
+  };
+  using References = std::vector<Reference>;
+
+  struct Split {
+    T cost = std::numeric_limits<T>::max();
+    Eigen::Index axis = 0;
+    T position = T(0);  // split plane
+    bool spatial = false;
+    AABB<T> l_aabb;
+    AABB<T> r_aabb;
+  };
+
+  std::unique_ptr<BVHNode<T>> BuildNode(References refs, const AABB<T>& aabb);
+
+  Split FindObjectSplit(const References& refs, const AABB<T>& centroid_aabb) const;
+  // the splits duplicating more than `max_duplicates' references are skipped
+  Split FindSpatialSplit(const References& refs, const AABB<T>& aabb, size_t max_duplicates) const;
+
+  void PartitionObject(References& refs, const Split& split, References& l, References& r) const;
+  void PartitionSpatial(References& refs, const Split& split, References& l, References& r);
+
+  // bounds of the part of the reference in the slab lo <= x[axis] <= hi
+  AABB<T> Clip(const Reference& ref, Eigen::Index axis, T lo, T hi) const;
+
+  Options m_options;
+  Stats m_stats;
+  References m_refs;
+
+  T m_root_area = T(0);
+  size_t m_max_references = 0;
+};
+
+namespace sbvh_internal {
+
+template <typename T>
+bool IsEmpty(const AABB<T>& aabb) {
+  return (aabb.min_vertex().array() > aabb.max_vertex().array()).any();
+}
+
+template <typename T>
+Eigen::Matrix<T, 3, 1> GetCentroid(const AABB<T>& aabb) {
+  return (aabb.min_vertex() + aabb.max_vertex()) / T(2);
+}
+
+template <typename T>
+T GetOverlapArea(const AABB<T>& lhs, const AABB<T>& rhs) {
+  AABB<T> overlap(lhs.min_vertex().cwiseMax(rhs.min_vertex()),
+                  lhs.max_vertex().cwiseMin(rhs.max_vertex()));
+  return IsEmpty(overlap) ? T(0) : overlap.GetSurfaceArea();
+}
+
+}  // namespace sbvh_internal
+
+template <typename T>
+template <typename MeshIt>
+void SBVHBuilder<T>::AddMeshes(MeshIt first, MeshIt last) {
+  for (; first != last; ++first) {
+    auto& ref = m_refs.emplace_back();
+    ref.leaf = std::cref(*first);
+    ref.vertices = &first->polygon.vertices;
+    for (const auto& v : first->polygon.vertices)
+      ref.aabb.Update(v);
+  }
+}
+
+template <typename T>
+template <typename InstanceIt>
+void SBVHBuilder<T>::AddInstances(InstanceIt first, InstanceIt last) {
+  for (; first != last; ++first) {
+    auto& ref = m_refs.emplace_back();
+    ref.leaf = std::cref(*first);
+    ref.aabb = first->aabb;
+  }
+}
+
+template <typename T>
+BVHTree<T> SBVHBuilder<T>::Build() {
+  TRACE_ZONE("construct SBVH");
+  DASSERT(!m_refs.empty());
+
+  AABB<T> root_aabb;
+  for (const auto& ref : m_refs)
+    root_aabb.Update(ref.aabb);
+
+  m_stats = Stats{m_refs.size(), m_refs.size(), 0};
+  m_root_area = root_aabb.GetSurfaceArea();
+  m_max_references = m_refs.size() + size_t(m_refs.size() * m_options.duplication_budget);
+
+  BVHTree<T> bvh_tree;
+  bvh_tree.root = BuildNode(std::move(m_refs), root_aabb);
+  bvh_tree.num_leaves = m_stats.num_references;
+  m_refs.clear();
+  return bvh_tree;
+}
+
+template <typename T>
+std::unique_ptr<BVHNode<T>> SBVHBuilder<T>::BuildNode(References refs, const AABB<T>& aabb) {
+  using namespace sbvh_internal;
+
+  if (refs.size() == 1) {
+    auto leaf = std::make_unique<BVHNode<T>>(refs.front().aabb);
+    leaf->mesh = std::move(refs.front().leaf);
+    return leaf;
+  }
+
+  AABB<T> centroid_aabb;
+  for (const auto& ref : refs)
+    centroid_aabb.Update(GetCentroid(ref.aabb));
+
+  // only try spatial splits if the object split leaves much overlap and the budget allows, the
+  // object split is kept if every spatial split would exceed the budget
+  Split split = FindObjectSplit(refs, centroid_aabb);
+  if (m_stats.num_references < m_max_references &&
+      GetOverlapArea(split.l_aabb, split.r_aabb) > m_options.min_overlap_ratio * m_root_area) {
+    Split spatial_split = FindSpatialSplit(refs, aabb, m_max_references - m_stats.num_references);
+    if (spatial_split.cost < split.cost)
+      split = spatial_split;
+  }
+
+  References l_refs;
+  References r_refs;
+  if (split.spatial)
+    PartitionSpatial(refs, split, l_refs, r_refs);
+  else if (split.cost < std::numeric_limits<T>::max())
+    PartitionObject(refs, split, l_refs, r_refs);
+  else
+    l_refs = std::move(refs);
+  refs = References();
+
+  // all the centroids coincide or the rounding puts all the references on one side
+  if (l_refs.empty())
+    std::swap(l_refs, r_refs);
+  if (r_refs.empty()) {
+    auto middle = l_refs.begin() + l_refs.size() / 2;
+    r_refs.assign(std::make_move_iterator(middle), std::make_move_iterator(l_refs.end()));
+    l_refs.erase(middle, l_refs.end());
+  }
+
+  AABB<T> l_aabb;
+  for (const auto& ref : l_refs)
+    l_aabb.Update(ref.aabb);
+  AABB<T> r_aabb;
+  for (const auto& ref : r_refs)
+    r_aabb.Update(ref.aabb);
+
+  auto node = std::make_unique<BVHNode<T>>(aabb);
+  node->l_child = BuildNode(std::move(l_refs), l_aabb);
+  node->r_child = BuildNode(std::move(r_refs), r_aabb);
+  node->sah_cost = node->GetSAHCost(node->l_child->sah_cost, node->r_child->sah_cost);
+  return node;
+}
+
+template <typename T>
+typename SBVHBuilder<T>::Split SBVHBuilder<T>::FindObjectSplit(
+    const References& refs, const AABB<T>& centroid_aabb) const {
+  using namespace sbvh_internal;
+
+  size_t num_bins = m_options.num_bins;
+  std::vector<AABB<T>> bin_aabbs(num_bins);
+  std::vector<size_t> bin_counts(num_bins);
+  std::vector<AABB<T>> r_aabbs(num_bins);
+
+  Split split;
+  Vector3 extent = centroid_aabb.GetDiagonal();
+  for (Eigen::Index axis = 0; axis < 3; ++axis) {
+    if (extent.coeff(axis) <= T(0))
+      continue;
+
+    // bin the references by the centroids
+    T lo = centroid_aabb.min_vertex().coeff(axis);
+    T scale = T(num_bins) / extent.coeff(axis);
+    std::fill(bin_aabbs.begin(), bin_aabbs.end(), AABB<T>());
+    std::fill(bin_counts.begin(), bin_counts.end(), 0);
+    for (const auto& ref : refs) {
+      auto bin = size_t((GetCentroid(ref.aabb).coeff(axis) - lo) * scale);
+      bin = std::min(bin, num_bins - 1);
+      bin_aabbs[bin].Update(ref.aabb);
+      ++bin_counts[bin];
+    }
+
+    // sweep from right to left then from left to right
+    AABB<T> r_aabb;
+    for (size_t i = num_bins - 1; i > 0; --i) {
+      r_aabb.Update(bin_aabbs[i]);
+      r_aabbs[i] = r_aabb;
+    }
+    AABB<T> l_aabb;
+    size_t l_count = 0;
+    for (size_t i = 1; i < num_bins; ++i) {
+      l_aabb.Update(bin_aabbs[i - 1]);
+      l_count += bin_counts[i - 1];
+      size_t r_count = refs.size() - l_count;
+      if (l_count == 0 || r_count == 0)
+        continue;
+
+      T cost = l_aabb.GetSurfaceArea() * l_count + r_aabbs[i].GetSurfaceArea() * r_count;
+      if (cost < split.cost) {
+        split.cost = cost;
+        split.axis = axis;
+        split.position = lo + T(i) / scale;
+        split.l_aabb = l_aabb;
+        split.r_aabb = r_aabbs[i];
+      }
+    }
+  }
+  return split;
+}
+
+template <typename T>
+typename SBVHBuilder<T>::Split SBVHBuilder<T>::FindSpatialSplit(const References& refs,
+                                                                const AABB<T>& aabb,
+                                                                size_t max_duplicates) const {
+  size_t num_bins = m_options.num_bins;
+  std::vector<AABB<T>> bin_aabbs(num_bins);
+  std::vector<size_t> entries(num_bins);
+  std::vector<size_t> exits(num_bins);
+  std::vector<AABB<T>> r_aabbs(num_bins);
+
+  Split split;
+  split.spatial = true;
+  Vector3 extent = aabb.GetDiagonal();
+  for (Eigen::Index axis = 0; axis < 3; ++axis) {
+    if (extent.coeff(axis) <= T(0))
+      continue;
+
+    // chop the references into the bins
+    T lo = aabb.min_vertex().coeff(axis);
+    T width = extent.coeff(axis) / T(num_bins);
+    std::fill(bin_aabbs.begin(), bin_aabbs.end(), AABB<T>());
+    std::fill(entries.begin(), entries.end(), 0);
+    std::fill(exits.begin(), exits.end(), 0);
+    auto to_bin = [&](T x) {
+      return std::min(size_t(std::max(T(0), (x - lo) / width)), num_bins - 1);
+    };
+    for (const auto& ref : refs) {
+      size_t first = to_bin(ref.aabb.min_vertex().coeff(axis));
+      size_t last = to_bin(ref.aabb.max_vertex().coeff(axis));
+      if (first == last) {
+        bin_aabbs[first].Update(ref.aabb);
+      } else {
+        for (size_t i = first; i <= last; ++i)
+          bin_aabbs[i].Update(Clip(ref, axis, lo + T(i) * width, lo + T(i + 1) * width));
+      }
+      ++entries[first];
+      ++exits[last];
+    }
+
+    // sweep from right to left then from left to right
+    AABB<T> r_aabb;
+    std::vector<size_t> r_counts(num_bins);
+    size_t r_count = 0;
+    for (size_t i = num_bins - 1; i > 0; --i) {
+      r_aabb.Update(bin_aabbs[i]);
+      r_count += exits[i];
+      r_aabbs[i] = r_aabb;
+      r_counts[i] = r_count;
+    }
+    AABB<T> l_aabb;
+    size_t l_count = 0;
+    for (size_t i = 1; i < num_bins; ++i) {
+      l_aabb.Update(bin_aabbs[i - 1]);
+      l_count += entries[i - 1];
+      // each side must have fewer references to make progress
+      if (l_count == 0 || r_counts[i] == 0 || l_count >= refs.size() ||
+          r_counts[i] >= refs.size())
+        continue;
+      // the references straddling the plane are counted on both sides, the actual partition may
+      // duplicate fewer of them if a clipped part is empty
+      if (l_count + r_counts[i] - refs.size() > max_duplicates)
+        continue;
+
+      T cost = l_aabb.GetSurfaceArea() * l_count + r_aabbs[i].GetSurfaceArea() * r_counts[i];
+      if (cost < split.cost) {
+        split.cost = cost;
+        split.axis = axis;
+        split.position = lo + T(i) * width;
+        split.l_aabb = l_aabb;
+        split.r_aabb = r_aabbs[i];
+      }
+    }
+  }
+  return split;
+}
+
+template <typename T>
+void SBVHBuilder<T>::PartitionObject(References& refs,
+                                     const Split& split,
+                                     References& l,
+                                     References& r) const {
+  using namespace sbvh_internal;
+
+  for (auto& ref : refs) {
+    if (GetCentroid(ref.aabb).coeff(split.axis) < split.position)
+      l.push_back(std::move(ref));
+    else
+      r.push_back(std::move(ref));
+  }
+}
+
+template <typename T>
+void SBVHBuilder<T>::PartitionSpatial(References& refs,
+                                      const Split& split,
+                                      References& l,
+                                      References& r) {
+  using namespace sbvh_internal;
+
+  for (auto& ref : refs) {
+    T ref_lo = ref.aabb.min_vertex().coeff(split.axis);
+    T ref_hi = ref.aabb.max_vertex().coeff(split.axis);
+    if (ref_hi <= split.position) {
+      l.push_back(std::move(ref));
+      continue;
+    }
+    if (ref_lo >= split.position) {
+      r.push_back(std::move(ref));
+      continue;
+    }
+
+    // the reference straddles the split plane, refer to it from both sides
+    AABB<T> l_aabb = Clip(ref, split.axis, ref_lo, split.position);
+    AABB<T> r_aabb = Clip(ref, split.axis, split.position, ref_hi);
+    if (IsEmpty(l_aabb)) {
+      ref.aabb = r_aabb;
+      r.push_back(std::move(ref));
+    } else if (IsEmpty(r_aabb)) {
+      ref.aabb = l_aabb;
+      l.push_back(std::move(ref));
+    } else {
+      ++m_stats.num_references;
+      auto& l_ref = l.emplace_back(ref);
+      l_ref.aabb = l_aabb;
+      ref.aabb = r_aabb;
+      r.push_back(std::move(ref));
+    }
+  }
+  ++m_stats.num_spatial_splits;
+}
+
+template <typename T>
+AABB<T> SBVHBuilder<T>::Clip(const Reference& ref, Eigen::Index axis, T lo, T hi) const {
+  using namespace sbvh_internal;
+
+  AABB<T> aabb;
+  if (ref.vertices) {
+    // clip the convex polygon by the two planes of the slab (Sutherland-Hodgman)
+    std::vector<Vector3> polygon = *ref.vertices;
+    std::vector<Vector3> clipped;
+    for (T sign : {T(1), T(-1)}) {
+      // keep sign * (x[axis] - plane) >= 0
+      T plane = sign > T(0) ? lo : hi;
+      clipped.clear();
+      for (size_t i = 0; i < polygon.size(); ++i) {
+        const Vector3& a = polygon[i];
+        const Vector3& b = polygon[(i + 1) % polygon.size()];
+        T da = sign * (a.coeff(axis) - plane);
+        T db = sign * (b.coeff(axis) - plane);
+        if (da >= T(0))
+          clipped.push_back(a);
+        if ((da < T(0)) != (db < T(0)))
+          clipped.push_back(a + (b - a) * (da / (da - db)));
+      }
+      std::swap(polygon, clipped);
+    }
+    for (const auto& v : polygon)
+      aabb.Update(v);
+  } else {
+    aabb = ref.aabb;
+  }
+
+  // stay inside the slab & the previously clipped bounds
+  Vector3 min_vertex = aabb.min_vertex().cwiseMax(ref.aabb.min_vertex());
+  Vector3 max_vertex = aabb.max_vertex().cwiseMin(ref.aabb.max_vertex());
+  min_vertex.coeffRef(axis) = std::max(min_vertex.coeff(axis), lo);
+  max_vertex.coeffRef(axis) = std::min(max_vertex.coeff(axis), hi);
+  AABB<T> clipped_aabb(min_vertex, max_vertex);
+  return IsEmpty(clipped_aabb) ? AABB<T>() : clipped_aabb;
+}
+
+}  // namespace mcpt
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <iterator>
 #include <vector>
 
@@ -24,9 +27,18 @@ struct Ray : Line<T> {
   using Scalar = T;
   Eigen::Matrix<T, 3, 1> direction;
 
+  // precomputed for the slab tests, the zero components of the direction give infinities
+  Eigen::Matrix<T, 3, 1> inv_direction;
+  // 1 if the component of the direction is negative (including -0)
+  std::array<uint8_t, 3> sign;
+
   template <typename P, typename D>
   Ray(const Eigen::MatrixBase<P>& start_point, const Eigen::MatrixBase<D>& d)
-      : Line<T>(start_point, start_point + d), direction(d.normalized()) {}
+      : Line<T>(start_point, start_point + d), direction(d.normalized()) {
+    inv_direction = direction.cwiseInverse();
+    for (int i = 0; i < 3; ++i)
+      sign[i] = std::signbit(direction.coeff(i));
+  }
 };
 
 template <typename T>
@@ -80,4 +80,51 @@ void RawToPPM(unsigned int w, unsigned int h, float gamma, const float im[], std
     fmt::print(ofs, "{:>3} {:>3} {:>3}\n", remap[i], remap[i + 1], remap[i + 2]);
 }
 
+/**
+ * PF (RGB) or Pf (grayscale)
+ * <width> <height>
+ * -1.0 (little endian)
+ * <rows of floats from bottom to top>
+ */
+void RawToPFM(unsigned int w, unsigned int h, const float im[], std::ofstream& ofs) {
+  ASSERT(ofs.is_open(), "not a invalid file");
+  STATIC_ASSERT(sizeof(float) == 4, "PFM needs 32-bit floats");
+
+  // header
+  fmt::print(ofs, "PF\n{} {}\n-1.0\n", w, h);
+  for (size_t v = h; v-- > 0;)
+    ofs.write(reinterpret_cast<const char*>(im + v * w * 3), sizeof(float) * w * 3);
+}
+
+void GrayToPFM(unsigned int w, unsigned int h, const float im[], std::ofstream& ofs) {
+  ASSERT(ofs.is_open(), "not a invalid file");
+  STATIC_ASSERT(sizeof(float) == 4, "PFM needs 32-bit floats");
+
+  // header
+  fmt::print(ofs, "Pf\n{} {}\n-1.0\n", w, h);
+  for (size_t v = h; v-- > 0;)
+    ofs.write(reinterpret_cast<const char*>(im + v * w), sizeof(float) * w);
+}
+
+bool PFMToRaw(std::ifstream& ifs, unsigned int& w, unsigned int& h, std::vector<float>& im) {
+  std::string magic;
+  float scale = 0.0F;
+  ifs >> magic >> w >> h >> scale;
+  // skip the single whitespace after the header
+  ifs.get();
+  if (!ifs || magic != "PF" || scale >= 0.0F) {
+    spdlog::error("not a little endian RGB PFM image");
+    return false;
+  }
+
+  im.resize(size_t(w) * h * 3);
+  for (size_t v = h; v-- > 0;)
+    ifs.read(reinterpret_cast<char*>(im.data() + v * w * 3), sizeof(float) * w * 3);
+  if (!ifs) {
+    spdlog::error("truncated PFM image: {}x{}", w, h);
+    return false;
+  }
+  return true;
+}
+
 }  // namespace mcpt
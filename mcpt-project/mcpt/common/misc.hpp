@@ -17,4 +17,10 @@ void DepthToPPM(unsigned int w, unsigned int h, const float im[], std::ofstream&
 // remap raw image to RGB color with gamma corrected and save
 void RawToPPM(unsigned int w, unsigned int h, float gamma, const float im[], std::ofstream& ofs);
 
+// save/load raw RGB image as PFM (portable float map), without any remapping
+void RawToPFM(unsigned int w, unsigned int h, const float im[], std::ofstream& ofs);
+// save single channel float image as grayscale PFM
+void GrayToPFM(unsigned int w, unsigned int h, const float im[], std::ofstream& ofs);
+bool PFMToRaw(std::ifstream& ifs, unsigned int& w, unsigned int& h, std::vector<float>& im);
+
 }  // namespace mcpt
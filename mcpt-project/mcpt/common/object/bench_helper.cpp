@@ -0,0 +1,78 @@
+#include "mcpt/common/object/bench_helper.hpp"
+
+#include <cmath>
+#include <memory>
+
+#include "mcpt/common/random.hpp"
+#include "mcpt/common/random_triangle.hpp"
+
+namespace mcpt::bench {
+
+namespace {
+
+constexpr unsigned int SEED = 42;
+
+// max coordinate offset of the vertices from the triangle center
+constexpr float TRIANGLE_SIZE = 1.0F;
+
+Eigen::Vector3f RandomPoint(Uniform<float>& uniform, float extent) {
+  return Eigen::Vector3f(uniform.Random(), uniform.Random(), uniform.Random()) * extent;
+}
+
+}  // namespace
+
+std::vector<Mesh> RandomTriangleMeshes(size_t num) {
+  Uniform<float>::Seed(SEED);
+  Uniform<float> uniform;
+
+  std::vector<Mesh> meshes;
+  meshes.reserve(num);
+  while (meshes.size() < num) {
+    Eigen::Vector3f center = RandomPoint(uniform, RandomScene::SCENE_EXTENT);
+    Eigen::Vector3f a = center + RandomPoint(uniform, TRIANGLE_SIZE);
+    Eigen::Vector3f b = center + RandomPoint(uniform, TRIANGLE_SIZE);
+    Eigen::Vector3f c = center + RandomPoint(uniform, TRIANGLE_SIZE);
+
+    // reject degenerated triangles
+    Eigen::Vector3f normal = (b - a).cross(c - a);
+    if (normal.norm() <= Eigen::NumTraits<float>::dummy_precision())
+      continue;
+
+    Polygon2D<float> text_coords(Eigen::Vector2f(0.0F, 0.0F),
+                                 Eigen::Vector2f(1.0F, 0.0F),
+                                 Eigen::Vector2f(0.0F, 1.0F));
+    meshes.push_back({"", ConvexPolygon<float>(a, b, c), text_coords, normal.normalized()});
+  }
+  return meshes;
+}
+
+const RandomScene& GetRandomScene(size_t num_triangles, size_t num_rays) {
+  static std::unique_ptr<RandomScene> scene;
+  if (scene && scene->meshes.size() == num_triangles && scene->rays.size() == num_rays)
+    return *scene;
+
+  // release the previous scene first
+  scene.reset();
+  scene = std::make_unique<RandomScene>();
+  scene->meshes = RandomTriangleMeshes(num_triangles);
+  scene->bvh_tree.Construct(scene->meshes.cbegin(), scene->meshes.cend());
+
+  Uniform<float>::Seed(SEED);
+  Uniform<size_t>::Seed(SEED);
+  Uniform<float> uniform;
+  Uniform<size_t> uniform_index;
+  UniformTriangle<float> uniform_triangle;
+  for (size_t i = 0; i < num_rays; ++i) {
+    const Mesh& target = scene->meshes[uniform_index.Random(0, num_triangles - 1)];
+    const auto& verts = target.polygon.vertices;
+
+    Eigen::Vector3f start_point = RandomPoint(uniform, RandomScene::SCENE_EXTENT);
+    Eigen::Vector3f target_point = uniform_triangle.Random(verts[0], verts[1], verts[2]);
+    scene->rays.emplace_back(start_point, target_point - start_point);
+    scene->targets.push_back(&target);
+    scene->distances.push_back((target_point - start_point).norm());
+  }
+  return *scene;
+}
+
+}  // namespace mcpt::bench
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/geometry/bvh_tree.hpp"
+#include "mcpt/common/geometry/types.hpp"
+#include "mcpt/common/object/mesh.hpp"
+
+namespace mcpt::bench {
+
+// synthetic scene of random triangles scattered in the cube [0, SCENE_EXTENT]^3
+struct RandomScene {
+  static constexpr float SCENE_EXTENT = 100.0F;
+
+  std::vector<Mesh> meshes;
+  BVHTree<float> bvh_tree;
+
+  // rays starting from random points in the cube and aiming at some point on some mesh
+  std::vector<Ray<float>> rays;
+  std::vector<const Mesh*> targets;
+  std::vector<float> distances;
+};
+
+// generate `num' random triangle meshes with a fixed seed
+std::vector<Mesh> RandomTriangleMeshes(size_t num);
+
+// return the random scene with `num_triangles' meshes and its BVH tree
+// the last generated scene is cached since large scenes are expensive to build
+const RandomScene& GetRandomScene(size_t num_triangles, size_t num_rays = 1024);
+
+}  // namespace mcpt::bench
@@ -29,6 +29,13 @@ struct Mesh {
   Eigen::Vector3f normal;
 };
 
+// placement of a prototype (named mesh groups) in the world, all the instances of a prototype
+// share its meshes
+struct MeshInstance {
+  std::string prototype;
+  Eigen::Matrix<float, 3, 4> transform;  // from the prototype space to the world space
+};
+
 inline bool operator==(const MeshIndex& lhs, const MeshIndex& rhs) {
   return lhs.vindex == rhs.vindex && lhs.tindex == rhs.tindex && lhs.nindex == rhs.nindex;
 }
@@ -37,4 +44,8 @@ inline bool operator==(const MeshIndexGroup& lhs, const MeshIndexGroup& rhs) {
   return lhs.material == rhs.material && lhs.mesh_index == rhs.mesh_index;
 }
 
+inline bool operator==(const MeshInstance& lhs, const MeshInstance& rhs) {
+  return lhs.prototype == rhs.prototype && lhs.transform == rhs.transform;
+}
+
 }  // namespace mcpt
@@ -1,44 +1,170 @@
 #include "mcpt/common/object/object.hpp"
 
+#include <algorithm>
+#include <any>
+#include <functional>
 #include <limits>
 
 #include <spdlog/spdlog.h>
 
 #include "mcpt/common/assert.hpp"
+#include "mcpt/common/trace.hpp"
+
+#include "mcpt/common/geometry/sbvh_builder.hpp"
 
 namespace mcpt {
 
+namespace {
+
+AABB<float> GetLeafBounds(const std::any& leaf) {
+  using InstanceRef = std::reference_wrapper<const BVHInstance<float>>;
+  if (auto instance = std::any_cast<InstanceRef>(&leaf))
+    return instance->get().aabb;
+
+  AABB<float> aabb;
+  const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(leaf);
+  for (const auto& v : mesh.polygon.vertices)
+    aabb.Update(v);
+  return aabb;
+}
+
+}  // namespace
+
 const Material& Object::GetMaterialByName(const std::string& name) const {
   return m_materials.at(name);
 }
 
-BVHTree<float> Object::CreateBVHTree() {
+BVHTree<float> Object::CreateBVHTree(bool spatial_splits) {
+  TRACE_ZONE("create BVH tree");
   spdlog::info("construct BVH tree from object:");
   spdlog::info("  #vertex: {}", m_vertices.size());
   spdlog::info("  #texture coordinate: {}", m_text_coords.size());
   spdlog::info("  #normal: {}", m_normals.size());
   spdlog::info("  #mesh group: {}", m_mesh_groups.size());
-
-  size_t num_meshes = 0;
+  spdlog::info("  #prototype: {}", m_prototypes.size());
+  spdlog::info("  #instance: {}", m_instances.size());
 
   Eigen::Vector3f min_mesh_vertex = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
   Eigen::Vector3f max_mesh_vertex = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
 
   // construct all meshes
-  for (const auto& [material, mesh_index] : m_mesh_groups) {
-    num_meshes += mesh_index.size();
+  CreateMeshes(m_mesh_groups, m_meshes);
+  for (const auto& mesh : m_meshes) {
+    for (const auto& v : mesh.polygon.vertices) {
+      min_mesh_vertex = min_mesh_vertex.cwiseMin(v);
+      max_mesh_vertex = max_mesh_vertex.cwiseMax(v);
+    }
+  }
+
+  for (const auto& mesh : m_meshes) {
+    if (Material::Type(GetMaterialByName(mesh.material)) == Material::EM)
+      m_light_sources.emplace_back(mesh);
+  }
+
+  // construct the bottom level trees, one for each prototype
+  size_t num_prototype_meshes = 0;
+  for (const auto& [name, mesh_groups] : m_prototypes) {
+    auto& meshes = m_prototype_meshes[name];
+    CreateMeshes(mesh_groups, meshes);
+    ASSERT(!meshes.empty(), "prototype `{}' has no mesh", name);
+    num_prototype_meshes += meshes.size();
+
+    // the light sampler only knows the meshes in the world space
+    for (const auto& mesh : meshes) {
+      ASSERT(Material::Type(GetMaterialByName(mesh.material)) != Material::EM,
+             "light source can not be instanced: prototype `{}'",
+             name);
+    }
+
+    auto bvh_tree = std::make_shared<BVHTree<float>>();
+    if (spatial_splits) {
+      SBVHBuilder<float> builder;
+      builder.AddMeshes(meshes.cbegin(), meshes.cend());
+      *bvh_tree = builder.Build();
+    } else {
+      bvh_tree->Construct(meshes.cbegin(), meshes.cend());
+    }
+    m_prototype_trees[name] = std::move(bvh_tree);
+  }
+
+  // place the bottom level trees in the world
+  size_t num_instanced_meshes = 0;
+  for (const auto& [prototype, transform] : m_instances) {
+    auto it = m_prototype_trees.find(prototype);
+    ASSERT(it != m_prototype_trees.cend(), "prototype `{}' is not declared", prototype);
+    m_bvh_instances.emplace_back(*it->second, transform);
+    num_instanced_meshes += it->second->num_leaves;
+  }
+
+  static const Eigen::IOFormat FMT{Eigen::StreamPrecision, Eigen::DontAlignCols, " ", " "};
+
+  spdlog::info("total meshes: {}", m_meshes.size());
+  spdlog::info("  min: {}", min_mesh_vertex.format(FMT));
+  spdlog::info("  max: {}", max_mesh_vertex.format(FMT));
+  spdlog::info("instanced meshes: {} ({} stored)", num_instanced_meshes, num_prototype_meshes);
+
+  BVHTree<float> bvh_tree;
+  if (spatial_splits) {
+    SBVHBuilder<float> builder;
+    builder.AddMeshes(m_meshes.cbegin(), m_meshes.cend());
+    builder.AddInstances(m_bvh_instances.cbegin(), m_bvh_instances.cend());
+    bvh_tree = builder.Build();
+
+    const auto& stats = builder.stats();
+    spdlog::info("SBVH references: {} ({} duplicated), spatial splits: {}",
+                 stats.num_references,
+                 stats.num_references - stats.num_primitives,
+                 stats.num_spatial_splits);
+  } else {
+    bvh_tree.Construct(
+        m_meshes.cbegin(), m_meshes.cend(), m_bvh_instances.cbegin(), m_bvh_instances.cend());
+  }
+
+  spdlog::info("BVH tree leaves: {}", bvh_tree.num_leaves);
+  spdlog::info("  SAH cost: {}", bvh_tree.root->sah_cost);
+  spdlog::info("  min: {}", bvh_tree.root->aabb.min_vertex().format(FMT));
+  spdlog::info("  max: {}", bvh_tree.root->aabb.max_vertex().format(FMT));
+
+  return bvh_tree;
+}
+
+BVHTree<float>::RefitStats Object::UpdateBVHTree(BVHTree<float>& bvh_tree) {
+  TRACE_ZONE("update BVH tree");
+  UpdateMeshes(m_mesh_groups, m_meshes);
+
+  // refit the bottom level trees first, the instance bounds depend on them
+  size_t num_rebuilt_leaves = 0;
+  for (auto& [name, meshes] : m_prototype_meshes) {
+    UpdateMeshes(m_prototypes.at(name), meshes);
+    num_rebuilt_leaves += m_prototype_trees.at(name)->Refit(GetLeafBounds).num_rebuilt_leaves;
+  }
+
+  ASSERT(m_bvh_instances.size() == m_instances.size(), "instances can not be added or removed");
+  for (size_t i = 0; i < m_instances.size(); ++i) {
+    const auto& [prototype, transform] = m_instances[i];
+    m_bvh_instances[i] = BVHInstance<float>(*m_prototype_trees.at(prototype), transform);
+  }
+
+  auto stats = bvh_tree.Refit(GetLeafBounds);
+  stats.num_rebuilt_leaves += num_rebuilt_leaves;
+  spdlog::debug("refit BVH tree: SAH cost {} -> {}, rebuilt leaves: {}",
+                stats.sah_cost_before,
+                stats.sah_cost_after,
+                stats.num_rebuilt_leaves);
+  return stats;
+}
 
+void Object::CreateMeshes(const std::vector<MeshIndexGroup>& mesh_groups,
+                          std::vector<Mesh>& meshes) const {
+  for (const auto& [material, mesh_index] : mesh_groups) {
     for (const auto& [vindex, tindex, nindex] : mesh_index) {
       ASSERT(vindex.size() == tindex.size());
       ASSERT(vindex.size() == nindex.size());
       ASSERT(vindex.size() >= 3);
 
       std::vector<Eigen::Vector3f> vertices;
-      for (size_t index : vindex) {
-        min_mesh_vertex = min_mesh_vertex.cwiseMin(m_vertices.at(index));
-        max_mesh_vertex = max_mesh_vertex.cwiseMax(m_vertices.at(index));
+      for (size_t index : vindex)
         vertices.push_back(m_vertices.at(index));
-      }
 
       std::vector<Eigen::Vector2f> text_coords;
       for (size_t index : tindex)
@@ -51,29 +177,17 @@ BVHTree<float> Object::CreateBVHTree() {
       else
         normal = -normal.normalized();
 
-      m_meshes.push_back({material, ConvexPolygon{vertices}, Polygon2D{text_coords}, normal});
+      meshes.push_back({material, ConvexPolygon{vertices}, Polygon2D{text_coords}, normal});
     }
   }
+}
 
-  for (const auto& mesh : m_meshes) {
-    if (Material::Type(GetMaterialByName(mesh.material)) == Material::EM)
-      m_light_sources.emplace_back(mesh);
-  }
-
-  static const Eigen::IOFormat FMT{Eigen::StreamPrecision, Eigen::DontAlignCols, " ", " "};
-
-  spdlog::info("total meshes: {}", num_meshes);
-  spdlog::info("  min: {}", min_mesh_vertex.format(FMT));
-  spdlog::info("  max: {}", max_mesh_vertex.format(FMT));
-
-  BVHTree<float> bvh_tree;
-  bvh_tree.Construct(m_meshes.cbegin(), m_meshes.cend());
-
-  spdlog::info("BVH tree leaves: {}", bvh_tree.num_leaves);
-  spdlog::info("  min: {}", bvh_tree.root->aabb.min_vertex().format(FMT));
-  spdlog::info("  max: {}", bvh_tree.root->aabb.max_vertex().format(FMT));
-
-  return bvh_tree;
+void Object::UpdateMeshes(const std::vector<MeshIndexGroup>& mesh_groups,
+                          std::vector<Mesh>& meshes) const {
+  std::vector<Mesh> updated_meshes;
+  CreateMeshes(mesh_groups, updated_meshes);
+  ASSERT(updated_meshes.size() == meshes.size(), "meshes can not be added or removed");
+  std::move(updated_meshes.begin(), updated_meshes.end(), meshes.begin());
 }
 
 }  // namespace mcpt
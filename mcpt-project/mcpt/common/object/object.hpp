@@ -1,12 +1,14 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <Eigen/Eigen>
 
+#include "mcpt/common/geometry/bvh_instance.hpp"
 #include "mcpt/common/geometry/bvh_tree.hpp"
 
 #include "mcpt/common/object/material.hpp"
@@ -22,6 +24,12 @@ public:
   auto& mesh_groups() const noexcept { return m_mesh_groups; }
   auto& mesh_groups() noexcept { return m_mesh_groups; }
 
+  auto& prototypes() const noexcept { return m_prototypes; }
+  auto& prototypes() noexcept { return m_prototypes; }
+
+  auto& instances() const noexcept { return m_instances; }
+  auto& instances() noexcept { return m_instances; }
+
   auto& vertices() const noexcept { return m_vertices; }
   auto& vertices() noexcept { return m_vertices; }
 
@@ -37,18 +45,40 @@ public:
   const Material& GetMaterialByName(const std::string& name) const;
 
   // create a BVH tree and bind the current object to it
-  BVHTree<float> CreateBVHTree();
+  // the instances are bound as the leaves of it referring to the bottom level trees of prototypes
+  // large polygons are clipped & referred by multiple leaves if spatial splits are enabled (SBVH)
+  BVHTree<float> CreateBVHTree(bool spatial_splits = false);
+
+  // update the meshes after editing the vertices or the instance transforms, then refit the BVH
+  // tree created by CreateBVHTree, the mesh groups & instances must not be added or removed
+  // the renderers sampling the light sources must be recreated after updating
+  BVHTree<float>::RefitStats UpdateBVHTree(BVHTree<float>& bvh_tree);
 
 private:
+  void CreateMeshes(const std::vector<MeshIndexGroup>& mesh_groups,
+                    std::vector<Mesh>& meshes) const;
+
+  // recreate the meshes in place so that the references to them are still valid
+  void UpdateMeshes(const std::vector<MeshIndexGroup>& mesh_groups,
+                    std::vector<Mesh>& meshes) const;
+
   std::unordered_map<std::string, Material> m_materials;
   std::vector<MeshIndexGroup> m_mesh_groups;
 
+  std::unordered_map<std::string, std::vector<MeshIndexGroup>> m_prototypes;
+  std::vector<MeshInstance> m_instances;
+
   std::vector<Eigen::Vector3f> m_vertices;
   std::vector<Eigen::Vector2f> m_text_coords;
   std::vector<Eigen::Vector3f> m_normals;
 
   std::vector<Mesh> m_meshes;
   std::vector<std::reference_wrapper<const Mesh>> m_light_sources;
+
+  // meshes of the prototypes in their own spaces, shared by all the instances
+  std::unordered_map<std::string, std::vector<Mesh>> m_prototype_meshes;
+  std::unordered_map<std::string, std::shared_ptr<BVHTree<float>>> m_prototype_trees;
+  std::vector<BVHInstance<float>> m_bvh_instances;
 };
 
 }  // namespace mcpt
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <cmath>
+#include <algorithm>
 #include <random>
 #include <type_traits>
+#include <vector>
+
+#include "mcpt/common/fast_math.hpp"
 
 namespace mcpt {
 
@@ -14,12 +18,11 @@ class Uniform<T, std::enable_if_t<std::is_floating_point_v<T>>> {
 public:
   using Scalar = T;
 
+  // reseed the generator of the calling thread, for reproducible sampling
+  static void Seed(unsigned int seed) { generator().seed(seed); }
+
   T Random() {
-#ifndef NDEBUG
-    static thread_local std::mt19937 gen{0};
-#else
-    static thread_local std::mt19937 gen{std::random_device{}()};
-#endif
+    auto& gen = generator();
     // according to:
     // https://en.cppreference.com/w/cpp/numeric/random/uniform_real_distribution#Notes
     //
@@ -34,6 +37,27 @@ public:
       u = uniform(gen);
     return u;
   }
+
+  // fill u[0, n) with the numbers in [0,1)
+  void Random(T u[], size_t n) {
+    auto& gen = generator();
+    std::uniform_real_distribution<T> uniform(0.0, 1.0);
+    for (size_t i = 0; i < n; ++i) {
+      do {
+        u[i] = uniform(gen);
+      } while (u[i] == 1.0);
+    }
+  }
+
+private:
+  static std::mt19937& generator() {
+#ifndef NDEBUG
+    static thread_local std::mt19937 gen{0};
+#else
+    static thread_local std::mt19937 gen{std::random_device{}()};
+#endif
+    return gen;
+  }
 };
 
 template <typename T>
@@ -41,24 +65,74 @@ class Uniform<T, std::enable_if_t<std::is_integral_v<T>>> {
 public:
   using Scalar = T;
 
+  // reseed the generator of the calling thread, for reproducible sampling
+  static void Seed(unsigned int seed) { generator().seed(seed); }
+
   T Random(T min, T max) {
+    // [min,max]
+    return std::uniform_int_distribution<T>{min, max}(generator());
+  }
+
+private:
+  static std::mt19937& generator() {
 #ifndef NDEBUG
     static thread_local std::mt19937 gen{0};
 #else
     static thread_local std::mt19937 gen{std::random_device{}()};
 #endif
-    // [min,max]
-    return std::uniform_int_distribution<T>{min, max}(gen);
+    return gen;
   }
 };
 
+// a direction in the hemisphere around +z, by the sines & cosines of its angles:
+// (sin_depression * cos_azimuth, sin_depression * sin_azimuth, cos_depression)
 template <typename T>
 struct SolidAngle {
-  T azimuth;     // [0, 2pi)
-  T depression;  // [0, pi/2)
+  T cos_azimuth;  // azimuth in [0, 2pi)
+  T sin_azimuth;
+  T cos_depression;  // depression in [0, pi/2)
+  T sin_depression;
   double pdf;
 };
 
+// a batch of SolidAngle in SoA, filled by the batch samplers below, whose loops are vectorized
+template <typename T>
+struct SolidAngleBatch {
+  std::vector<T> cos_azimuth;
+  std::vector<T> sin_azimuth;
+  std::vector<T> cos_depression;
+  std::vector<T> sin_depression;
+  std::vector<T> pdf;
+
+  size_t size() const noexcept { return pdf.size(); }
+
+  void resize(size_t n) {
+    cos_azimuth.resize(n);
+    sin_azimuth.resize(n);
+    cos_depression.resize(n);
+    sin_depression.resize(n);
+    pdf.resize(n);
+  }
+
+  SolidAngle<T> operator[](size_t i) const {
+    return {cos_azimuth[i], sin_azimuth[i], cos_depression[i], sin_depression[i], pdf[i]};
+  }
+};
+
+namespace detail {
+
+// fill the azimuths of the batch uniformly in [0, 2pi), with the PDFs as the scratch of the angles
+template <typename T>
+void RandomAzimuths(Uniform<T>& uniform, size_t n, SolidAngleBatch<T>& batch) {
+  constexpr T TWO_PI = 2.0 * M_PI;
+  uniform.Random(batch.pdf.data(), n);
+  for (size_t i = 0; i < n; ++i)
+    batch.pdf[i] *= TWO_PI;
+  math::SinCos(batch.pdf.data(), batch.sin_azimuth.data(), batch.cos_azimuth.data(), n);
+}
+
+}  // namespace detail
+
 // uniform weigted distribution on a hemisphere
 template <typename T>
 class UniformHemisphere {
@@ -68,12 +142,32 @@ public:
   static constexpr double TWO_PI = 2.0 * M_PI;
 
   SolidAngle<T> Random() {
+    SolidAngle<T> ret;
     // sample uniformly [0, 2pi), PDF = 1/(2pi)
     T azimuth = TWO_PI * m_u1.Random();
+    ret.cos_azimuth = std::cos(azimuth);
+    ret.sin_azimuth = std::sin(azimuth);
     // sample [0, pi/2), PDF = sin(x), CDF = 1-cos(x), CDF^-1(x) = arccos(1-x)
-    T depression = std::acos(1 - m_u2.Random());
+    // cos = 1-u, sin = sqrt(1-(1-u)^2) = sqrt(u(2-u))
+    T u2 = m_u2.Random();
+    ret.cos_depression = 1 - u2;
+    ret.sin_depression = std::sqrt(u2 * (2 - u2));
     // PDF = 1/(2pi)
-    return {azimuth, depression, 1.0 / TWO_PI};
+    ret.pdf = 1.0 / TWO_PI;
+    return ret;
+  }
+
+  // resize the batch to n samples & fill them
+  void Random(size_t n, SolidAngleBatch<T>& batch) {
+    batch.resize(n);
+    detail::RandomAzimuths(m_u1, n, batch);
+    m_u2.Random(batch.cos_depression.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      T u2 = batch.cos_depression[i];
+      batch.cos_depression[i] = 1 - u2;
+      batch.sin_depression[i] = std::sqrt(u2 * (2 - u2));
+      batch.pdf[i] = 1.0 / TWO_PI;
+    }
   }
 
 private:
@@ -90,16 +184,34 @@ public:
   static constexpr double TWO_PI = 2.0 * M_PI;
 
   SolidAngle<T> Random() {
+    SolidAngle<T> ret;
     // sample uniformly [0, 2pi), PDF=1/(2pi)
     T azimuth = TWO_PI * m_u1.Random();
+    ret.cos_azimuth = std::cos(azimuth);
+    ret.sin_azimuth = std::sin(azimuth);
     // sample [0, pi/2)
     // PDF = 2sin(x)cos(x) = sin(2x)
     // CDF = sin^2(x)
-    // CDF^-1 = arccos(sqrt(u))
-    T depression = std::asin(std::sqrt(m_u2.Random()));
+    // CDF^-1 = arcsin(sqrt(u)), i.e. sin = sqrt(u), cos = sqrt(1-u)
+    T u2 = m_u2.Random();
+    ret.cos_depression = std::sqrt(1 - u2);
+    ret.sin_depression = std::sqrt(u2);
     // PDF = cos(depression)/pi
-    double pdf = std::cos(depression) / M_PI;
-    return {azimuth, depression, pdf};
+    ret.pdf = ret.cos_depression / M_PI;
+    return ret;
+  }
+
+  // resize the batch to n samples & fill them
+  void Random(size_t n, SolidAngleBatch<T>& batch) {
+    batch.resize(n);
+    detail::RandomAzimuths(m_u1, n, batch);
+    m_u2.Random(batch.sin_depression.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      T u2 = batch.sin_depression[i];
+      batch.cos_depression[i] = std::sqrt(1 - u2);
+      batch.sin_depression[i] = std::sqrt(u2);
+      batch.pdf[i] = batch.cos_depression[i] / T(M_PI);
+    }
   }
 
 private:
@@ -116,17 +228,42 @@ public:
   static constexpr double TWO_PI = 2.0 * M_PI;
 
   SolidAngle<T> Random(T alpha) {
+    SolidAngle<T> ret;
     T alpha_1 = alpha + 1.0;
     // sample uniformly [0,2pi), PDF=1/(2pi)
     T azimuth = TWO_PI * m_u1.Random();
+    ret.cos_azimuth = std::cos(azimuth);
+    ret.sin_azimuth = std::sin(azimuth);
     // sample [0, pi/2)
     // PDF = (a+1)cos^a(dpr)sin(dpr)/(2pi)
     // CDF = 1-cos^(a+1)(dpr)
     // CDF^-1 = arccos[(1-u)^(1/(a+1))]
-    T depression = std::acos(std::pow(1.0 - m_u2.Random(), 1.0 / alpha_1));
-    // PDF = (a+1)cos^a(depression)/(2pi)
-    double pdf = alpha_1 * std::pow(std::cos(depression), alpha) / TWO_PI;
-    return {azimuth, depression, pdf};
+    T u2_1 = 1 - m_u2.Random();
+    ret.cos_depression = std::pow(u2_1, T(1.0 / alpha_1));
+    ret.sin_depression = std::sqrt(std::max(T(0), 1 - ret.cos_depression * ret.cos_depression));
+    // PDF = (a+1)cos^a(depression)/(2pi), where cos^a = cos^(a+1)/cos = (1-u)/cos
+    ret.pdf = alpha_1 * u2_1 / (ret.cos_depression * TWO_PI);
+    return ret;
+  }
+
+  // resize the batch to n samples & fill them, sample i with the power alpha[i]
+  void Random(const T alpha[], size_t n, SolidAngleBatch<T>& batch) {
+    batch.resize(n);
+    detail::RandomAzimuths(m_u1, n, batch);
+    // 1-u into the PDFs & the exponents into the sines as the scratches
+    auto& u2_1 = batch.pdf;
+    auto& exponent = batch.sin_depression;
+    m_u2.Random(u2_1.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      u2_1[i] = 1 - u2_1[i];
+      exponent[i] = 1 / (alpha[i] + 1);
+    }
+    math::Pow(u2_1.data(), exponent.data(), batch.cos_depression.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      T cos = batch.cos_depression[i];
+      batch.sin_depression[i] = std::sqrt(std::max(T(0), 1 - cos * cos));
+      batch.pdf[i] = (alpha[i] + 1) * u2_1[i] / (cos * T(TWO_PI));
+    }
   }
 
 private:
@@ -0,0 +1,99 @@
+#include "mcpt/common/random.hpp"
+#include "mcpt/common/random_triangle.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+constexpr size_t NUM_SAMPLES = 100000;
+
+// mean of cos^k(depression) of a batch, & check the samples are unit directions with the PDFs of
+// `pdf(cos_depression)'
+template <typename PDF>
+double CheckBatch(const mcpt::SolidAngleBatch<float>& batch, int k, PDF pdf) {
+  double sum = 0.0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    auto sa = batch[i];
+    REQUIRE(std::abs(sa.cos_azimuth * sa.cos_azimuth + sa.sin_azimuth * sa.sin_azimuth - 1.0F) <
+            1.0e-5F);
+    REQUIRE(std::abs(sa.cos_depression * sa.cos_depression +
+                     sa.sin_depression * sa.sin_depression - 1.0F) < 1.0e-5F);
+    REQUIRE(sa.cos_depression > 0.0F);
+    REQUIRE(sa.pdf == Catch::Approx(pdf(i, sa.cos_depression)).epsilon(1.0e-4));
+    sum += std::pow(sa.cos_depression, k);
+  }
+  return sum / batch.size();
+}
+
+}  // namespace
+
+TEST_CASE("batch samplers on a hemisphere", "[random]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::SolidAngleBatch<float> batch;
+
+// E[cos^k] = (a+1)/(a+k+1) for the PDF (a+1)cos^a/(2pi), a = 0 for the uniform distribution
+SECTION("uniform") {
+  mcpt::UniformHemisphere<float>().Random(NUM_SAMPLES, batch);
+  REQUIRE(batch.size() == NUM_SAMPLES);
+  double mean = CheckBatch(batch, 2, [](size_t, float) { return float(0.5 / M_PI); });
+  CHECK(mean == Catch::Approx(1.0 / 3.0).epsilon(0.01));
+}
+
+SECTION("cosine weighted") {
+  mcpt::CosHemisphere<float>().Random(NUM_SAMPLES, batch);
+  REQUIRE(batch.size() == NUM_SAMPLES);
+  double mean = CheckBatch(batch, 2, [](size_t, float cos) { return float(cos / M_PI); });
+  CHECK(mean == Catch::Approx(2.0 / 4.0).epsilon(0.01));
+}
+
+SECTION("cosine power weighted, with a power per sample") {
+  // interleave the powers to check each sample takes its own
+  std::vector<float> alphas;
+  for (size_t i = 0; i < NUM_SAMPLES; ++i)
+    alphas.push_back(i % 2 ? 1.0F : 20.0F);
+  mcpt::CosPowHemisphere<float>().Random(alphas.data(), alphas.size(), batch);
+  REQUIRE(batch.size() == NUM_SAMPLES);
+  CheckBatch(batch, 1, [&](size_t i, float cos) {
+    return float((alphas[i] + 1.0) * std::pow(cos, alphas[i]) / (2.0 * M_PI));
+  });
+
+  double sums[2] = {};
+  for (size_t i = 0; i < batch.size(); ++i)
+    sums[i % 2] += batch[i].cos_depression;
+  CHECK(sums[0] / (NUM_SAMPLES / 2) == Catch::Approx(21.0 / 22.0).epsilon(0.01));
+  CHECK(sums[1] / (NUM_SAMPLES / 2) == Catch::Approx(2.0 / 3.0).epsilon(0.01));
+}
+
+}
+
+TEST_CASE("batch sampler on a triangle", "[random]") {
+
+mcpt::Uniform<float>::Seed(42);
+Eigen::Vector3f a(1.0F, 0.0F, 0.0F);
+Eigen::Vector3f b(0.0F, 2.0F, 0.0F);
+Eigen::Vector3f c(0.0F, 0.0F, 3.0F);
+
+mcpt::PointBatch<float> batch;
+mcpt::UniformTriangle<float>().Random(a, b, c, NUM_SAMPLES, batch);
+REQUIRE(batch.size() == NUM_SAMPLES);
+
+// on the plane x + y/2 + z/3 = 1 & inside the triangle, with the mean at the centroid
+Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+for (size_t i = 0; i < batch.size(); ++i) {
+  Eigen::Vector3f p = batch[i];
+  REQUIRE(p.minCoeff() >= 0.0F);
+  REQUIRE(p.x() + p.y() / 2.0F + p.z() / 3.0F == Catch::Approx(1.0F).epsilon(1.0e-5));
+  sum += p.cast<double>();
+}
+Eigen::Vector3d mean = sum / NUM_SAMPLES;
+CHECK(mean.x() == Catch::Approx(1.0 / 3.0).epsilon(0.01));
+CHECK(mean.y() == Catch::Approx(2.0 / 3.0).epsilon(0.01));
+CHECK(mean.z() == Catch::Approx(3.0 / 3.0).epsilon(0.01));
+
+}
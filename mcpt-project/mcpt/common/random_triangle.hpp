@@ -1,14 +1,33 @@
 #pragma once
 
 #include <cmath>
+#include <algorithm>
+#include <vector>
 
 #include <Eigen/Eigen>
 
-#include "mcpt/common/assert.hpp"
 #include "mcpt/common/random.hpp"
 
 namespace mcpt {
 
+// a batch of points in SoA, filled by the batch samplers below, whose loops are vectorized
+template <typename T>
+struct PointBatch {
+  std::vector<T> x;
+  std::vector<T> y;
+  std::vector<T> z;
+
+  size_t size() const noexcept { return x.size(); }
+
+  void resize(size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+  }
+
+  Eigen::Matrix<T, 3, 1> operator[](size_t i) const { return {x[i], y[i], z[i]}; }
+};
+
 template <typename T>
 class UniformTriangle {
 public:
@@ -21,44 +40,90 @@ public:
     return (1.0 - sqrt_u1) * a + (sqrt_u1 * (1.0 - u2)) * b + (sqrt_u1 * u2) * c;
   }
 
+  // resize the batch to n samples & fill them, PDF = 1/area
+  template <typename U>
+  void Random(const U& a, const U& b, const U& c, size_t n, PointBatch<T>& batch) {
+    batch.resize(n);
+    // u1 & u2 into the y & z coordinates as the scratches
+    T* x = batch.x.data();
+    T* y = batch.y.data();
+    T* z = batch.z.data();
+    m_u1.Random(y, n);
+    m_u2.Random(z, n);
+    Eigen::Matrix<T, 3, 1> v_a = a;
+    Eigen::Matrix<T, 3, 1> v_b = b;
+    Eigen::Matrix<T, 3, 1> v_c = c;
+    for (size_t i = 0; i < n; ++i) {
+      T sqrt_u1 = std::sqrt(y[i]);
+      T u2 = z[i];
+      T w_a = 1 - sqrt_u1;
+      T w_b = sqrt_u1 * (1 - u2);
+      T w_c = sqrt_u1 * u2;
+      x[i] = w_a * v_a.x() + w_b * v_b.x() + w_c * v_c.x();
+      y[i] = w_a * v_a.y() + w_b * v_b.y() + w_c * v_c.y();
+      z[i] = w_a * v_a.z() + w_b * v_b.z() + w_c * v_c.z();
+    }
+  }
+
 private:
   Uniform<T> m_u1;
   Uniform<T> m_u2;
 };
 
 // uniform sampling on unit spherical triangle
+// J. Arvo, "Stratified Sampling of Spherical Triangles", SIGGRAPH 1995
 template <typename T>
 class UniformUnitSphericalTriangle {
 public:
   using Scalar = T;
 
+  // area of the unit spherical triangle, i.e. the solid angle, PDF = 1/area
   template <typename U>
-  Eigen::Matrix<T, 3, 1> Random(const U& a, const U& b, const U& c) {
+  static T Area(const U& a, const U& b, const U& c) {
     // assume inputs are normalized
-    Eigen::Matrix<T, 3, 1> c_hat = slerp(a, c, m_u1.Random());
-    T cos_arc_a_hat = b.dot(c_hat);
-    T arc_a_hat = std::acos(cos_arc_a_hat);
-    T t = std::acos(1.0 - m_u2.Random() * (1.0 - cos_arc_a_hat)) / arc_a_hat;
-    return slerp(b, c_hat, t);
+    // tan(area/2) = |a.(b x c)| / (1 + a.b + b.c + c.a), A. Van Oosterom & J. Strackee, 1983
+    T triple = std::abs(a.dot(b.cross(c)));
+    return 2.0 * std::atan2(triple, 1.0 + a.dot(b) + b.dot(c) + c.dot(a));
   }
 
-private:
   template <typename U>
-  static Eigen::Matrix<T, 3, 1> slerp(const U& from, const U& to, T t) {
+  Eigen::Matrix<T, 3, 1> Random(const U& a, const U& b, const U& c) {
+    return Random(a, b, c, Area(a, b, c));
+  }
+
+  // the area is passed if known, the triangle must not be degenerated
+  template <typename U>
+  Eigen::Matrix<T, 3, 1> Random(const U& a, const U& b, const U& c, T area) {
     // assume inputs are normalized
-    // [0, pi] is returned
-    T cos = from.dot(to);
-    ASSERT(cos >= -1.0 && cos <= 1.0);
-    T theta = std::acos(cos);
+    // internal angle at a between the arcs ab & ac
+    T cos_alpha = a.cross(b).normalized().dot(a.cross(c).normalized());
+    T sin_alpha = std::sqrt(std::max(T(0.0), T(1.0 - cos_alpha * cos_alpha)));
+
+    // select the point c' on the arc ac, so that the sub-triangle abc' has the sampled area
+    // with sin & cos of (area' - alpha) expanded to avoid computing alpha
+    T area_hat = m_u1.Random() * area;
+    T sin_area_hat = std::sin(area_hat);
+    T cos_area_hat = std::cos(area_hat);
+    T s = sin_area_hat * cos_alpha - cos_area_hat * sin_alpha;
+    T t = cos_area_hat * cos_alpha + sin_area_hat * sin_alpha;
+    T u = t - cos_alpha;
+    T v = s + sin_alpha * a.dot(b);
+    T cos_arc_ac_hat = ((v * t - u * s) * cos_alpha - v) / ((v * s + u * t) * sin_alpha);
+    cos_arc_ac_hat = std::clamp(cos_arc_ac_hat, T(-1.0), T(1.0));
+    Eigen::Matrix<T, 3, 1> c_hat = cos_arc_ac_hat * a + sin_from_cos(cos_arc_ac_hat) * ortho(c, a);
 
-    T sin_1_t_theta = std::sin((1.0 - t) * theta);
-    T sin_t_theta = std::sin(t * theta);
-    T sin_theta = std::sin(theta);
+    // select the point on the arc bc', uniform in the area of the sub-triangle
+    T cos_arc = 1.0 - m_u2.Random() * (1.0 - c_hat.dot(b));
+    return (cos_arc * b + sin_from_cos(cos_arc) * ortho(c_hat, b)).normalized();
+  }
 
-    ASSERT(std::isfinite(sin_theta) && sin_theta != 0.0, "t={} theta={}", t, theta);
+private:
+  static T sin_from_cos(T cos) { return std::sqrt(std::max(T(0.0), T(1.0 - cos * cos))); }
 
-    // output is normalized
-    return ((sin_1_t_theta * from + sin_t_theta * to) / sin_theta).normalized();
+  // unit vector of `v' orthogonal to the unit vector `n'
+  template <typename U, typename V>
+  static Eigen::Matrix<T, 3, 1> ortho(const U& v, const V& n) {
+    return (v - v.dot(n) * n).normalized();
   }
 
   Uniform<T> m_u1;
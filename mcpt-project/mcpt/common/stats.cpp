@@ -0,0 +1,109 @@
+#include "mcpt/common/stats.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+
+namespace mcpt::stats {
+
+namespace {
+
+std::mutex g_mutex;
+// counters of the running threads
+std::vector<Counters*> g_live_counters;
+// counters of the exited threads
+Counters g_retired_counters;
+
+// register the thread on creation and retire it on exit
+struct ThreadCounters {
+  Counters counters;
+
+  ThreadCounters() {
+    std::lock_guard lock(g_mutex);
+    g_live_counters.push_back(&counters);
+  }
+
+  ~ThreadCounters() {
+    std::lock_guard lock(g_mutex);
+    g_retired_counters += counters;
+    g_live_counters.erase(std::find(g_live_counters.begin(), g_live_counters.end(), &counters));
+  }
+};
+
+}  // namespace
+
+Counters& Counters::operator+=(const Counters& rhs) noexcept {
+  for (size_t i = 0; i < counters.size(); ++i)
+    counters[i] += rhs.counters[i];
+  for (size_t i = 0; i < path_length.size(); ++i)
+    path_length[i] += rhs.path_length[i];
+  return *this;
+}
+
+const char* Name(Counter counter) {
+  switch (counter) {
+    case CLOSEST_HIT_RAYS: return "closest_hit_rays";
+    case SHADOW_RAYS: return "shadow_rays";
+    case NODE_VISITS: return "node_visits";
+    case LEAF_VISITS: return "leaf_visits";
+    case POLYGON_TESTS: return "polygon_tests";
+    case INSIDE_REJECTIONS: return "inside_rejections";
+    case LIGHT_SAMPLES: return "light_samples";
+    case LIGHT_SAMPLE_REJECTIONS: return "light_sample_rejections";
+    default: return "unknown";
+  }
+}
+
+Counters& Local() {
+  static thread_local ThreadCounters thread_counters;
+  return thread_counters.counters;
+}
+
+Counters Aggregate() {
+  std::lock_guard lock(g_mutex);
+  Counters sum = g_retired_counters;
+  for (const auto* counters : g_live_counters)
+    sum += *counters;
+  return sum;
+}
+
+void Reset() {
+  std::lock_guard lock(g_mutex);
+  g_retired_counters = {};
+  for (auto* counters : g_live_counters)
+    *counters = {};
+}
+
+std::string ToJSON(const Counters& counters) {
+  const auto& c = counters.counters;
+  auto ratio = [](uint64_t n, uint64_t d) { return d ? static_cast<double>(n) / d : 0.0; };
+
+  std::string json = "{\n  \"counters\": {\n";
+  for (unsigned int i = 0; i < NUM_COUNTERS; ++i) {
+    json += fmt::format("    \"{}\": {}{}\n",
+                        Name(static_cast<Counter>(i)),
+                        c[i],
+                        i + 1 < NUM_COUNTERS ? "," : "");
+  }
+  json += "  },\n";
+
+  uint64_t rays = c[CLOSEST_HIT_RAYS] + c[SHADOW_RAYS];
+  json += "  \"per_ray\": {\n";
+  json += fmt::format("    \"node_visits\": {},\n", ratio(c[NODE_VISITS], rays));
+  json += fmt::format("    \"leaf_visits\": {},\n", ratio(c[LEAF_VISITS], rays));
+  json += fmt::format("    \"polygon_tests\": {}\n", ratio(c[POLYGON_TESTS], rays));
+  json += "  },\n";
+
+  json += fmt::format("  \"inside_rejection_rate\": {},\n",
+                      ratio(c[INSIDE_REJECTIONS], c[POLYGON_TESTS]));
+  json += fmt::format("  \"light_sample_rejection_rate\": {},\n",
+                      ratio(c[LIGHT_SAMPLE_REJECTIONS], c[LIGHT_SAMPLES]));
+
+  // the last bin is for the paths no shorter than MAX_PATH_LENGTH
+  json += fmt::format("  \"path_length\": [{}]\n}}", fmt::join(counters.path_length, ", "));
+  return json;
+}
+
+}  // namespace mcpt::stats
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// per-thread statistics counters of the hot paths
+//
+// counters are compiled in only with MCPT_ENABLE_STATS defined, otherwise the STATS_* macros expand
+// to nothing, each thread increments its own counters without synchronization and the counters of
+// all the threads are summed up on demand
+#ifdef MCPT_ENABLE_STATS
+#define STATS_ADD(counter, n) (::mcpt::stats::Local().counters[::mcpt::stats::counter] += (n))
+#define STATS_INC(counter) STATS_ADD(counter, 1)
+#define STATS_PATH_LENGTH(length) ::mcpt::stats::Local().AddPathLength(length)
+#else
+#define STATS_ADD(counter, n) ((void)0)
+#define STATS_INC(counter) ((void)0)
+#define STATS_PATH_LENGTH(length) ((void)0)
+#endif
+
+namespace mcpt::stats {
+
+#ifdef MCPT_ENABLE_STATS
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+enum Counter : unsigned int {
+  CLOSEST_HIT_RAYS,         // rays traced for the closest hit
+  SHADOW_RAYS,              // rays traced for occlusion
+  NODE_VISITS,              // ray-AABB tests against BVH nodes
+  LEAF_VISITS,              // BVH leaves whose AABB is hit
+  POLYGON_TESTS,            // ray-polygon intersection tests
+  INSIDE_REJECTIONS,        // plane hits falling outside the polygon
+  LIGHT_SAMPLES,            // direct lighting samples
+  LIGHT_SAMPLE_REJECTIONS,  // light samples with zero PDF (hit_pdf == 0)
+  NUM_COUNTERS
+};
+
+// paths longer than this are counted in the last bin of the histogram
+constexpr size_t MAX_PATH_LENGTH = 32;
+
+struct Counters {
+  std::array<uint64_t, NUM_COUNTERS> counters{};
+  // number of paths by the number of vertices
+  std::array<uint64_t, MAX_PATH_LENGTH + 1> path_length{};
+
+  void AddPathLength(size_t length) noexcept { ++path_length[std::min(length, MAX_PATH_LENGTH)]; }
+  Counters& operator+=(const Counters& rhs) noexcept;
+};
+
+const char* Name(Counter counter);
+
+// counters of the calling thread
+Counters& Local();
+
+// sum of the counters of all the threads, both running and exited
+// should not be called while other threads are still counting
+Counters Aggregate();
+void Reset();
+
+std::string ToJSON(const Counters& counters);
+
+}  // namespace mcpt::stats
@@ -0,0 +1,91 @@
+#include "mcpt/common/trace.hpp"
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ostr.h>
+
+namespace mcpt::trace {
+
+namespace {
+
+struct Event {
+  const char* name;
+  int64_t begin;
+  int64_t end;
+};
+
+struct ThreadEvents {
+  unsigned int tid;
+  std::string name;
+  std::vector<Event> events;
+};
+
+const auto g_epoch = std::chrono::steady_clock::now();
+
+std::mutex g_mutex;
+// buffers outlive their threads so that zones of the exited threads are kept
+std::list<ThreadEvents> g_thread_events;
+
+ThreadEvents& Local() {
+  static thread_local ThreadEvents* thread_events = [] {
+    std::lock_guard lock(g_mutex);
+    unsigned int tid = g_thread_events.size();
+    return &g_thread_events.emplace_back(ThreadEvents{tid, fmt::format("thread {}", tid), {}});
+  }();
+  return *thread_events;
+}
+
+}  // namespace
+
+void Enable(bool enable) {
+  detail::g_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void SetThreadName(const std::string& name) {
+  Local().name = name;
+}
+
+void WriteChromeTrace(std::ostream& os) {
+  std::lock_guard lock(g_mutex);
+
+  const char* sep = "";
+  fmt::print(os, "{{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (const auto& thread_events : g_thread_events) {
+    fmt::print(os,
+               "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": {}, "
+               "\"args\": {{\"name\": \"{}\"}}}}",
+               sep,
+               thread_events.tid,
+               thread_events.name);
+    sep = ",\n";
+    for (const auto& e : thread_events.events) {
+      fmt::print(os,
+                 ",\n{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 0, \"tid\": {}, \"ts\": {}, "
+                 "\"dur\": {}}}",
+                 e.name,
+                 thread_events.tid,
+                 e.begin,
+                 e.end - e.begin);
+    }
+  }
+  fmt::print(os, "\n]}}\n");
+}
+
+namespace detail {
+
+int64_t Now() {
+  auto elapsed = std::chrono::steady_clock::now() - g_epoch;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void Record(const char* name, int64_t begin, int64_t end) {
+  Local().events.push_back({name, begin, end});
+}
+
+}  // namespace detail
+
+}  // namespace mcpt::trace
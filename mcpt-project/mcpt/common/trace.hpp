@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// record a zone named `name' from here to the end of the enclosing scope
+#define TRACE_ZONE(name) ::mcpt::trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+// lightweight scoped timers exported as Chrome trace events
+//
+// zones are recorded only after `Enable()', each thread appends the finished zones to its own
+// buffer, so that a disabled zone costs an atomic load and an enabled one costs two clock reads
+namespace mcpt::trace {
+
+void Enable(bool enable = true);
+
+// name the calling thread in the timeline
+void SetThreadName(const std::string& name);
+
+// write the zones of all the threads in Chrome trace event format (chrome://tracing, Perfetto)
+// should not be called while other threads are still recording
+void WriteChromeTrace(std::ostream& os);
+
+namespace detail {
+
+inline std::atomic_bool g_enabled = false;
+
+// microseconds since the trace epoch
+int64_t Now();
+void Record(const char* name, int64_t begin, int64_t end);
+
+}  // namespace detail
+
+class Zone {
+public:
+  explicit Zone(const char* name) : m_name(name), m_begin(-1) {
+    if (detail::g_enabled.load(std::memory_order_relaxed))
+      m_begin = detail::Now();
+  }
+  ~Zone() {
+    if (m_begin >= 0)
+      detail::Record(m_name, m_begin, detail::Now());
+  }
+
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+
+private:
+  const char* m_name;
+  int64_t m_begin;
+};
+
+}  // namespace mcpt::trace
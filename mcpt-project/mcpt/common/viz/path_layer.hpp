@@ -32,7 +32,9 @@ public:
     auto& lpath_data = m_render_data.lpath_data.emplace_back();
 
     Eigen::Vector3f last_point = start;
-    for (const auto& [rpath, lpath] : rpaths) {
+    for (const auto& vertex : rpaths) {
+      const auto& rpath = vertex.rpath;
+      const auto& lpath = vertex.lpath;
       normal_data.insert(normal_data.end(), rpath.point.begin(), rpath.point.end());
       normal_data.push_back(rpath.point.x() + rpath.normal.x() * NORMAL_LENGTH);
       normal_data.push_back(rpath.point.y() + rpath.normal.y() * NORMAL_LENGTH);
@@ -0,0 +1,307 @@
+#include <sys/resource.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ostr.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/stopwatch.h>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/fileserver/fileserver.hpp"
+#include "mcpt/common/misc.hpp"
+#include "mcpt/common/random.hpp"
+#include "mcpt/common/stats.hpp"
+#include "mcpt/misc/argparsing.hpp"
+#include "mcpt/misc/camera.hpp"
+#include "mcpt/misc/logging.hpp"
+#include "mcpt/parser/obj_parser/parser.hpp"
+#include "mcpt/renderer/bxdf.hpp"
+#include "mcpt/renderer/monte_carlo.hpp"
+#include "mcpt/renderer/wavefront.hpp"
+
+using namespace mcpt;
+
+namespace {
+
+struct ConvergencePoint {
+  size_t spp;
+  double seconds;
+  double rmse;
+};
+
+struct SceneReport {
+  std::string name;
+  double parse_seconds = 0.0;
+  double bvh_seconds = 0.0;
+  float bvh_sah_cost = 0.0F;
+  double render_seconds = 0.0;
+  long peak_rss_kb = 0;
+  MonteCarlo::RayCount rays;
+  std::vector<ConvergencePoint> convergence;
+  stats::Counters stats;
+};
+
+// render one spp of the whole image into `radiance'
+using RenderFunc =
+    std::function<MonteCarlo::RayCount(std::vector<Eigen::Vector3f>& radiance)>;
+
+long PeakRSS() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  // in kilobytes on Linux
+  return usage.ru_maxrss;
+}
+
+double RMSE(const std::vector<float>& integral, size_t spp, const std::vector<float>& reference) {
+  DASSERT(integral.size() == reference.size());
+  double sse = 0.0;
+  for (size_t i = 0; i < integral.size(); ++i) {
+    double diff = integral[i] / spp - reference[i];
+    sse += diff * diff;
+  }
+  return std::sqrt(sse / integral.size());
+}
+
+// render `spp' samples per pixel with multiple threads, spp i is always rendered with the same
+// seed no matter which thread picks it up
+std::vector<float> Render(const misc::BenchArgs& args,
+                          const RenderFunc& render,
+                          const std::vector<float>& reference,
+                          SceneReport& report) {
+  std::mutex mutex;
+  size_t next_spp_idx = 0;
+  size_t spp_completed = 0;
+  std::vector<float> integral(size_t(args.width) * args.height * 3, 0.0F);
+  spdlog::stopwatch sw;
+
+  auto worker = [&]() {
+    std::vector<Eigen::Vector3f> radiance(size_t(args.width) * args.height);
+    while (true) {
+      size_t spp_idx;
+      {
+        std::lock_guard lock(mutex);
+        if (next_spp_idx == args.spp)
+          return;
+        spp_idx = next_spp_idx++;
+      }
+
+      Uniform<float>::Seed(args.seed + spp_idx);
+      Uniform<double>::Seed(args.seed + spp_idx);
+      Uniform<size_t>::Seed(args.seed + spp_idx);
+      auto rays = render(radiance);
+
+      std::lock_guard lock(mutex);
+      for (size_t i = 0; i < radiance.size(); ++i) {
+        integral[i * 3 + 0] += radiance[i].x();
+        integral[i * 3 + 1] += radiance[i].y();
+        integral[i * 3 + 2] += radiance[i].z();
+      }
+      report.rays += rays;
+      ++spp_completed;
+
+      double seconds = sw.elapsed().count();
+      double rmse = reference.empty() ? NAN : RMSE(integral, spp_completed, reference);
+      report.convergence.push_back({spp_completed, seconds, rmse});
+      spdlog::info("spp: {}/{}, {:.3f}s, rmse: {:.6f}", spp_completed, args.spp, seconds, rmse);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < args.num_threads && i < args.spp; ++i)
+    threads.emplace_back(worker);
+  for (auto& t : threads)
+    t.join();
+  report.render_seconds = sw.elapsed().count();
+
+  for (auto& c : integral)
+    c /= args.spp;
+  return integral;
+}
+
+std::vector<float> LoadReference(const misc::BenchArgs& args, const std::string& name) {
+  SandboxFileserver fs_ref(args.reference_path);
+  auto ref_name = fmt::format("{}_{}x{}.pfm", name, args.width, args.height);
+
+  std::vector<float> reference;
+  if (!std::filesystem::is_regular_file(fs_ref.GetAbsolutePath(ref_name))) {
+    spdlog::warn("no reference image {}, RMSE will not be reported", ref_name);
+    return reference;
+  }
+
+  std::ifstream ifs;
+  unsigned int w = 0;
+  unsigned int h = 0;
+  if (!fs_ref.OpenTextForRead(ref_name, ifs) || !PFMToRaw(ifs, w, h, reference))
+    reference.clear();
+  ASSERT(reference.empty() || (w == args.width && h == args.height),
+         "reference image size mismatch: {}x{}",
+         w,
+         h);
+  return reference;
+}
+
+void SaveReference(const misc::BenchArgs& args,
+                   const std::string& name,
+                   const std::vector<float>& im) {
+  SandboxFileserver fs_ref(args.reference_path);
+  auto ref_name = fmt::format("{}_{}x{}.pfm", name, args.width, args.height);
+  spdlog::info("saving reference image {}", fs_ref.GetAbsolutePath(ref_name));
+
+  std::ofstream ofs;
+  ASSERT(fs_ref.OpenTextWrite(ref_name, ofs));
+  RawToPFM(args.width, args.height, im.data(), ofs);
+}
+
+SceneReport RunScene(const misc::BenchArgs& args, const std::filesystem::path& scene_path) {
+  SceneReport report;
+  report.name = scene_path.stem().string();
+
+  spdlog::info("loading object from {}", scene_path);
+  spdlog::stopwatch sw;
+  auto obj = obj_parser::Parser(std::filesystem::absolute(scene_path)).object();
+  report.parse_seconds = sw.elapsed().count();
+
+  sw.reset();
+  auto bvh = obj.CreateBVHTree(args.enable_sbvh);
+  report.bvh_seconds = sw.elapsed().count();
+  report.bvh_sah_cost = bvh.root->sah_cost;
+
+  auto mc_opts = misc::MakeSceneOptions(report.name, args.width, args.height);
+  std::vector<float> reference;
+  if (!args.make_reference)
+    reference = LoadReference(args, report.name);
+
+  RenderFunc render;
+  std::shared_ptr<MonteCarlo> mcpt_runner;
+  std::shared_ptr<Wavefront> wavefront_runner;
+  if (args.enable_wavefront) {
+    wavefront_runner = std::make_shared<Wavefront>(mc_opts, obj, bvh);
+    wavefront_runner->SetBxDF(BlinnPhongBxDF());
+    render = [&](std::vector<Eigen::Vector3f>& radiance) {
+      return wavefront_runner->Run(args.width, 0, radiance.size(), radiance.data());
+    };
+  } else {
+    mcpt_runner = std::make_shared<MonteCarlo>(mc_opts, obj, bvh);
+    mcpt_runner->SetBxDF(BlinnPhongBxDF());
+    render = [&](std::vector<Eigen::Vector3f>& radiance) {
+      MonteCarlo::RayCount rays;
+      for (size_t i = 0; i < radiance.size(); ++i) {
+        auto result = mcpt_runner->Run(i % args.width, i / args.width);
+        radiance[i].noalias() = result.radiance;
+        rays += result.rays;
+      }
+      return rays;
+    };
+  }
+
+  spdlog::info("rendering {} at {}x{} for spp: {}", report.name, args.width, args.height, args.spp);
+  stats::Reset();
+  auto im = Render(args, render, reference, report);
+  report.stats = stats::Aggregate();
+  if (args.make_reference)
+    SaveReference(args, report.name, im);
+
+  report.peak_rss_kb = PeakRSS();
+  return report;
+}
+
+void WriteReport(const misc::BenchArgs& args, const std::vector<SceneReport>& reports) {
+  auto rate = [](double n, double seconds) { return seconds > 0.0 ? n / seconds : 0.0; };
+  // JSON has no NaN
+  auto number = [](double v) {
+    return std::isfinite(v) ? fmt::format("{}", v) : std::string("null");
+  };
+
+  std::ofstream ofs(args.output_path);
+  ASSERT(ofs.is_open(), "failed to open {}", args.output_path);
+
+  fmt::print(ofs, "{{\n");
+  fmt::print(ofs, "  \"engine\": \"{}\",\n", args.enable_wavefront ? "wavefront" : "monte_carlo");
+  fmt::print(ofs, "  \"width\": {},\n  \"height\": {},\n", args.width, args.height);
+  fmt::print(ofs, "  \"spp\": {},\n  \"seed\": {},\n", args.spp, args.seed);
+  fmt::print(ofs, "  \"threads\": {},\n", args.num_threads);
+  fmt::print(ofs, "  \"bvh\": \"{}\",\n", args.enable_sbvh ? "sbvh" : "median");
+  fmt::print(ofs, "  \"scenes\": [\n");
+  for (size_t i = 0; i < reports.size(); ++i) {
+    const auto& r = reports[i];
+    double samples = double(args.width) * args.height * args.spp;
+    fmt::print(ofs, "    {{\n");
+    fmt::print(ofs, "      \"name\": \"{}\",\n", r.name);
+    fmt::print(ofs, "      \"parse_seconds\": {},\n", r.parse_seconds);
+    fmt::print(ofs, "      \"bvh_seconds\": {},\n", r.bvh_seconds);
+    fmt::print(ofs, "      \"bvh_sah_cost\": {},\n", r.bvh_sah_cost);
+    fmt::print(ofs, "      \"render_seconds\": {},\n", r.render_seconds);
+    fmt::print(ofs, "      \"peak_rss_kb\": {},\n", r.peak_rss_kb);
+    fmt::print(ofs,
+               "      \"rays\": {{\"primary\": {}, \"extension\": {}, \"shadow\": {}, "
+               "\"total\": {}}},\n",
+               r.rays.primary,
+               r.rays.extension,
+               r.rays.shadow,
+               r.rays.total());
+    fmt::print(ofs,
+               "      \"rays_per_second\": {{\"primary\": {}, \"shadow\": {}, \"total\": {}}},\n",
+               rate(r.rays.primary, r.render_seconds),
+               rate(r.rays.shadow, r.render_seconds),
+               rate(r.rays.total(), r.render_seconds));
+    fmt::print(ofs, "      \"samples_per_second\": {},\n", rate(samples, r.render_seconds));
+    fmt::print(ofs, "      \"spp_per_second\": {},\n", rate(args.spp, r.render_seconds));
+    if (stats::ENABLED)
+      fmt::print(ofs, "      \"stats\": {},\n", stats::ToJSON(r.stats));
+    fmt::print(ofs, "      \"convergence\": [\n");
+    for (size_t k = 0; k < r.convergence.size(); ++k) {
+      const auto& c = r.convergence[k];
+      fmt::print(ofs,
+                 "        {{\"spp\": {}, \"seconds\": {}, \"rmse\": {}}}{}\n",
+                 c.spp,
+                 c.seconds,
+                 number(c.rmse),
+                 k + 1 < r.convergence.size() ? "," : "");
+    }
+    fmt::print(ofs, "      ]\n");
+    fmt::print(ofs, "    }}{}\n", i + 1 < reports.size() ? "," : "");
+  }
+  fmt::print(ofs, "  ]\n}}\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto args = misc::InitBenchArgParser("mcpt_bench", argc, argv);
+  misc::InitLogger("mcpt_bench", ".", args.enable_verbose);
+
+  std::vector<SceneReport> reports;
+  for (const auto& scene_path : args.scene_paths) {
+    auto report = RunScene(args, scene_path);
+    double seconds = report.render_seconds;
+    spdlog::info("{}: parse {:.3f}s, BVH {:.3f}s (SAH cost {:.2f}), render {:.3f}s, "
+                 "peak RSS {} KB",
+                 report.name,
+                 report.parse_seconds,
+                 report.bvh_seconds,
+                 report.bvh_sah_cost,
+                 seconds,
+                 report.peak_rss_kb);
+    spdlog::info("{}: {:.3f} Mrays/s (primary {:.3f}, shadow {:.3f}), {:.3f} spp/s, rmse: {:.6f}",
+                 report.name,
+                 report.rays.total() / seconds * 1e-6,
+                 report.rays.primary / seconds * 1e-6,
+                 report.rays.shadow / seconds * 1e-6,
+                 args.spp / seconds,
+                 report.convergence.back().rmse);
+    reports.push_back(std::move(report));
+  }
+
+  WriteReport(args, reports);
+  spdlog::info("saved report in {}", std::filesystem::absolute(args.output_path));
+  return 0;
+}
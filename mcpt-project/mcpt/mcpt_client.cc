@@ -0,0 +1,60 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "mcpt/misc/argparsing.hpp"
+#include "mcpt/misc/unix_socket.hpp"
+
+using namespace mcpt;
+
+int main(int argc, char* argv[]) {
+  auto args = misc::InitClientArgParser("mcpt_client", argc, argv);
+  if (args.request.empty()) {
+    std::cerr << "no request given" << std::endl;
+    return 1;
+  }
+
+  auto socket = misc::UnixSocket::Connect(args.socket_path);
+  if (!socket.valid())
+    return 1;
+
+  auto request = fmt::format("{}\n", fmt::join(args.request, " "));
+  const auto& command = args.request.front();
+  // keep reading the progress until the job is done
+  bool watching = command == "watch" || (command == "submit" && !args.detach);
+  if (!socket.Write(request))
+    return 1;
+
+  std::string line;
+  while (socket.ReadLine(line)) {
+    std::istringstream iss(line);
+    std::string reply;
+    iss >> reply;
+
+    if (reply == "image") {
+      size_t id;
+      size_t spp;
+      size_t size;
+      iss >> id >> spp >> size;
+      std::string image;
+      if (!socket.Read(size, image))
+        break;
+      std::filesystem::create_directories(args.output_path);
+      auto path = args.output_path / fmt::format("job_{}_spp_{}.ppm", id, spp);
+      std::ofstream(path, std::ios::binary) << image;
+      std::cout << "image " << id << " " << spp << " saved to " << path.string() << std::endl;
+      continue;
+    }
+
+    std::cout << line << std::endl;
+    if (reply == "error")
+      return 1;
+    if (reply == "done" || (reply == "ok" && !watching))
+      return 0;
+  }
+  return 1;
+}
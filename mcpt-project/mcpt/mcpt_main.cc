@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <ctime>
 #include <filesystem>
+#include <fstream>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <Eigen/Eigen>
 #include <spdlog/fmt/fmt.h>
@@ -11,13 +15,20 @@
 
 #include "mcpt/common/assert.hpp"
 #include "mcpt/common/fileserver/fileserver.hpp"
+#include "mcpt/common/stats.hpp"
+#include "mcpt/common/trace.hpp"
 #include "mcpt/misc/argparsing.hpp"
+#include "mcpt/misc/camera.hpp"
 #include "mcpt/misc/dispatcher.hpp"
 #include "mcpt/misc/logging.hpp"
 #include "mcpt/misc/visualizing.hpp"
+#include "mcpt/parser/cam_parser/parser.hpp"
 #include "mcpt/parser/obj_parser/parser.hpp"
 #include "mcpt/renderer/bxdf.hpp"
 #include "mcpt/renderer/monte_carlo.hpp"
+#include "mcpt/renderer/radiance_cache.hpp"
+#include "mcpt/renderer/sd_tree.hpp"
+#include "mcpt/renderer/wavefront.hpp"
 
 using namespace mcpt;
 
@@ -29,29 +40,44 @@ Object LoadObject(std::filesystem::path obj_path) {
   return obj_parser::Parser(obj_path).object();
 }
 
-/**
- * Y(m) |\
- *      | \
- *      |  \
- *      |   \
- *      |    \       /| y(mm): vertical CMOS half size
- *      |     \     / |
- *      |      \   /  |
- *      |       \ /   |
- *    --+--------X----+--
- *         d(m)    f(mm)
- *
- * Y/d = y/f = fy
- *
- * h/2 = fy * Y/d
- *  fy = h/2 * d/Y
- *     = h/2 * f/y
- */
-Eigen::Vector4f MakeCamera(unsigned int w, unsigned int h, float focal_length, float cmos_horizon) {
-  float cmos_vertical = cmos_horizon * h / w;
-  float fx = w * focal_length / cmos_horizon;
-  float fy = h * focal_length / cmos_vertical;
-  return Eigen::Vector4f(fx, fy, w / 2.0F, h / 2.0F);
+// load the cameras & apply the render settings over the command line, or use the scene preset if
+// no camera file is given
+std::vector<cam_parser::Camera> LoadCameras(misc::RuntimeArgs& args,
+                                            const std::string& scene_name) {
+  std::vector<cam_parser::Camera> cameras;
+  if (args.cameras_path.empty()) {
+    cameras.push_back(misc::MakeSceneCamera(scene_name));
+  } else {
+    cam_parser::Parser parser(args.cameras_path);
+    const auto& settings = parser.settings();
+    args.spp = settings.spp.value_or(args.spp);
+    args.save_every_n = settings.save_every_n.value_or(args.save_every_n);
+    args.max_depth = settings.max_depth.value_or(args.max_depth);
+    args.rr_min_depth = settings.rr_min_depth.value_or(args.rr_min_depth);
+    args.rr_cont_prob = settings.rr_cont_prob.value_or(args.rr_cont_prob);
+    args.output_path = settings.output_path.value_or(args.output_path);
+    cameras = parser.cameras();
+    ASSERT(!cameras.empty(), "no camera in {}", args.cameras_path);
+  }
+
+  for (auto& camera : cameras) {
+    if (!camera.width || !camera.height) {
+      camera.width = args.width;
+      camera.height = args.height;
+    }
+  }
+  return cameras;
+}
+
+MonteCarlo::Options MakeOptions(const cam_parser::Camera& camera, const misc::RuntimeArgs& args) {
+  spdlog::info(
+      "making MCPT options for camera `{}': {}x{}", camera.name, camera.width, camera.height);
+  auto mc_opts = misc::MakeOptions(camera, camera.width, camera.height);
+  mc_opts.max_depth = args.max_depth;
+  mc_opts.rr_min_depth = args.rr_min_depth;
+  mc_opts.rr_cont_prob = args.rr_cont_prob;
+  spdlog::info("camera intrinsics: {}", mc_opts.intrin.format(FMT));
+  return mc_opts;
 }
 
 int main(int argc, char* argv[]) {
@@ -59,6 +85,7 @@ int main(int argc, char* argv[]) {
 
   auto launch_time = fmt::localtime(std::time(nullptr));
   auto scene_name = args.scene_path.stem().string();
+  auto cameras = LoadCameras(args, scene_name);
   auto export_root =
       args.output_path /
       fmt::format("{:%Y%m%d_%H%M%S}_{}_{}x{}", launch_time, scene_name, args.width, args.height);
@@ -66,45 +93,122 @@ int main(int argc, char* argv[]) {
   SandboxFileserver fs_out(export_root);
   misc::InitLogger("mcpt_main", export_root, args.enable_verbose);
   spdlog::info("results will be saved in {}", fs_out.GetAbsolutePath());
+  if (args.enable_trace) {
+    trace::Enable();
+    trace::SetThreadName("main");
+  }
 
   spdlog::info("loading object from {}", args.scene_path);
   SandboxFileserver fserver(args.scene_path.parent_path());
   auto obj = LoadObject(fserver.GetAbsolutePath(args.scene_path));
-  auto bvh = obj.CreateBVHTree();
-
-  spdlog::info("making MCPT options");
-  MonteCarlo::Options mc_opts;
-  mc_opts.intrin = MakeCamera(args.width, args.height, 28.0F, 36.0F);
-  mc_opts.R.col(0) = Eigen::Vector3f::UnitX();
-  mc_opts.R.col(1) = -Eigen::Vector3f::UnitY();
-  mc_opts.R.col(2) = -Eigen::Vector3f::UnitZ();
-  // for scene01
-  mc_opts.t << 0.0F, 5.0F, 15.0F;
-  // for scene02
-  // mc_opts.R = Eigen::AngleAxisf(-25.0F / 180.0F * M_PI, Eigen::Vector3f::UnitX()) * mc_opts.R;
-  // mc_opts.t << 2.0F, 9.0F, 16.0F;
-  spdlog::info("camera intrinsics: {}", mc_opts.intrin.format(FMT));
-
-  auto viz = misc::InitVisualizer(args.enable_gui, args.width);
-  viz.object_layer->UpdateObject(obj, mc_opts.R, mc_opts.t);
-
-  spdlog::info("making MCPT renderer");
-  auto mcpt_runner = std::make_shared<MonteCarlo>(mc_opts, obj, bvh);
-  mcpt_runner->SetBxDF(std::make_unique<BlinnPhongBxDF>());
+  auto bvh = obj.CreateBVHTree(args.enable_sbvh);
+  BxDF bxdf = args.enable_ggx ? BxDF(GGXBxDF()) : BxDF(BlinnPhongBxDF());
+
+  // the irradiance is view independent, so all the cameras share the cache of the scene
+  std::shared_ptr<RadianceCache> radiance_cache;
+  if (args.cache_cell_size > 0.0F) {
+    if (args.enable_wavefront) {
+      spdlog::warn("the wavefront engine renders without the radiance cache");
+    } else {
+      RadianceCache::Options cache_opts;
+      cache_opts.cell_size = args.cache_cell_size;
+      cache_opts.min_samples = args.cache_min_samples;
+      cache_opts.max_samples = std::max(cache_opts.max_samples, cache_opts.min_samples);
+      radiance_cache = std::make_shared<RadianceCache>(cache_opts);
+    }
+  }
+
+  // so is the incident radiance learned for guiding
+  std::shared_ptr<SDTree> path_guide;
+  if (args.enable_guiding) {
+    if (args.enable_wavefront)
+      spdlog::warn("the wavefront engine renders without path guiding");
+    else
+      path_guide = std::make_shared<SDTree>(SDTree::Options(), bvh.root->aabb);
+  }
 
 #ifndef NDEBUG
-  Dispatcher dispatcher(fs_out, 1, args.spp, args.save_every_n);
+  unsigned int num_threads = 1;
 #else
   unsigned int num_threads = std::thread::hardware_concurrency();
-  Dispatcher dispatcher(fs_out, num_threads, args.spp, args.save_every_n);
 #endif
 
-  spdlog::info("running MCPT for spp: {}", args.spp);
-  dispatcher.Dispatch(mcpt_runner, viz.path_layer, args.width, args.height);
-
-  viz.Run(mc_opts.t.x() * 2.0F, mc_opts.t.y() * 2.0F, mc_opts.t.z() * 2.0F);
-
-  dispatcher.JoinAll();
+  // keep the results of the preset camera in the export root
+  auto export_camera = [&](const cam_parser::Camera& camera) {
+    return args.cameras_path.empty() ? export_root : export_root / camera.name;
+  };
+
+  if (args.enable_batch) {
+    // all the cameras share the object & BVH tree and the worker pool
+    std::vector<SandboxFileserver> fs_cameras;
+    fs_cameras.reserve(cameras.size());
+    BatchDispatcher dispatcher(num_threads, args.spp, args.save_every_n, args.save_cost);
+    for (const auto& camera : cameras) {
+      auto mc_opts = MakeOptions(camera, args);
+      auto& fs_camera = fs_cameras.emplace_back(export_camera(camera));
+      if (args.enable_wavefront) {
+        auto wavefront_runner = std::make_shared<Wavefront>(mc_opts, obj, bvh);
+        wavefront_runner->SetBxDF(bxdf);
+        dispatcher.AddFrame(camera.name, fs_camera, wavefront_runner, camera.width, camera.height);
+      } else {
+        auto mcpt_runner = std::make_shared<MonteCarlo>(mc_opts, obj, bvh);
+        mcpt_runner->SetBxDF(bxdf);
+        mcpt_runner->SetRadianceCache(radiance_cache);
+        mcpt_runner->SetPathGuide(path_guide);
+        dispatcher.AddFrame(camera.name, fs_camera, mcpt_runner, camera.width, camera.height);
+      }
+    }
+
+    spdlog::info("running MCPT in batch for {} frames, spp: {}", cameras.size(), args.spp);
+    dispatcher.Run();
+  } else {
+    // all the cameras share the object & BVH tree, only the first one is visualized
+    auto viz = misc::InitVisualizer(args.enable_gui, cameras.front().width);
+    for (size_t i = 0; i < cameras.size(); ++i) {
+      const auto& camera = cameras[i];
+      auto mc_opts = MakeOptions(camera, args);
+
+      SandboxFileserver fs_camera(export_camera(camera));
+      Dispatcher dispatcher(fs_camera, num_threads, args.spp, args.save_every_n, args.save_cost);
+      auto path_layer = i == 0 ? viz.path_layer : nullptr;
+      if (i == 0)
+        viz.object_layer->UpdateObject(obj, mc_opts.R, mc_opts.t);
+
+      if (args.enable_wavefront) {
+        spdlog::info("making wavefront MCPT renderer");
+        auto wavefront_runner = std::make_shared<Wavefront>(mc_opts, obj, bvh);
+        wavefront_runner->SetBxDF(bxdf);
+
+        spdlog::info("running wavefront MCPT for spp: {}", args.spp);
+        dispatcher.Dispatch(wavefront_runner, camera.width, camera.height);
+      } else {
+        spdlog::info("making MCPT renderer");
+        auto mcpt_runner = std::make_shared<MonteCarlo>(mc_opts, obj, bvh);
+        mcpt_runner->SetBxDF(bxdf);
+        mcpt_runner->SetRadianceCache(radiance_cache);
+        mcpt_runner->SetPathGuide(path_guide);
+
+        spdlog::info("running MCPT for spp: {}", args.spp);
+        dispatcher.Dispatch(mcpt_runner, path_layer, camera.width, camera.height);
+      }
+
+      if (i == 0)
+        viz.Run(mc_opts.t.x() * 2.0F, mc_opts.t.y() * 2.0F, mc_opts.t.z() * 2.0F);
+
+      dispatcher.JoinAll();
+    }
+  }
+
+  if (stats::ENABLED) {
+    std::ofstream ofs;
+    ASSERT(fs_out.OpenTextWrite("stats.json", ofs));
+    ofs << stats::ToJSON(stats::Aggregate()) << std::endl;
+  }
+  if (args.enable_trace) {
+    std::ofstream ofs;
+    ASSERT(fs_out.OpenTextWrite("trace.json", ofs));
+    trace::WriteChromeTrace(ofs);
+  }
   spdlog::info("saved results in {}", fs_out.GetAbsolutePath());
   return 0;
 }
@@ -0,0 +1,16 @@
+#include <spdlog/spdlog.h>
+
+#include "mcpt/misc/argparsing.hpp"
+#include "mcpt/misc/logging.hpp"
+#include "mcpt/misc/render_server.hpp"
+
+using namespace mcpt;
+
+int main(int argc, char* argv[]) {
+  auto args = misc::InitServerArgParser("mcpt_server", argc, argv);
+  misc::InitLogger("mcpt_server", args.log_path, args.enable_verbose);
+
+  misc::RenderServer server(args.socket_path, args.num_threads);
+  server.Run();
+  return 0;
+}
@@ -3,6 +3,8 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <thread>
+#include <utility>
 
 namespace mcpt::misc {
 
@@ -49,7 +51,37 @@ RuntimeArgs InitArgParser(const std::string& name, int argc, char* argv[]) {
       .metavar("N")
       .default_value(0U)
       .scan<'u', unsigned int>();
+  parser.add_argument("-d", "--max-depth")
+      .help("maximum number of path vertices (zero means unlimited)")
+      .metavar("DEPTH")
+      .default_value(0U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("--rr")
+      .help("max continuation probability of Russian roulette, which follows the path throughput")
+      .metavar("PROB")
+      .default_value(0.95)
+      .scan<'g', double>();
+  parser.add_argument("--rr-depth")
+      .help("number of path vertices before Russian roulette starts")
+      .metavar("DEPTH")
+      .default_value(3U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("--cache")
+      .help("cache the indirect irradiance of the Lambertian surfaces in cells of SIZE (zero means "
+            "no cache), not supported by the wavefront engine")
+      .metavar("SIZE")
+      .default_value(0.0F)
+      .scan<'g', float>();
+  parser.add_argument("--cache-samples")
+      .help("number of samples for a cache cell to be used, the more the less biased")
+      .metavar("N")
+      .default_value(32U)
+      .scan<'u', unsigned int>();
 
+  parser.add_argument("-C", "--cameras")
+      .help("cameras & render settings (.cam) overriding the command line, one render per camera")
+      .metavar("CAMERAS")
+      .default_value(""s);
   parser.add_argument("-o", "--output")
       .help("output root directory")
       .metavar("OUTPUT")
@@ -62,6 +94,35 @@ RuntimeArgs InitArgParser(const std::string& name, int argc, char* argv[]) {
       .help("enable GUI visualization")
       .default_value(false)
       .implicit_value(true);
+  parser.add_argument("-w", "--wavefront")
+      .help("use the wavefront (stream) path tracing engine")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("-b", "--batch")
+      .help("render all the cameras through one worker pool, interleaving their tiles")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("--sbvh")
+      .help("build the BVH tree with spatial splits, duplicating the references of large polygons")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("--ggx")
+      .help("shade with the GGX microfacet BRDF instead of Blinn-Phong")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("--guide")
+      .help("guide the diffusive paths by the incident radiance learned in an SD-tree, not "
+            "supported by the wavefront engine")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("-t", "--trace")
+      .help("record the pipeline phases as a Chrome trace (trace.json)")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("-c", "--cost")
+      .help("save the per-pixel BVH traversal cost heatmap with the images (.pfm)")
+      .default_value(false)
+      .implicit_value(true);
 
   parser.add_description("Monte Carlo path tracing renderer.");
 
@@ -83,10 +144,198 @@ RuntimeArgs InitArgParser(const std::string& name, int argc, char* argv[]) {
   args.spp = Get<unsigned int>(parser, "-s", [](auto v) { return v > 0; });
   args.save_every_n =
       Get<unsigned int>(parser, "-n", [spp = args.spp](auto v) { return v <= spp; });
+  args.max_depth = Get<unsigned int>(parser, "-d");
+  args.rr_min_depth = Get<unsigned int>(parser, "--rr-depth");
+  args.rr_cont_prob = Get<double>(parser, "--rr", [](auto v) { return v > 0.0 && v <= 1.0; });
+  args.cache_cell_size = Get<float>(parser, "--cache", [](auto v) { return v >= 0.0F; });
+  args.cache_min_samples =
+      Get<unsigned int>(parser, "--cache-samples", [](auto v) { return v > 0; });
 
+  args.cameras_path = Get<std::string>(parser, "-C");
   args.output_path = Get<std::string>(parser, "-o");
   args.enable_gui = Get<bool>(parser, "-g");
   args.enable_verbose = Get<bool>(parser, "-v");
+  args.enable_wavefront = Get<bool>(parser, "-w");
+  args.enable_batch = Get<bool>(parser, "-b");
+  args.enable_sbvh = Get<bool>(parser, "--sbvh");
+  args.enable_ggx = Get<bool>(parser, "--ggx");
+  args.enable_guiding = Get<bool>(parser, "--guide");
+  args.enable_trace = Get<bool>(parser, "-t");
+  args.save_cost = Get<bool>(parser, "-c");
+
+  return args;
+}
+
+BenchArgs InitBenchArgParser(const std::string& name, int argc, char* argv[]) {
+  using namespace std::string_literals;
+
+  argparse::ArgumentParser parser(name, "1.0", argparse::default_arguments::help);
+
+  parser.add_argument("scenes")
+      .help("paths to the scene objects (.obj)")
+      .metavar("SCENE")
+      .nargs(argparse::nargs_pattern::at_least_one)
+      .default_value(std::vector<std::string>{"examples/scene01.obj", "examples/scene02.obj"});
+
+  parser.add_argument("-W", "--width")
+      .help("output image width")
+      .metavar("WIDTH")
+      .default_value(160U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("-H", "--height")
+      .help("output image height")
+      .metavar("HEIGHT")
+      .default_value(120U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("-s", "--spp")
+      .help("samples per pixel")
+      .metavar("SAPMLES_PER_PIXEL")
+      .default_value(64U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("--seed")
+      .help("base seed of the samplers, spp i is rendered with seed + i")
+      .metavar("SEED")
+      .default_value(0U)
+      .scan<'u', unsigned int>();
+  parser.add_argument("-j", "--threads")
+      .help("number of rendering threads")
+      .metavar("N")
+      .default_value(std::thread::hardware_concurrency())
+      .scan<'u', unsigned int>();
+
+  parser.add_argument("-r", "--reference")
+      .help("directory of the reference images (<scene>_<width>x<height>.pfm)")
+      .metavar("REFERENCE")
+      .default_value("examples/reference"s);
+  parser.add_argument("-o", "--output")
+      .help("output report (.json)")
+      .metavar("OUTPUT")
+      .default_value("mcpt_bench.json"s);
+  parser.add_argument("--make-reference")
+      .help("save the rendered images as the references instead of comparing with them")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("-v", "--verbose")
+      .help("enable verbose logging")
+      .default_value(false)
+      .implicit_value(true);
+  parser.add_argument("-w", "--wavefront")
+      .help("use the wavefront (stream) path tracing engine")
+      .default_value(false)
+      .implicit_value(true);
+
+  parser.add_argument("--sbvh")
+      .help("build the BVH tree with spatial splits, duplicating the references of large polygons")
+      .default_value(false)
+      .implicit_value(true);
+
+  parser.add_description("End-to-end benchmark of the Monte Carlo path tracing renderer.");
+
+  try {
+    parser.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << parser;
+  }
+
+  BenchArgs args;
+  for (const auto& scene : parser.get<std::vector<std::string>>("scenes"))
+    args.scene_paths.emplace_back(scene);
+  args.width = Get<unsigned int>(parser, "-W", [](auto v) { return v > 0; });
+  args.height = Get<unsigned int>(parser, "-H", [](auto v) { return v > 0; });
+  args.spp = Get<unsigned int>(parser, "-s", [](auto v) { return v > 0; });
+  args.seed = Get<unsigned int>(parser, "--seed");
+  args.num_threads = Get<unsigned int>(parser, "-j", [](auto v) { return v > 0; });
+
+  args.reference_path = Get<std::string>(parser, "-r");
+  args.output_path = Get<std::string>(parser, "-o");
+  args.make_reference = Get<bool>(parser, "--make-reference");
+  args.enable_verbose = Get<bool>(parser, "-v");
+  args.enable_wavefront = Get<bool>(parser, "-w");
+  args.enable_sbvh = Get<bool>(parser, "--sbvh");
+
+  return args;
+}
+
+ServerArgs InitServerArgParser(const std::string& name, int argc, char* argv[]) {
+  using namespace std::string_literals;
+
+  argparse::ArgumentParser parser(name, "1.0", argparse::default_arguments::help);
+
+  parser.add_argument("-S", "--socket")
+      .help("path to the Unix domain socket to listen on")
+      .metavar("SOCKET")
+      .default_value("/tmp/mcpt.sock"s);
+  parser.add_argument("-j", "--threads")
+      .help("number of rendering threads")
+      .metavar("N")
+      .default_value(std::thread::hardware_concurrency())
+      .scan<'u', unsigned int>();
+  parser.add_argument("-l", "--log")
+      .help("log directory")
+      .metavar("LOG")
+      .default_value("."s);
+  parser.add_argument("-v", "--verbose")
+      .help("enable verbose logging")
+      .default_value(false)
+      .implicit_value(true);
+
+  parser.add_description("Monte Carlo path tracing render server keeping the scenes resident.");
+
+  try {
+    parser.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << parser;
+  }
+
+  ServerArgs args;
+  args.socket_path = Get<std::string>(parser, "-S");
+  args.num_threads = Get<unsigned int>(parser, "-j", [](auto v) { return v > 0; });
+  args.log_path = Get<std::string>(parser, "-l");
+  args.enable_verbose = Get<bool>(parser, "-v");
+
+  return args;
+}
+
+ClientArgs InitClientArgParser(const std::string& name, int argc, char* argv[]) {
+  using namespace std::string_literals;
+
+  argparse::ArgumentParser parser(name, "1.0", argparse::default_arguments::help);
+
+  parser.add_argument("request")
+      .help("request to the server, e.g. `submit scene=examples/scene01.obj spp=16', `status'")
+      .metavar("REQUEST")
+      .remaining();
+
+  parser.add_argument("-S", "--socket")
+      .help("path to the Unix domain socket of the server")
+      .metavar("SOCKET")
+      .default_value("/tmp/mcpt.sock"s);
+  parser.add_argument("-o", "--output")
+      .help("directory to save the images streamed back")
+      .metavar("OUTPUT")
+      .default_value("."s);
+  parser.add_argument("-d", "--detach")
+      .help("return once the job is queued instead of watching it")
+      .default_value(false)
+      .implicit_value(true);
+
+  parser.add_description("Client of the Monte Carlo path tracing render server.");
+
+  try {
+    parser.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << parser;
+  }
+
+  ClientArgs args;
+  args.socket_path = Get<std::string>(parser, "-S");
+  if (auto request = parser.present<std::vector<std::string>>("request"))
+    args.request = std::move(request.value());
+  args.output_path = Get<std::string>(parser, "-o");
+  args.detach = Get<bool>(parser, "-d");
 
   return args;
 }
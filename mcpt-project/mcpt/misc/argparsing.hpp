@@ -2,6 +2,7 @@
 
 #include <string>
 #include <filesystem>
+#include <vector>
 
 #include <argparse/argparse.hpp>
 
@@ -13,12 +14,60 @@ struct RuntimeArgs {
   unsigned int height;
   unsigned int spp;
   unsigned int save_every_n;
+  unsigned int max_depth;
+  unsigned int rr_min_depth;
+  double rr_cont_prob;
+  float cache_cell_size;
+  unsigned int cache_min_samples;
 
+  std::filesystem::path cameras_path;
   std::filesystem::path output_path;
   bool enable_gui;
   bool enable_verbose;
+  bool enable_wavefront;
+  bool enable_batch;
+  bool enable_sbvh;
+  bool enable_ggx;
+  bool enable_guiding;
+  bool enable_trace;
+  bool save_cost;
+};
+
+struct BenchArgs {
+  std::vector<std::filesystem::path> scene_paths;
+  unsigned int width;
+  unsigned int height;
+  unsigned int spp;
+  unsigned int seed;
+  unsigned int num_threads;
+
+  std::filesystem::path reference_path;
+  std::filesystem::path output_path;
+  bool make_reference;
+  bool enable_verbose;
+  bool enable_wavefront;
+  bool enable_sbvh;
+};
+
+struct ServerArgs {
+  std::filesystem::path socket_path;
+  unsigned int num_threads;
+
+  std::filesystem::path log_path;
+  bool enable_verbose;
+};
+
+struct ClientArgs {
+  std::filesystem::path socket_path;
+  std::vector<std::string> request;
+
+  std::filesystem::path output_path;
+  bool detach;
 };
 
 RuntimeArgs InitArgParser(const std::string& name, int argc, char* argv[]);
+BenchArgs InitBenchArgParser(const std::string& name, int argc, char* argv[]);
+ServerArgs InitServerArgParser(const std::string& name, int argc, char* argv[]);
+ClientArgs InitClientArgParser(const std::string& name, int argc, char* argv[]);
 
 }  // namespace mcpt::misc
@@ -0,0 +1,89 @@
+#include "mcpt/misc/camera.hpp"
+
+#include <cmath>
+
+#include "mcpt/common/assert.hpp"
+
+namespace mcpt::misc {
+
+/**
+ * Y(m) |\
+ *      | \
+ *      |  \
+ *      |   \
+ *      |    \       /| y(mm): vertical CMOS half size
+ *      |     \     / |
+ *      |      \   /  |
+ *      |       \ /   |
+ *    --+--------X----+--
+ *         d(m)    f(mm)
+ *
+ * Y/d = y/f = fy
+ *
+ * h/2 = fy * Y/d
+ *  fy = h/2 * d/Y
+ *     = h/2 * f/y
+ */
+Eigen::Vector4f MakeCamera(unsigned int w, unsigned int h, float focal_length, float cmos_horizon) {
+  float cmos_vertical = cmos_horizon * h / w;
+  float fx = w * focal_length / cmos_horizon;
+  float fy = h * focal_length / cmos_vertical;
+  return Eigen::Vector4f(fx, fy, w / 2.0F, h / 2.0F);
+}
+
+cam_parser::Camera MakeSceneCamera(const std::string& scene_name) {
+  cam_parser::Camera camera{scene_name};
+  if (scene_name == "scene02") {
+    camera.rotation = Eigen::AngleAxisf(-25.0F / 180.0F * M_PI, Eigen::Vector3f::UnitX());
+    camera.position << 2.0F, 9.0F, 16.0F;
+  } else {
+    camera.position << 0.0F, 5.0F, 15.0F;
+  }
+  return camera;
+}
+
+/**
+ *         up
+ *          |   / z: forward
+ *          |  /
+ *          | /
+ *          |/
+ *   eye    o--------- x: right = z * up
+ *          |
+ *          |
+ *          y: down = z * x
+ */
+MonteCarlo::Options MakeOptions(const cam_parser::Camera& camera, unsigned int w, unsigned int h) {
+  if (camera.width && camera.height) {
+    w = camera.width;
+    h = camera.height;
+  }
+
+  MonteCarlo::Options mc_opts;
+  mc_opts.intrin = camera.intrin.has_value()
+                       ? camera.intrin.value()
+                       : MakeCamera(w, h, camera.focal_length, camera.cmos_horizon);
+  if (camera.lookat.has_value()) {
+    Eigen::Vector3f z = camera.lookat.value() - camera.position;
+    Eigen::Vector3f x = z.cross(camera.up);
+    ASSERT(z.norm() > 0.0F && x.norm() > 0.0F, "camera `{}' has a degenerate pose", camera.name);
+    mc_opts.R.col(2) = z.normalized();
+    mc_opts.R.col(0) = x.normalized();
+    mc_opts.R.col(1) = mc_opts.R.col(2).cross(mc_opts.R.col(0));
+  } else {
+    mc_opts.R.col(0) = Eigen::Vector3f::UnitX();
+    mc_opts.R.col(1) = -Eigen::Vector3f::UnitY();
+    mc_opts.R.col(2) = -Eigen::Vector3f::UnitZ();
+  }
+  mc_opts.R = camera.rotation * mc_opts.R;
+  mc_opts.t = camera.position;
+  return mc_opts;
+}
+
+MonteCarlo::Options MakeSceneOptions(const std::string& scene_name,
+                                     unsigned int w,
+                                     unsigned int h) {
+  return MakeOptions(MakeSceneCamera(scene_name), w, h);
+}
+
+}  // namespace mcpt::misc
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/parser/cam_parser/context.hpp"
+#include "mcpt/renderer/monte_carlo.hpp"
+
+namespace mcpt::misc {
+
+// pinhole intrinsics (fx, fy, cx, cy) of a camera with the given lens & CMOS width in mm
+Eigen::Vector4f MakeCamera(unsigned int w, unsigned int h, float focal_length, float cmos_horizon);
+
+// camera preset for the bundled example scenes (scene01 by default)
+cam_parser::Camera MakeSceneCamera(const std::string& scene_name);
+
+// MCPT options viewing from the camera, the camera size (if given) overrides `w' & `h'
+MonteCarlo::Options MakeOptions(const cam_parser::Camera& camera, unsigned int w, unsigned int h);
+
+// MCPT options with the camera pose preset for the bundled example scenes (scene01 by default)
+MonteCarlo::Options MakeSceneOptions(const std::string& scene_name, unsigned int w, unsigned int h);
+
+}  // namespace mcpt::misc
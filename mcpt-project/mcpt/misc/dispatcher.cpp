@@ -1,5 +1,6 @@
 #include "mcpt/misc/dispatcher.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <fstream>
 #include <mutex>
@@ -13,9 +14,19 @@
 
 #include "mcpt/common/assert.hpp"
 #include "mcpt/common/misc.hpp"
+#include "mcpt/common/trace.hpp"
 
 namespace {
 
+// number of image rows rendered in one traced zone
+constexpr size_t TILE_ROWS = 16;
+
+void reduce(const std::vector<float>& cost, std::vector<float>& cost_integral) {
+  cost_integral.resize(cost.size(), 0.0F);
+  for (size_t i = 0; i < cost.size(); ++i)
+    cost_integral[i] += cost[i];
+}
+
 void reduce(const std::vector<Eigen::Vector3f>& radiance, std::vector<float>& integral) {
   integral.resize(radiance.size() * 3, 0.0F);
   for (size_t i = 0; i < radiance.size(); ++i) {
@@ -25,23 +36,59 @@ void reduce(const std::vector<Eigen::Vector3f>& radiance, std::vector<float>& in
   }
 }
 
-std::future<void> save(const std::vector<float>& integral,
-                       mcpt::Fileserver& fs_out,
-                       size_t spp,
-                       unsigned int width,
-                       unsigned int height) {
+std::vector<float> average(const std::vector<float>& integral, size_t spp) {
   std::vector<float> im(integral.size());
   for (size_t i = 0; i < integral.size(); ++i)
     im[i] = integral[i] / spp;
+  return im;
+}
+
+// average over the spp accumulated in the tile of each pixel, where a tile has `tile_size' pixels
+// of `channels' channels each
+std::vector<float> average(const std::vector<float>& integral,
+                           size_t channels,
+                           size_t tile_size,
+                           const std::vector<size_t>& tile_spp) {
+  std::vector<float> im(integral.size());
+  for (size_t i = 0; i < integral.size(); ++i)
+    im[i] = integral[i] / tile_spp[i / channels / tile_size];
+  return im;
+}
 
-  return std::async(std::launch::async, [=, &fs_out, im = std::move(im)]() noexcept {
-    auto export_name = fmt::format("spp_{}.ppm", spp);
-    spdlog::info("saving to PPM image {}", fs_out.GetAbsolutePath(export_name));
+// save the average cost per sample as well unless `cost_im' is empty, then call `on_saved' if set
+std::future<void> save(std::vector<float> im,
+                       std::vector<float> cost_im,
+                       mcpt::Fileserver& fs_out,
+                       size_t spp,
+                       unsigned int width,
+                       unsigned int height,
+                       const Dispatcher::SavedFunc& on_saved = {}) {
+  return std::async(
+      std::launch::async,
+      [=, &fs_out, im = std::move(im), cost_im = std::move(cost_im)]() noexcept {
+        mcpt::trace::SetThreadName("saver");
+        TRACE_ZONE("save image");
+        auto export_name = fmt::format("spp_{}.ppm", spp);
+        spdlog::info("saving to PPM image {}", fs_out.GetAbsolutePath(export_name));
 
-    std::ofstream ofs;
-    ASSERT(fs_out.OpenTextWrite(export_name, ofs));
-    mcpt::RawToPPM(width, height, 2.2F, im.data(), ofs);
-  });
+        std::ofstream ofs;
+        ASSERT(fs_out.OpenTextWrite(export_name, ofs));
+        mcpt::RawToPPM(width, height, 2.2F, im.data(), ofs);
+
+        if (!cost_im.empty()) {
+          auto cost_name = fmt::format("spp_{}_cost.pfm", spp);
+          spdlog::info("saving cost heatmap to PFM image {}", fs_out.GetAbsolutePath(cost_name));
+
+          std::ofstream cost_ofs;
+          ASSERT(fs_out.OpenTextWrite(cost_name, cost_ofs));
+          mcpt::GrayToPFM(width, height, cost_im.data(), cost_ofs);
+        }
+
+        if (on_saved) {
+          ofs.close();
+          on_saved(spp, fs_out.GetAbsolutePath(export_name));
+        }
+      });
 }
 
 }  // namespace
@@ -50,41 +97,92 @@ void Dispatcher::Dispatch(const std::shared_ptr<mcpt::MonteCarlo>& mcpt_runner,
                           const std::shared_ptr<mcpt::PathLayer>& path_layer,
                           unsigned int width,
                           unsigned int height) {
-  static std::atomic_size_t shared_spp_idx = 0;
+  auto render = [=](size_t spp_idx,
+                    std::vector<Eigen::Vector3f>& radiance,
+                    std::vector<float>& cost) {
+    for (size_t first = 0; first < radiance.size(); first += TILE_ROWS * width) {
+      TRACE_ZONE("render tile");
+      size_t last = std::min(radiance.size(), first + TILE_ROWS * width);
+      for (size_t i = first; i < last; ++i) {
+        auto result = mcpt_runner->Run(i % width, i / width);
+        radiance[i].noalias() = result.radiance;
+        cost[i] = result.cost;
+        if (path_layer && spp_idx == 1 && !result.rpaths.empty())
+          path_layer->AddPaths(mcpt_runner->options().t, result.rpaths);
+      }
+    }
+  };
+  Dispatch(render, width, height);
+}
 
-  static std::mutex mutex;
-  static size_t spp_completed = 0;
-  static std::vector<float> integral;
-  static spdlog::stopwatch sw;
+void Dispatcher::Dispatch(const std::shared_ptr<mcpt::Wavefront>& wavefront_runner,
+                          unsigned int width,
+                          unsigned int height) {
+  auto render = [=](size_t, std::vector<Eigen::Vector3f>& radiance, std::vector<float>& cost) {
+    wavefront_runner->Run(width, 0, radiance.size(), radiance.data(), cost.data());
+  };
+  Dispatch(render, width, height);
+}
+
+void Dispatcher::Dispatch(const RenderFunc& render, unsigned int width, unsigned int height) {
+  // shared by the workers of this dispatch only, so that dispatchers can render one after another
+  struct Progress {
+    std::atomic_size_t spp_idx = 0;
+
+    std::mutex mutex;
+    size_t spp_completed = 0;
+    std::vector<float> integral;
+    std::vector<float> cost_integral;
+    spdlog::stopwatch sw;
+  };
+  auto progress = std::make_shared<Progress>();
 
-  auto worker = [=]() {
+  auto worker = [=](unsigned int worker_idx) {
+    mcpt::trace::SetThreadName(fmt::format("worker {}", worker_idx));
     std::vector<Eigen::Vector3f> radiance(width * height);
+    std::vector<float> cost(width * height);
 
-    for (size_t spp_idx = ++shared_spp_idx; spp_idx <= m_spp; spp_idx = ++shared_spp_idx) {
+    auto& [shared_spp_idx, mutex, spp_completed, integral, cost_integral, sw] = *progress;
+    for (size_t spp_idx = ++shared_spp_idx; spp_idx <= m_spp && !m_cancelled;
+         spp_idx = ++shared_spp_idx) {
       spdlog::stopwatch sw_spp;
 
-      for (size_t i = 0; i < width * height; ++i) {
-        auto result = mcpt_runner->Run(i % width, i / width);
-        radiance[i].noalias() = result.radiance;
-        if (spp_idx == 1 && !result.rpaths.empty())
-          path_layer->AddPaths(mcpt_runner->options().t, result.rpaths);
+      {
+        TRACE_ZONE("render spp");
+        render(spp_idx, radiance, cost);
       }
 
       spdlog::info(
           "spp: {}/{}, {:%M:%Ss} {{{:%M:%Ss}}}", spp_idx, m_spp, sw_spp.elapsed(), sw.elapsed());
 
       {
-        std::lock_guard lock(mutex);
+        std::unique_lock lock(mutex, std::defer_lock);
+        {
+          TRACE_ZONE("wait for accumulation");
+          lock.lock();
+        }
+        TRACE_ZONE("reduce");
         reduce(radiance, integral);
+        if (m_save_cost)
+          reduce(cost, cost_integral);
         ++spp_completed;
-        if (spp_completed == m_spp || (m_save_every_n && spp_completed % m_save_every_n == 0))
-          m_saving_tasks.push_back(save(integral, m_fs_out, spp_completed, width, height));
+        if (m_on_progress)
+          m_on_progress(spp_completed);
+        if (spp_completed == m_spp || (m_save_every_n && spp_completed % m_save_every_n == 0)) {
+          m_saving_tasks.push_back(save(average(integral, spp_completed),
+                                        average(cost_integral, spp_completed),
+                                        m_fs_out,
+                                        spp_completed,
+                                        width,
+                                        height,
+                                        m_on_saved));
+        }
       }
     }
   };
 
   for (unsigned int i = 0; i < m_spp && i < m_num_threads; ++i)
-    m_worker_threads.emplace_back(worker);
+    m_worker_threads.emplace_back(worker, i);
 }
 
 void Dispatcher::JoinAll() {
@@ -97,3 +195,140 @@ void Dispatcher::JoinAll() {
     t.get();
   }
 }
+
+void BatchDispatcher::AddFrame(std::string name,
+                               mcpt::Fileserver& fs_out,
+                               const std::shared_ptr<mcpt::MonteCarlo>& mcpt_runner,
+                               unsigned int width,
+                               unsigned int height) {
+  auto render = [=](size_t, size_t first, size_t last, Eigen::Vector3f* radiance, float* cost) {
+    for (size_t i = first; i < last; ++i) {
+      auto result = mcpt_runner->Run(i % width, i / width);
+      radiance[i - first].noalias() = result.radiance;
+      cost[i - first] = result.cost;
+    }
+  };
+  AddFrame(std::move(name), fs_out, render, width, height);
+}
+
+void BatchDispatcher::AddFrame(std::string name,
+                               mcpt::Fileserver& fs_out,
+                               const std::shared_ptr<mcpt::Wavefront>& wavefront_runner,
+                               unsigned int width,
+                               unsigned int height) {
+  auto render = [=](size_t, size_t first, size_t last, Eigen::Vector3f* radiance, float* cost) {
+    wavefront_runner->Run(width, first, last, radiance, cost);
+  };
+  AddFrame(std::move(name), fs_out, render, width, height);
+}
+
+void BatchDispatcher::AddFrame(std::string name,
+                               mcpt::Fileserver& fs_out,
+                               RenderTileFunc render,
+                               unsigned int width,
+                               unsigned int height) {
+  size_t num_tiles = (height + TILE_ROWS - 1) / TILE_ROWS;
+  auto& frame = m_frames.emplace_back(
+      new Frame{std::move(name), fs_out, std::move(render), width, height, num_tiles});
+  frame->tile_spp.resize(num_tiles, 0);
+  frame->integral.resize(size_t(width) * height * 3, 0.0F);
+  if (m_save_cost)
+    frame->cost_integral.resize(size_t(width) * height, 0.0F);
+}
+
+double BatchDispatcher::Run() {
+  // the tiles are numbered frame by frame, spp by spp
+  std::vector<size_t> first_tiles{0};
+  for (const auto& frame : m_frames)
+    first_tiles.push_back(first_tiles.back() + frame->num_tiles * m_spp);
+  size_t num_tiles = first_tiles.back();
+
+  std::atomic_size_t shared_tile_idx = 0;
+  spdlog::stopwatch sw;
+
+  auto worker = [&](unsigned int worker_idx) {
+    mcpt::trace::SetThreadName(fmt::format("worker {}", worker_idx));
+    std::vector<Eigen::Vector3f> radiance;
+    std::vector<float> cost;
+
+    for (size_t tile_idx = shared_tile_idx++; tile_idx < num_tiles; tile_idx = shared_tile_idx++) {
+      auto first_tile = std::upper_bound(first_tiles.cbegin(), first_tiles.cend(), tile_idx) - 1;
+      auto& frame = *m_frames[first_tile - first_tiles.cbegin()];
+      size_t spp_idx = (tile_idx - *first_tile) / frame.num_tiles + 1;
+      size_t tile = (tile_idx - *first_tile) % frame.num_tiles;
+
+      size_t first = tile * TILE_ROWS * frame.width;
+      size_t last = std::min(size_t(frame.width) * frame.height, first + TILE_ROWS * frame.width);
+      radiance.resize(last - first);
+      cost.resize(last - first);
+      {
+        TRACE_ZONE("render tile");
+        frame.render(spp_idx, first, last, radiance.data(), cost.data());
+      }
+      Reduce(frame, tile, radiance, cost, sw.elapsed().count());
+    }
+  };
+
+  std::vector<std::thread> worker_threads;
+  for (unsigned int i = 0; i < num_tiles && i < m_num_threads; ++i)
+    worker_threads.emplace_back(worker, i);
+  for (auto& t : worker_threads)
+    t.join();
+  for (auto& t : m_saving_tasks) {
+    ASSERT(t.valid());
+    t.get();
+  }
+
+  double seconds = sw.elapsed().count();
+  spdlog::info("rendered {} frames in {:.3f}s: {:.2f} frames/hour",
+               m_frames.size(),
+               seconds,
+               seconds > 0.0 ? m_frames.size() / seconds * 3600.0 : 0.0);
+  return seconds;
+}
+
+/**
+ * a tile may be accumulated while the other tiles of the frame are still behind, an intermediate
+ * image is saved once all the tiles have reached the spp, each tile averaged over its own spp
+ */
+void BatchDispatcher::Reduce(Frame& frame,
+                             size_t tile,
+                             const std::vector<Eigen::Vector3f>& radiance,
+                             const std::vector<float>& cost,
+                             double seconds) {
+  std::unique_lock lock(frame.mutex, std::defer_lock);
+  {
+    TRACE_ZONE("wait for accumulation");
+    lock.lock();
+  }
+  TRACE_ZONE("reduce");
+  size_t first = tile * TILE_ROWS * frame.width;
+  for (size_t i = 0; i < radiance.size(); ++i) {
+    frame.integral[(first + i) * 3 + 0] += radiance[i].x();
+    frame.integral[(first + i) * 3 + 1] += radiance[i].y();
+    frame.integral[(first + i) * 3 + 2] += radiance[i].z();
+  }
+  if (m_save_cost) {
+    for (size_t i = 0; i < cost.size(); ++i)
+      frame.cost_integral[first + i] += cost[i];
+  }
+  ++frame.tile_spp[tile];
+
+  size_t spp_completed = *std::min_element(frame.tile_spp.cbegin(), frame.tile_spp.cend());
+  if (spp_completed == frame.spp_completed)
+    return;
+  frame.spp_completed = spp_completed;
+  spdlog::info("frame `{}' spp: {}/{}, {:.3f}s", frame.name, spp_completed, m_spp, seconds);
+
+  if (spp_completed == m_spp || (m_save_every_n && spp_completed % m_save_every_n == 0)) {
+    size_t tile_size = TILE_ROWS * frame.width;
+    auto task = save(average(frame.integral, 3, tile_size, frame.tile_spp),
+                     average(frame.cost_integral, 1, tile_size, frame.tile_spp),
+                     frame.fs_out,
+                     spp_completed,
+                     frame.width,
+                     frame.height);
+    std::lock_guard saving_lock(m_saving_mutex);
+    m_saving_tasks.push_back(std::move(task));
+  }
+}
@@ -1,34 +1,152 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
+#include <filesystem>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include <Eigen/Eigen>
+
 #include "mcpt/common/fileserver/fileserver.hpp"
 #include "mcpt/common/viz/path_layer.hpp"
 #include "mcpt/renderer/monte_carlo.hpp"
+#include "mcpt/renderer/wavefront.hpp"
 
 class Dispatcher {
 public:
-  Dispatcher(mcpt::Fileserver& fs_out, unsigned int num_threads, size_t spp, size_t save_every_n)
-      : m_fs_out(fs_out), m_num_threads(num_threads), m_spp(spp), m_save_every_n(save_every_n) {}
+  // called with the spp completed after every spp
+  using ProgressFunc = std::function<void(size_t spp_completed)>;
+  // called from the saving thread once an image is written
+  using SavedFunc = std::function<void(size_t spp, const std::filesystem::path& image_path)>;
+
+  // if `save_cost' is set, the per-pixel traversal cost is saved with the image as well
+  Dispatcher(mcpt::Fileserver& fs_out,
+             unsigned int num_threads,
+             size_t spp,
+             size_t save_every_n,
+             bool save_cost = false)
+      : m_fs_out(fs_out),
+        m_num_threads(num_threads),
+        m_spp(spp),
+        m_save_every_n(save_every_n),
+        m_save_cost(save_cost) {}
 
+  // the paths of the first spp are added to `path_layer' unless it is null
   void Dispatch(const std::shared_ptr<mcpt::MonteCarlo>& mcpt_runner,
                 const std::shared_ptr<mcpt::PathLayer>& path_layer,
                 unsigned int width,
                 unsigned int height);
 
+  void Dispatch(const std::shared_ptr<mcpt::Wavefront>& wavefront_runner,
+                unsigned int width,
+                unsigned int height);
+
+  void SetCallbacks(ProgressFunc on_progress, SavedFunc on_saved) {
+    m_on_progress = std::move(on_progress);
+    m_on_saved = std::move(on_saved);
+  }
+
+  // stop the workers once the spp being rendered are done, the unfinished image is not saved
+  void Cancel() noexcept { m_cancelled = true; }
+
   void JoinAll();
 
 private:
+  // render one spp of the whole image into `radiance', and the BVH nodes visited into `cost'
+  using RenderFunc = std::function<void(
+      size_t spp_idx, std::vector<Eigen::Vector3f>& radiance, std::vector<float>& cost)>;
+
+  void Dispatch(const RenderFunc& render, unsigned int width, unsigned int height);
+
   std::reference_wrapper<mcpt::Fileserver> m_fs_out;
   unsigned int m_num_threads;
   size_t m_spp;
   size_t m_save_every_n;
+  bool m_save_cost;
+
+  ProgressFunc m_on_progress;
+  SavedFunc m_on_saved;
+  std::atomic_bool m_cancelled = false;
 
   std::vector<std::thread> m_worker_threads;
   std::deque<std::future<void>> m_saving_tasks;
 };
+
+// render the frames of a batch (e.g. views of the same scene) through one worker pool
+//
+// every spp of a frame is split into tiles of rows, the workers pick up the tiles frame by frame so
+// that the ones done with the last tiles of a frame move on to the next frames instead of idling
+class BatchDispatcher {
+public:
+  BatchDispatcher(unsigned int num_threads, size_t spp, size_t save_every_n, bool save_cost = false)
+      : m_num_threads(num_threads),
+        m_spp(spp),
+        m_save_every_n(save_every_n),
+        m_save_cost(save_cost) {}
+
+  void AddFrame(std::string name,
+                mcpt::Fileserver& fs_out,
+                const std::shared_ptr<mcpt::MonteCarlo>& mcpt_runner,
+                unsigned int width,
+                unsigned int height);
+
+  void AddFrame(std::string name,
+                mcpt::Fileserver& fs_out,
+                const std::shared_ptr<mcpt::Wavefront>& wavefront_runner,
+                unsigned int width,
+                unsigned int height);
+
+  // render all the frames and wait for the results saved, return the seconds elapsed
+  double Run();
+
+private:
+  // render the pixels [first, last) of one spp into `radiance', and the BVH nodes visited into
+  // `cost'
+  using RenderTileFunc = std::function<void(
+      size_t spp_idx, size_t first, size_t last, Eigen::Vector3f* radiance, float* cost)>;
+
+  struct Frame {
+    std::string name;
+    std::reference_wrapper<mcpt::Fileserver> fs_out;
+    RenderTileFunc render;
+    unsigned int width;
+    unsigned int height;
+    size_t num_tiles;
+
+    std::mutex mutex;
+    // spp accumulated in each tile, and the ones all the tiles have reached
+    std::vector<size_t> tile_spp;
+    size_t spp_completed = 0;
+    std::vector<float> integral;
+    std::vector<float> cost_integral;
+  };
+
+  void AddFrame(std::string name,
+                mcpt::Fileserver& fs_out,
+                RenderTileFunc render,
+                unsigned int width,
+                unsigned int height);
+
+  // accumulate a rendered tile into its frame, save the frame if some spp gets completed
+  void Reduce(Frame& frame,
+              size_t tile,
+              const std::vector<Eigen::Vector3f>& radiance,
+              const std::vector<float>& cost,
+              double seconds);
+
+  unsigned int m_num_threads;
+  size_t m_spp;
+  size_t m_save_every_n;
+  bool m_save_cost;
+
+  std::vector<std::unique_ptr<Frame>> m_frames;
+
+  std::mutex m_saving_mutex;
+  std::deque<std::future<void>> m_saving_tasks;
+};
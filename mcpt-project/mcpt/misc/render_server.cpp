@@ -0,0 +1,420 @@
+#include "mcpt/misc/render_server.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/stopwatch.h>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/fileserver/fileserver.hpp"
+#include "mcpt/misc/camera.hpp"
+#include "mcpt/parser/cam_parser/parser.hpp"
+#include "mcpt/parser/obj_parser/parser.hpp"
+#include "mcpt/parser/parse_helper.hpp"
+#include "mcpt/renderer/bxdf.hpp"
+#include "mcpt/renderer/monte_carlo.hpp"
+#include "mcpt/renderer/wavefront.hpp"
+
+namespace mcpt::misc {
+
+namespace {
+
+// split the first word from the rest
+std::pair<std::string_view, std::string_view> Split(std::string_view s) {
+  auto first = s.find_first_not_of(' ');
+  if (first == std::string_view::npos)
+    return {};
+  s.remove_prefix(first);
+  auto last = s.find(' ');
+  if (last == std::string_view::npos)
+    return {s, {}};
+  return {s.substr(0, last), s.substr(last + 1)};
+}
+
+template <typename T>
+bool AsNumber(std::string_view token, T& number) {
+  auto ret = std::from_chars(token.data(), token.data() + token.size(), number);
+  return ret.ec == std::errc{} && ret.ptr == token.data() + token.size();
+}
+
+}  // namespace
+
+const char* RenderServer::ToString(State state) {
+  static const char* NAMES[] = {"queued", "running", "done", "cancelled"};
+  return NAMES[static_cast<int>(state)];
+}
+
+RenderServer::Scene::Scene(const std::filesystem::path& path)
+    : object(obj_parser::Parser(path).object()), bvh(object.CreateBVHTree()) {}
+
+bool RenderServer::Connection::Send(std::string_view message) {
+  std::lock_guard lock(mutex);
+  return socket.Write(message);
+}
+
+RenderServer::RenderServer(std::filesystem::path socket_path, unsigned int num_threads)
+    : m_socket_path(std::move(socket_path)), m_num_threads(num_threads) {}
+
+void RenderServer::Run() {
+  m_listener = UnixSocket::Listen(m_socket_path);
+  ASSERT(m_listener.valid(), "failed to listen on {}", m_socket_path);
+  spdlog::info("listening on {}", m_socket_path);
+
+  std::thread render_thread(&RenderServer::Render, this);
+  // a client thread holds its connection until the client disconnects
+  std::vector<std::pair<std::thread, std::weak_ptr<Connection>>> client_threads;
+  while (true) {
+    auto socket = m_listener.Accept();
+    if (!socket.valid())
+      break;
+    auto conn = std::make_shared<Connection>();
+    conn->socket = std::move(socket);
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_stopped)
+        break;
+      m_connections.erase(
+          std::remove_if(m_connections.begin(),
+                         m_connections.end(),
+                         [](auto& c) { return c.expired(); }),
+          m_connections.end());
+      m_connections.push_back(conn);
+    }
+    // reap the threads of the clients gone
+    client_threads.erase(std::remove_if(client_threads.begin(),
+                                        client_threads.end(),
+                                        [](auto& client) {
+                                          if (!client.second.expired())
+                                            return false;
+                                          client.first.join();
+                                          return true;
+                                        }),
+                         client_threads.end());
+    client_threads.emplace_back(std::thread(&RenderServer::Serve, this, conn), conn);
+  }
+
+  // wake up the clients still connected
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopped = true;
+    for (const auto& conn : m_connections) {
+      if (auto c = conn.lock())
+        c->socket.Shutdown();
+    }
+  }
+  m_cv.notify_all();
+  for (auto& client : client_threads)
+    client.first.join();
+  render_thread.join();
+  std::filesystem::remove(m_socket_path);
+  spdlog::info("server stopped");
+}
+
+void RenderServer::Serve(const std::shared_ptr<Connection>& conn) {
+  std::string line;
+  while (conn->socket.ReadLine(line)) {
+    spdlog::debug("request: {}", line);
+    auto [command, request] = Split(line);
+    std::string reply;
+    if (command == "submit")
+      reply = Submit(request, conn);
+    else if (command == "watch")
+      reply = Watch(request, conn);
+    else if (command == "cancel")
+      reply = Cancel(request);
+    else if (command == "status")
+      reply = Status();
+    else if (command == "shutdown")
+      reply = Shutdown();
+    else
+      reply = fmt::format("error unknown command `{}'\n", command);
+
+    if (!reply.empty() && !conn->Send(reply))
+      break;
+  }
+}
+
+/**
+ * submit scene=PATH spp=N [cameras=PATH] [camera=NAME] [width=W] [height=H] [priority=P]
+ *        [output=DIR] [save_every=N] [max_depth=N] [wavefront=0|1]
+ */
+std::string RenderServer::Submit(std::string_view request,
+                                 const std::shared_ptr<Connection>& conn) {
+  auto job = std::make_shared<Job>();
+  unsigned int wavefront = 0;
+  for (auto [token, rest] = Split(request); !token.empty(); std::tie(token, rest) = Split(rest)) {
+    auto eq = token.find('=');
+    if (eq == std::string_view::npos)
+      return fmt::format("error expect key=value instead of `{}'\n", token);
+    auto key = token.substr(0, eq);
+    auto value = token.substr(eq + 1);
+
+    bool valid = true;
+    if (key == "scene")
+      job->scene_path = std::filesystem::absolute(value);
+    else if (key == "cameras")
+      job->cameras_path = std::filesystem::absolute(value);
+    else if (key == "camera")
+      job->camera_name = value;
+    else if (key == "output")
+      job->output_path = std::filesystem::absolute(value);
+    else if (key == "width")
+      valid = AsNumber(value, job->width) && job->width > 0;
+    else if (key == "height")
+      valid = AsNumber(value, job->height) && job->height > 0;
+    else if (key == "spp")
+      valid = AsNumber(value, job->spp) && job->spp > 0;
+    else if (key == "save_every")
+      valid = AsNumber(value, job->save_every_n);
+    else if (key == "max_depth")
+      valid = AsNumber(value, job->max_depth);
+    else if (key == "priority")
+      valid = AsNumber(value, job->priority);
+    else if (key == "wavefront")
+      valid = AsNumber(value, wavefront) && wavefront <= 1;
+    else
+      return fmt::format("error unknown key `{}'\n", key);
+    if (!valid)
+      return fmt::format("error invalid value `{}' for `{}'\n", value, key);
+  }
+  job->wavefront = wavefront;
+
+  if (job->scene_path.empty())
+    return "error scene must be given\n";
+  if (job->spp == 0)
+    return "error spp must be given\n";
+
+  // parse here rather than in the rendering thread, so that a malformed scene is reported to the
+  // client instead of failing the job
+  try {
+    job->scene = LoadScene(job->scene_path);
+    job->camera = MakeSceneCamera(job->scene_path.stem().string());
+    if (!job->cameras_path.empty()) {
+      auto cameras = cam_parser::Parser(job->cameras_path).cameras();
+      auto it = std::find_if(cameras.cbegin(), cameras.cend(), [&job](auto& c) {
+        return job->camera_name.empty() || c.name == job->camera_name;
+      });
+      if (it == cameras.cend())
+        return fmt::format(
+            "error no camera `{}' in {}\n", job->camera_name, job->cameras_path.native());
+      job->camera = *it;
+    }
+  } catch (const ParseError& e) {
+    spdlog::error("failed to submit: {}", e.what());
+    return fmt::format("error {}\n", e.what());
+  }
+  if (!job->camera.width || !job->camera.height) {
+    job->camera.width = job->width;
+    job->camera.height = job->height;
+  }
+
+  std::unique_lock lock(m_mutex);
+  if (m_stopped)
+    return "error shutting down\n";
+  job->id = m_next_job_id++;
+  m_jobs.emplace(job->id, job);
+  m_watchers.emplace(job->id, conn);
+  m_queue.push_back(job);
+  // reply before any progress of the job, which is notified under the lock of the connection, but
+  // don't block the server on the client
+  std::unique_lock conn_lock(conn->mutex);
+  lock.unlock();
+  m_cv.notify_one();
+  spdlog::info("job {} queued with priority {}: {}", job->id, job->priority, job->scene_path);
+  conn->socket.Write(fmt::format("ok {}\n", job->id));
+  return {};
+}
+
+std::string RenderServer::Watch(std::string_view request, const std::shared_ptr<Connection>& conn) {
+  size_t id = 0;
+  if (!AsNumber(Split(request).first, id))
+    return "error expect a job id\n";
+
+  std::lock_guard lock(m_mutex);
+  auto it = m_jobs.find(id);
+  if (it == m_jobs.end())
+    return fmt::format("error no such job {}\n", id);
+  const auto& job = *it->second;
+  if (job.state != State::QUEUED && job.state != State::RUNNING)
+    return fmt::format("ok\ndone {} {}\n", id, ToString(job.state));
+  m_watchers.emplace(id, conn);
+  return "ok\n";
+}
+
+std::string RenderServer::Cancel(std::string_view request) {
+  size_t id = 0;
+  if (!AsNumber(Split(request).first, id))
+    return "error expect a job id\n";
+
+  std::unique_lock lock(m_mutex);
+  auto it = m_jobs.find(id);
+  if (it == m_jobs.end())
+    return fmt::format("error no such job {}\n", id);
+  auto& job = *it->second;
+  if (job.state == State::QUEUED) {
+    m_queue.erase(std::find(m_queue.begin(), m_queue.end(), it->second));
+    job.state = State::CANCELLED;
+    lock.unlock();
+    Notify(job, fmt::format("done {} {}\n", id, ToString(job.state)));
+  } else if (job.state == State::RUNNING) {
+    // reported done by the rendering thread once the workers stop
+    job.cancelled = true;
+    if (job.dispatcher)
+      job.dispatcher->Cancel();
+  } else {
+    return fmt::format("error job {} is {}\n", id, ToString(job.state));
+  }
+  spdlog::info("job {} cancelled", id);
+  return "ok\n";
+}
+
+std::string RenderServer::Status() {
+  std::lock_guard lock(m_mutex);
+  std::string reply;
+  for (const auto& [id, job] : m_jobs) {
+    reply += fmt::format("job {} {} {}/{} {} {}\n",
+                         id,
+                         ToString(job->state),
+                         job->spp_completed,
+                         job->spp,
+                         job->priority,
+                         job->scene_path.native());
+  }
+  return reply + "ok\n";
+}
+
+std::string RenderServer::Shutdown() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopped = true;
+    for (const auto& [id, job] : m_jobs) {
+      if (job->state == State::RUNNING && job->dispatcher) {
+        job->cancelled = true;
+        job->dispatcher->Cancel();
+      }
+    }
+  }
+  m_cv.notify_all();
+  // wake up the accepting thread
+  m_listener.Shutdown();
+  spdlog::info("shutting down");
+  return "ok\n";
+}
+
+void RenderServer::Render() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock lock(m_mutex);
+      m_cv.wait(lock, [this]() { return m_stopped || !m_queue.empty(); });
+      if (m_stopped)
+        return;
+      // the highest priority first, then the earliest
+      auto it = std::min_element(m_queue.begin(), m_queue.end(), [](auto& lhs, auto& rhs) {
+        return lhs->priority != rhs->priority ? lhs->priority > rhs->priority : lhs->id < rhs->id;
+      });
+      job = *it;
+      m_queue.erase(it);
+      job->state = State::RUNNING;
+    }
+    RenderJob(*job);
+  }
+}
+
+void RenderServer::RenderJob(Job& job) {
+  spdlog::stopwatch sw;
+  const auto& scene = job.scene;
+  const auto& camera = job.camera;
+  auto mc_opts = MakeOptions(camera, camera.width, camera.height);
+  mc_opts.max_depth = job.max_depth;
+
+  SandboxFileserver fs_out(job.output_path);
+  Dispatcher dispatcher(fs_out, m_num_threads, job.spp, job.save_every_n);
+  dispatcher.SetCallbacks(
+      [this, &job](size_t spp_completed) {
+        {
+          std::lock_guard lock(m_mutex);
+          job.spp_completed = spp_completed;
+        }
+        Notify(job, fmt::format("progress {} {}/{}\n", job.id, spp_completed, job.spp));
+      },
+      [this, &job](size_t spp, const std::filesystem::path& image_path) {
+        std::ifstream ifs(image_path, std::ios::binary);
+        std::string image(std::istreambuf_iterator<char>(ifs), {});
+        Notify(job, fmt::format("image {} {} {}\n", job.id, spp, image.size()) + image);
+      });
+  {
+    std::lock_guard lock(m_mutex);
+    job.dispatcher = &dispatcher;
+    if (job.cancelled)
+      dispatcher.Cancel();
+  }
+
+  spdlog::info("job {}: rendering {} at {}x{} for spp: {}",
+               job.id,
+               job.scene_path,
+               camera.width,
+               camera.height,
+               job.spp);
+  std::shared_ptr<MonteCarlo> mcpt_runner;
+  std::shared_ptr<Wavefront> wavefront_runner;
+  if (job.wavefront) {
+    wavefront_runner = std::make_shared<Wavefront>(mc_opts, scene->object, scene->bvh);
+    wavefront_runner->SetBxDF(BlinnPhongBxDF());
+    dispatcher.Dispatch(wavefront_runner, camera.width, camera.height);
+  } else {
+    mcpt_runner = std::make_shared<MonteCarlo>(mc_opts, scene->object, scene->bvh);
+    mcpt_runner->SetBxDF(BlinnPhongBxDF());
+    dispatcher.Dispatch(mcpt_runner, nullptr, camera.width, camera.height);
+  }
+  dispatcher.JoinAll();
+
+  State state;
+  {
+    std::lock_guard lock(m_mutex);
+    job.dispatcher = nullptr;
+    job.state = job.cancelled ? State::CANCELLED : State::DONE;
+    state = job.state;
+  }
+  spdlog::info("job {} {} in {:.3f}s", job.id, ToString(state), sw.elapsed().count());
+  Notify(job, fmt::format("done {} {}\n", job.id, ToString(state)));
+}
+
+void RenderServer::Notify(const Job& job, std::string_view message) {
+  std::vector<std::shared_ptr<Connection>> watchers;
+  {
+    std::lock_guard lock(m_mutex);
+    auto [first, last] = m_watchers.equal_range(job.id);
+    for (auto it = first; it != last;) {
+      if (auto conn = it->second.lock()) {
+        watchers.push_back(std::move(conn));
+        ++it;
+      } else {
+        it = m_watchers.erase(it);
+      }
+    }
+  }
+  for (const auto& conn : watchers)
+    conn->Send(message);
+}
+
+std::shared_ptr<RenderServer::Scene> RenderServer::LoadScene(const std::filesystem::path& path) {
+  std::lock_guard lock(m_scenes_mutex);
+  auto& scene = m_scenes[path];
+  if (!scene) {
+    spdlog::info("loading object from {}", path);
+    scene = std::make_shared<Scene>(path);
+  } else {
+    spdlog::info("reusing object & BVH tree of {}", path);
+  }
+  return scene;
+}
+
+}  // namespace mcpt::misc
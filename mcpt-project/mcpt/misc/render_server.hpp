@@ -0,0 +1,122 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mcpt/common/geometry/bvh_tree.hpp"
+#include "mcpt/common/object/object.hpp"
+#include "mcpt/misc/dispatcher.hpp"
+#include "mcpt/misc/unix_socket.hpp"
+#include "mcpt/parser/cam_parser/context.hpp"
+
+namespace mcpt::misc {
+
+/**
+ * render daemon keeping the parsed scenes & BVH trees resident, one request or reply per line
+ *
+ *   client                                     server
+ *     | submit scene=S spp=N [key=value ...]  --> |  parse & queue a job, the client watches it
+ *     |                              ok <id> <--  |
+ *     |                    or error <reason> <--  |  e.g. the scene fails to parse
+ *     |             progress <id> <spp>/<N> <--   |  after every spp
+ *     | image <id> <spp> <bytes>\n<PPM bytes> <-- |  after every image saved
+ *     |                  done <id> <state> <--    |
+ *     | watch <id> / cancel <id>               --> |
+ *     | status                                 --> |  job <id> <state> <spp>/<N> <priority> <scene>
+ *     | shutdown                               --> |  ... ok
+ *
+ * the queued jobs of higher priority are rendered first, and the running job is never preempted
+ */
+class RenderServer {
+public:
+  RenderServer(std::filesystem::path socket_path, unsigned int num_threads);
+
+  // serve until some client requests to shut down
+  void Run();
+
+private:
+  struct Scene {
+    explicit Scene(const std::filesystem::path& path);
+
+    Object object;
+    BVHTree<float> bvh;
+  };
+
+  enum class State { QUEUED, RUNNING, DONE, CANCELLED };
+  static const char* ToString(State state);
+
+  struct Job {
+    size_t id = 0;
+    int priority = 0;
+
+    std::filesystem::path scene_path;
+    std::filesystem::path cameras_path;
+    std::string camera_name;
+    std::filesystem::path output_path{"./out"};
+    unsigned int width = 800;
+    unsigned int height = 600;
+    unsigned int spp = 0;
+    unsigned int save_every_n = 0;
+    unsigned int max_depth = 0;
+    bool wavefront = false;
+
+    // parsed when submitted
+    std::shared_ptr<Scene> scene;
+    cam_parser::Camera camera;
+
+    // guarded by the server mutex
+    State state = State::QUEUED;
+    size_t spp_completed = 0;
+    bool cancelled = false;
+    Dispatcher* dispatcher = nullptr;
+  };
+
+  struct Connection {
+    UnixSocket socket;
+    std::mutex mutex;
+
+    bool Send(std::string_view message);
+  };
+
+  // serve the requests of a client until it disconnects
+  void Serve(const std::shared_ptr<Connection>& conn);
+  // render the queued jobs one by one until shutting down
+  void Render();
+  void RenderJob(Job& job);
+
+  std::string Submit(std::string_view request, const std::shared_ptr<Connection>& conn);
+  std::string Watch(std::string_view request, const std::shared_ptr<Connection>& conn);
+  std::string Cancel(std::string_view request);
+  std::string Status();
+  std::string Shutdown();
+
+  // send a message to all the clients watching the job
+  void Notify(const Job& job, std::string_view message);
+
+  std::shared_ptr<Scene> LoadScene(const std::filesystem::path& path);
+
+  std::filesystem::path m_socket_path;
+  unsigned int m_num_threads;
+  UnixSocket m_listener;
+
+  // the scenes are loaded by the client threads
+  std::mutex m_scenes_mutex;
+  std::map<std::filesystem::path, std::shared_ptr<Scene>> m_scenes;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stopped = false;
+  size_t m_next_job_id = 1;
+  std::map<size_t, std::shared_ptr<Job>> m_jobs;
+  std::vector<std::shared_ptr<Job>> m_queue;
+  std::multimap<size_t, std::weak_ptr<Connection>> m_watchers;
+  std::vector<std::weak_ptr<Connection>> m_connections;
+};
+
+}  // namespace mcpt::misc
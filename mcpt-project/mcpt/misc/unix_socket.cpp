@@ -0,0 +1,140 @@
+#include "mcpt/misc/unix_socket.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace mcpt::misc {
+
+namespace {
+
+constexpr int BACKLOG = 16;
+constexpr size_t READ_SIZE = 4096;
+
+bool MakeAddress(const std::filesystem::path& path, sockaddr_un& addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.native().size() >= sizeof(addr.sun_path)) {
+    spdlog::error("socket path too long: {}", path.native());
+    return false;
+  }
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return true;
+}
+
+}  // namespace
+
+UnixSocket::UnixSocket(UnixSocket&& other) noexcept
+    : m_fd(std::exchange(other.m_fd, -1)), m_buffer(std::move(other.m_buffer)) {}
+
+UnixSocket& UnixSocket::operator=(UnixSocket&& other) noexcept {
+  if (this != &other) {
+    if (m_fd >= 0)
+      ::close(m_fd);
+    m_fd = std::exchange(other.m_fd, -1);
+    m_buffer = std::move(other.m_buffer);
+  }
+  return *this;
+}
+
+UnixSocket::~UnixSocket() {
+  if (m_fd >= 0)
+    ::close(m_fd);
+}
+
+UnixSocket UnixSocket::Listen(const std::filesystem::path& path) {
+  sockaddr_un addr;
+  if (!MakeAddress(path, addr))
+    return UnixSocket();
+
+  UnixSocket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+  // replace the stale socket file left by the last run
+  ::unlink(path.c_str());
+  if (!socket.valid() || ::bind(socket.m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+      ::listen(socket.m_fd, BACKLOG)) {
+    spdlog::error("failed to listen on {}: {}", path.native(), std::strerror(errno));
+    return UnixSocket();
+  }
+  return socket;
+}
+
+UnixSocket UnixSocket::Connect(const std::filesystem::path& path) {
+  sockaddr_un addr;
+  if (!MakeAddress(path, addr))
+    return UnixSocket();
+
+  UnixSocket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+  if (!socket.valid() ||
+      ::connect(socket.m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+    spdlog::error("failed to connect to {}: {}", path.native(), std::strerror(errno));
+    return UnixSocket();
+  }
+  return socket;
+}
+
+UnixSocket UnixSocket::Accept() {
+  int fd;
+  do {
+    fd = ::accept(m_fd, nullptr, nullptr);
+  } while (fd < 0 && errno == EINTR);
+  return UnixSocket(fd);
+}
+
+bool UnixSocket::ReadLine(std::string& line) {
+  size_t pos;
+  while ((pos = m_buffer.find('\n')) == std::string::npos) {
+    if (!Fill())
+      return false;
+  }
+  line = m_buffer.substr(0, pos);
+  m_buffer.erase(0, pos + 1);
+  return true;
+}
+
+bool UnixSocket::Read(size_t size, std::string& data) {
+  while (m_buffer.size() < size) {
+    if (!Fill())
+      return false;
+  }
+  data = m_buffer.substr(0, size);
+  m_buffer.erase(0, size);
+  return true;
+}
+
+bool UnixSocket::Write(std::string_view data) {
+  while (!data.empty()) {
+    // never raise SIGPIPE for a peer gone away
+    ssize_t n = ::send(m_fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data.remove_prefix(n);
+  }
+  return true;
+}
+
+void UnixSocket::Shutdown() noexcept {
+  if (m_fd >= 0)
+    ::shutdown(m_fd, SHUT_RDWR);
+}
+
+bool UnixSocket::Fill() {
+  char chunk[READ_SIZE];
+  ssize_t n;
+  do {
+    n = ::recv(m_fd, chunk, sizeof(chunk), 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return false;
+  m_buffer.append(chunk, n);
+  return true;
+}
+
+}  // namespace mcpt::misc
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace mcpt::misc {
+
+// stream socket in the Unix domain, closed on destruction
+class UnixSocket {
+public:
+  UnixSocket() = default;
+  explicit UnixSocket(int fd) : m_fd(fd) {}
+  UnixSocket(UnixSocket&& other) noexcept;
+  UnixSocket& operator=(UnixSocket&& other) noexcept;
+  ~UnixSocket();
+
+  // return an invalid socket on failure
+  static UnixSocket Listen(const std::filesystem::path& path);
+  static UnixSocket Connect(const std::filesystem::path& path);
+  UnixSocket Accept();
+
+  bool valid() const noexcept { return m_fd >= 0; }
+
+  // read a line without the trailing newline, return false at the end of the stream
+  bool ReadLine(std::string& line);
+  // read exactly `size' bytes
+  bool Read(size_t size, std::string& data);
+  bool Write(std::string_view data);
+
+  // wake up the threads blocked in reading or accepting on the socket
+  void Shutdown() noexcept;
+
+private:
+  // fill the buffer with at least one more byte
+  bool Fill();
+
+  int m_fd = -1;
+  std::string m_buffer;
+};
+
+}  // namespace mcpt::misc
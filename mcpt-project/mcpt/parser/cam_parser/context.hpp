@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+namespace mcpt::cam_parser {
+
+// a view of the scene
+struct Camera {
+  std::string name;
+
+  // image size, zero means the size given in the command line
+  unsigned int width = 0;
+  unsigned int height = 0;
+
+  // lens & horizontal CMOS size in mm, unless the pinhole intrinsics (fx, fy, cx, cy) are given
+  float focal_length = 28.0F;
+  float cmos_horizon = 36.0F;
+  std::optional<Eigen::Vector4f> intrin;
+
+  // the camera looks down -Z with +Y up unless it looks at some point, then the rotations (about
+  // the world axes) are applied in turn
+  Eigen::Vector3f position{Eigen::Vector3f::Zero()};
+  std::optional<Eigen::Vector3f> lookat;
+  Eigen::Vector3f up{Eigen::Vector3f::UnitY()};
+  Eigen::Matrix3f rotation{Eigen::Matrix3f::Identity()};
+};
+
+// render settings shared by all the cameras, the unset ones fall back to the command line
+struct Settings {
+  std::optional<unsigned int> spp;
+  std::optional<unsigned int> save_every_n;
+  std::optional<unsigned int> max_depth;
+  std::optional<unsigned int> rr_min_depth;
+  std::optional<double> rr_cont_prob;
+  std::optional<std::filesystem::path> output_path;
+};
+
+struct Context {
+  using AssociatedCamera = Camera*;
+
+  std::filesystem::path filepath;
+  size_t linenum = 0;
+
+  Settings settings;
+  std::vector<Camera> cameras;
+
+  AssociatedCamera associated_camera = nullptr;
+};
+
+}  // namespace mcpt::cam_parser
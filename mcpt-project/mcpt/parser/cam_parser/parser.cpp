@@ -0,0 +1,52 @@
+#include "mcpt/parser/cam_parser/parser.hpp"
+
+#include <cctype>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include "mcpt/common/misc.hpp"
+#include "mcpt/common/trace.hpp"
+#include "mcpt/parser/parse_helper.hpp"
+
+#include "mcpt/parser/cam_parser/tokenizer.hpp"
+
+namespace mcpt::cam_parser {
+
+Parser::Parser(const std::filesystem::path& filepath) {
+  TRACE_ZONE("parse cameras");
+  Context ctx{filepath};
+
+  std::ifstream ifs(filepath);
+  if (!ifs.is_open())
+    parse_helper::ThrowParseError("failed to open {}", filepath);
+
+  while (ifs && !ifs.eof())
+    Advance(SafelyGetLineString(ifs), ctx);
+
+  std::unordered_set<std::string> names;
+  for (const auto& camera : ctx.cameras) {
+    auto inserted = names.insert(camera.name).second;
+    if (!inserted)
+      parse_helper::ThrowParseError("duplicate camera name `{}' in {}", camera.name, filepath);
+  }
+  m_settings = std::move(ctx.settings);
+  m_cameras = std::move(ctx.cameras);
+}
+
+void Parser::Advance(const std::string& statement, Context& ctx) {
+  // advance one line anyway
+  ++ctx.linenum;
+  auto trim_start =
+      std::find_if(statement.cbegin(), statement.cend(), [](char ch) { return !std::isspace(ch); });
+  auto trimed = std::string_view(statement).substr(std::distance(statement.cbegin(), trim_start));
+
+  // do nothing if it is an empty line or comment
+  if (!trimed.empty() && trimed.front() != '#')
+    Tokenizer(ctx).Process(trimed);
+}
+
+}  // namespace mcpt::cam_parser
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mcpt/parser/cam_parser/context.hpp"
+
+namespace mcpt::cam_parser {
+
+// parse the cameras & render settings (.cam), one statement per line:
+//
+//   spp 64                 # render settings, before any camera
+//   save_every 16
+//   max_depth 8
+//   rr 0.95                # max continuation probability of Russian roulette
+//   rr_depth 3             # path vertices before Russian roulette starts
+//   output ./out
+//
+//   camera front           # start a camera, the name must be unique
+//   size 800 600
+//   lens 28 36             # or `intrin fx fy cx cy' in pixels
+//   position 0 5 15
+//   lookat 0 5 0
+//   up 0 1 0
+//   rotate 1 0 0 -25       # axis & angle in degrees
+class Parser {
+public:
+  explicit Parser(const std::filesystem::path& filepath);
+
+  auto& settings() const noexcept { return m_settings; }
+  auto& cameras() const noexcept { return m_cameras; }
+
+private:
+  void Advance(const std::string& statement, Context& ctx);
+
+  Settings m_settings;
+  std::vector<Camera> m_cameras;
+};
+
+}  // namespace mcpt::cam_parser
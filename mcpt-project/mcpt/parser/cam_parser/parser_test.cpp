@@ -0,0 +1,94 @@
+#include "mcpt/parser/cam_parser/parser.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcpt/parser/parse_helper.hpp"
+
+TEST_CASE("`.cam' parser parse cameras & render settings correctly", "[parser][cam_parser]") {
+
+static constexpr std::string_view MOCK_CAM_FILENAME = "mock.cam";
+static constexpr std::string_view MOCK_CAM_CONTENT = R"(# mock cameras
+spp 64
+max_depth 8   # trailing comment
+rr 0.75
+rr_depth 2
+output ./renders
+
+camera front
+size 320 240
+lens 35 36
+position 0 5 15
+
+camera top
+intrin 100 100 80 60
+position 0 20 0
+lookat 0 0 0
+up 0 0 -1
+
+camera tilted
+position 2 9 16
+rotate 1 0 0 -25
+)";
+
+auto mockfile = [](std::string_view filename, std::string_view filecontent) {
+  auto path = std::filesystem::temp_directory_path() / filename;
+  std::ofstream(path) << filecontent;
+  return path;
+};
+
+auto cam_path = mockfile(MOCK_CAM_FILENAME, MOCK_CAM_CONTENT);
+INFO("mock `.cam' file generated at " << cam_path);
+
+mcpt::cam_parser::Parser parser(cam_path);
+const auto& settings = parser.settings();
+const auto& cameras = parser.cameras();
+
+SECTION("render settings") {
+  CHECK(settings.spp == 64U);
+  CHECK(settings.max_depth == 8U);
+  CHECK(settings.rr_cont_prob == 0.75);
+  CHECK(settings.rr_min_depth == 2U);
+  CHECK(settings.output_path == std::filesystem::path("./renders"));
+  CHECK_FALSE(settings.save_every_n.has_value());
+}
+
+SECTION("cameras") {
+  REQUIRE(cameras.size() == 3);
+
+  CHECK(cameras[0].name == "front");
+  CHECK(cameras[0].width == 320);
+  CHECK(cameras[0].height == 240);
+  CHECK(cameras[0].focal_length == 35.0F);
+  CHECK(cameras[0].cmos_horizon == 36.0F);
+  CHECK_FALSE(cameras[0].intrin.has_value());
+  CHECK(cameras[0].position.isApprox(Eigen::Vector3f(0.0F, 5.0F, 15.0F)));
+  CHECK_FALSE(cameras[0].lookat.has_value());
+
+  CHECK(cameras[1].name == "top");
+  CHECK(cameras[1].width == 0);
+  REQUIRE(cameras[1].intrin.has_value());
+  CHECK(cameras[1].intrin->isApprox(Eigen::Vector4f(100.0F, 100.0F, 80.0F, 60.0F)));
+  REQUIRE(cameras[1].lookat.has_value());
+  CHECK(cameras[1].lookat->isZero());
+  CHECK(cameras[1].up.isApprox(-Eigen::Vector3f::UnitZ()));
+
+  CHECK(cameras[2].name == "tilted");
+  Eigen::Matrix3f rotation(Eigen::AngleAxisf(-25.0F / 180.0F * M_PI, Eigen::Vector3f::UnitX()));
+  CHECK(cameras[2].rotation.isApprox(rotation));
+}
+
+SECTION("malformed files") {
+  using mcpt::cam_parser::Parser;
+  CHECK_THROWS_AS(Parser(cam_path.parent_path() / "missing.cam"), mcpt::ParseError);
+  CHECK_THROWS_AS(Parser(mockfile("unknown.cam", "camera front\nzoom 2\n")), mcpt::ParseError);
+  CHECK_THROWS_AS(Parser(mockfile("duplicate.cam", "camera front\ncamera front\n")),
+                  mcpt::ParseError);
+}
+
+}
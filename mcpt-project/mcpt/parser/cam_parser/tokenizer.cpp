@@ -0,0 +1,125 @@
+#include "mcpt/parser/cam_parser/tokenizer.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <regex>
+#include <string>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/parser/parse_helper.hpp"
+
+namespace mcpt::cam_parser {
+
+namespace {
+
+const std::regex SPLIT_STATEMENT{R"(([\S^#]+)\s+([^#]+).*)"};
+const std::regex SPLIT_SPACE{R"(\s+)"};
+
+using parse_helper::as_number;
+
+}  // namespace
+
+void Tokenizer::Process(std::string_view statement) {
+  std::cmatch id_decl;
+  bool matched = std::regex_match(statement.cbegin(), statement.cend(), id_decl, SPLIT_STATEMENT);
+  ASSERT_PARSE(matched, "invalid statement `{}'", statement);
+
+  // the declaration may end with spaces before the comment
+  auto declaration = std::string_view(id_decl[2].first, id_decl[2].length());
+  while (!declaration.empty() && std::isspace(declaration.back()))
+    declaration.remove_suffix(1);
+  Proc(std::string_view(id_decl[1].first, id_decl[1].length()), declaration);
+}
+
+void Tokenizer::Proc(std::string_view identifier, std::string_view declaration) {
+  if (identifier == "camera") {
+    ASSERT_PARSE(declaration.find_first_of("/\\ \t") == std::string_view::npos,
+                 "invalid camera name `{}'",
+                 declaration);
+    ctx().cameras.push_back({std::string(declaration)});
+    ctx().associated_camera = &ctx().cameras.back();
+    return;
+  }
+  if (ProcSetting(identifier, declaration))
+    return;
+  ASSERT_PARSE(ctx().associated_camera, "must be associated to a camera name");
+
+  auto& camera = *ctx().associated_camera;
+  if (identifier == "size") {
+    unsigned int size[2];
+    ProcNumericVector<2>(declaration, size);
+    ASSERT_PARSE(size[0] > 0 && size[1] > 0, "`size' out of range");
+    camera.width = size[0];
+    camera.height = size[1];
+  } else if (identifier == "lens") {
+    float lens[2];
+    ProcNumericVector<2>(declaration, lens);
+    ASSERT_PARSE(lens[0] > 0.0F && lens[1] > 0.0F, "`lens' out of range");
+    camera.focal_length = lens[0];
+    camera.cmos_horizon = lens[1];
+  } else if (identifier == "intrin") {
+    Eigen::Vector4f intrin;
+    ProcNumericVector<4>(declaration, intrin.data());
+    ASSERT_PARSE(intrin.x() > 0.0F && intrin.y() > 0.0F, "`intrin' out of range");
+    camera.intrin = intrin;
+  } else if (identifier == "position") {
+    ProcNumericVector<3>(declaration, camera.position.data());
+  } else if (identifier == "lookat") {
+    Eigen::Vector3f lookat;
+    ProcNumericVector<3>(declaration, lookat.data());
+    camera.lookat = lookat;
+  } else if (identifier == "up") {
+    ProcNumericVector<3>(declaration, camera.up.data());
+    ASSERT_PARSE(camera.up.norm() > 0.0F, "`up' must not be zero");
+  } else if (identifier == "rotate") {
+    Eigen::Vector4f axis_angle;
+    ProcNumericVector<4>(declaration, axis_angle.data());
+    Eigen::Vector3f axis = axis_angle.head<3>();
+    ASSERT_PARSE(axis.norm() > 0.0F, "rotation axis must not be zero");
+    float angle = axis_angle.w() / 180.0F * M_PI;
+    camera.rotation = Eigen::AngleAxisf(angle, axis.normalized()) * camera.rotation;
+  } else {
+    ASSERT_PARSE_FAIL("unknown identifier `{}'", identifier);
+  }
+}
+
+bool Tokenizer::ProcSetting(std::string_view identifier, std::string_view declaration) {
+  auto& settings = ctx().settings;
+  if (identifier == "spp") {
+    ProcNumber(declaration, settings.spp.emplace());
+    ASSERT_PARSE(settings.spp > 0U, "`spp' out of range");
+  } else if (identifier == "save_every") {
+    ProcNumber(declaration, settings.save_every_n.emplace());
+  } else if (identifier == "max_depth") {
+    ProcNumber(declaration, settings.max_depth.emplace());
+  } else if (identifier == "rr_depth") {
+    ProcNumber(declaration, settings.rr_min_depth.emplace());
+  } else if (identifier == "rr") {
+    ProcNumber(declaration, settings.rr_cont_prob.emplace());
+    ASSERT_PARSE(settings.rr_cont_prob > 0.0 && settings.rr_cont_prob <= 1.0, "`rr' out of range");
+  } else if (identifier == "output") {
+    settings.output_path = std::string(declaration);
+  } else {
+    return false;
+  }
+  ASSERT_PARSE(!ctx().associated_camera, "`{}' must precede all the cameras", identifier);
+  return true;
+}
+
+template <typename T>
+void Tokenizer::ProcNumber(std::string_view token, T& number) {
+  ASSERT_PARSE(as_number(token, number), "invalid token `{}'", token);
+}
+
+template <size_t Size, typename T>
+void Tokenizer::ProcNumericVector(std::string_view tokens, T* vector) {
+  std::cregex_token_iterator token_first(tokens.cbegin(), tokens.cend(), SPLIT_SPACE, -1);
+  std::cregex_token_iterator token_last;
+  ASSERT_PARSE(std::distance(token_first, token_last) == Size, "must provide {} tokens", Size);
+
+  for (size_t i = 0; i < Size; ++i, ++token_first)
+    ASSERT_PARSE(as_number(*token_first, vector[i]), "invalid token `{}'", token_first->str());
+}
+
+}  // namespace mcpt::cam_parser
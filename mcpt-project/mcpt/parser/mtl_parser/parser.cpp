@@ -7,25 +7,29 @@
 #include <string_view>
 #include <utility>
 
-#include "mcpt/common/assert.hpp"
 #include "mcpt/common/misc.hpp"
+#include "mcpt/common/trace.hpp"
+#include "mcpt/parser/parse_helper.hpp"
 
 #include "mcpt/parser/mtl_parser/tokenizer.hpp"
 
 namespace mcpt::mtl_parser {
 
 Parser::Parser(const std::filesystem::path& filepath) {
+  TRACE_ZONE("parse MTL");
   Context ctx{filepath};
 
   std::ifstream ifs(filepath);
-  ASSERT(ifs.is_open(), "failed to open {}", filepath);
+  if (!ifs.is_open())
+    parse_helper::ThrowParseError("failed to open {}", filepath);
 
   while (ifs && !ifs.eof())
     Advance(SafelyGetLineString(ifs), ctx);
 
   for (auto& [mtl_name, mtl] : ctx.materials) {
     auto inserted = m_materials.emplace(std::move(mtl_name), std::move(mtl)).second;
-    ASSERT(inserted, "duplicate material name `{}' in {}", mtl_name, filepath);
+    if (!inserted)
+      parse_helper::ThrowParseError("duplicate material name `{}' in {}", mtl_name, filepath);
   }
 }
 
@@ -1,16 +1,9 @@
 #include "mcpt/parser/mtl_parser/tokenizer.hpp"
 
-#include <cstdlib>
-#include <charconv>
 #include <regex>
 #include <string>
 
-#include "mcpt/common/assert.hpp"
-
-#define ASSERT_PARSE(assertion, msg_tpl, ...) \
-  ASSERT(assertion, "fail to parse {} ({}): " msg_tpl, ctx().filepath, ctx().linenum, ##__VA_ARGS__)
-#define ASSERT_PARSE_FAIL(msg_tpl, ...) \
-  ASSERT_FAIL("fail to parse {} ({}): " msg_tpl, ctx().filepath, ctx().linenum, ##__VA_ARGS__)
+#include "mcpt/parser/parse_helper.hpp"
 
 namespace mcpt::mtl_parser {
 
@@ -19,53 +12,7 @@ namespace {
 const std::regex SPLIT_STATEMENT{R"(([\S^#]+)\s+([^#]+).*)"};
 const std::regex SPLIT_SPACE{R"(\s+)"};
 
-template <typename T>
-bool as_number(const std::sub_match<const char*>& match, T& number) {
-  auto ret = std::from_chars(match.first, match.second, number);
-  return ret.ec == std::errc{};
-}
-
-template <typename T>
-bool as_number(const std::string_view& token, T& number) {
-  auto ret = std::from_chars(token.cbegin(), token.cend(), number);
-  return ret.ec == std::errc{};
-}
-
-#ifdef __clang__
-
-template <>
-bool as_number<float>(const std::sub_match<const char*>& match, float& number) {
-  number = std::strtof(match.first, nullptr);
-  return true;
-}
-template <>
-bool as_number<double>(const std::sub_match<const char*>& match, double& number) {
-  number = std::strtod(match.first, nullptr);
-  return true;
-}
-template <>
-bool as_number<long double>(const std::sub_match<const char*>& match, long double& number) {
-  number = std::strtold(match.first, nullptr);
-  return true;
-}
-
-template <>
-bool as_number<float>(const std::string_view& token, float& number) {
-  number = std::strtof(token.cbegin(), nullptr);
-  return true;
-}
-template <>
-bool as_number<double>(const std::string_view& token, double& number) {
-  number = std::strtod(token.cbegin(), nullptr);
-  return true;
-}
-template <>
-bool as_number<long double>(const std::string_view& token, long double& number) {
-  number = std::strtold(token.cbegin(), nullptr);
-  return true;
-}
-
-#endif
+using parse_helper::as_number;
 
 }  // namespace
 
@@ -14,6 +14,7 @@ namespace mcpt::obj_parser {
 
 struct Context {
   using AssociatedGroup = MeshIndexGroup*;
+  using AssociatedPrototype = std::unordered_map<std::string, MeshIndexGroup>*;
 
   std::filesystem::path filepath;
   size_t linenum = 0;
@@ -26,7 +27,12 @@ struct Context {
 
   std::unordered_map<std::string, MeshIndexGroup> mesh_groups;
 
+  // mesh groups of the prototypes are only rendered through the instances
+  std::unordered_map<std::string, std::unordered_map<std::string, MeshIndexGroup>> prototypes;
+  std::vector<MeshInstance> instances;
+
   AssociatedGroup associated_group = nullptr;
+  AssociatedPrototype associated_prototype = nullptr;
 };
 
 }  // namespace mcpt::obj_parser
@@ -3,7 +3,8 @@
 #include <fstream>
 #include <utility>
 
-#include "mcpt/common/assert.hpp"
+#include "mcpt/common/trace.hpp"
+#include "mcpt/parser/parse_helper.hpp"
 
 #include "mcpt/parser/obj_parser/context.hpp"
 #include "mcpt/parser/obj_parser/line_parser.hpp"
@@ -11,11 +12,13 @@
 namespace mcpt::obj_parser {
 
 Parser::Parser(const std::filesystem::path& filepath) {
+  TRACE_ZONE("parse OBJ");
   Context ctx{filepath};
   LineParser parser(ctx);
 
   std::ifstream ifs(filepath);
-  ASSERT(ifs.is_open(), "failed to open {}", filepath);
+  if (!ifs.is_open())
+    parse_helper::ThrowParseError("failed to open {}", filepath);
 
   while (ifs && !ifs.eof())
     parser.Advance(ifs);
@@ -23,6 +26,12 @@ Parser::Parser(const std::filesystem::path& filepath) {
   m_object.materials() = std::move(ctx.materials);
   for (auto& named_mesh_group : ctx.mesh_groups)
     m_object.mesh_groups().push_back(std::move(named_mesh_group.second));
+  for (auto& [prototype_name, prototype_groups] : ctx.prototypes) {
+    auto& mesh_groups = m_object.prototypes()[prototype_name];
+    for (auto& named_mesh_group : prototype_groups)
+      mesh_groups.push_back(std::move(named_mesh_group.second));
+  }
+  m_object.instances() = std::move(ctx.instances);
   m_object.vertices() = std::move(ctx.default_vertices);
   m_object.text_coords() = std::move(ctx.default_text_coords);
   m_object.normals() = std::move(ctx.default_normals);
@@ -5,6 +5,7 @@ using Context = mcpt::obj_parser::Context;
 using Material = mcpt::Material;
 using MeshIndex = mcpt::MeshIndex;
 using MeshIndexGroup = mcpt::MeshIndexGroup;
+using MeshInstance = mcpt::MeshInstance;
 
 auto fmt::formatter<Material>::parse(format_parse_context& ctx) -> decltype(ctx.begin()) {
   // check if reached the end of the range
@@ -36,7 +37,21 @@ auto fmt::formatter<MeshIndexGroup>::parse(format_parse_context& ctx) -> decltyp
   return it;
 }
 
+auto fmt::formatter<MeshInstance>::parse(format_parse_context& ctx) -> decltype(ctx.begin()) {
+  // check if reached the end of the range
+  auto it = ctx.begin();
+  auto end = ctx.end();
+  if (it != end && *it != '}')
+    throw format_error("invalid format");
+  // return an iterator past the end of the parsed range
+  return it;
+}
+
 std::string Catch::StringMaker<Context>::convert(const Context& ctx) {
+  std::vector<std::string> prototypes;
+  for (const auto& [name, mesh_groups] : ctx.prototypes)
+    prototypes.push_back(fmt::format("'{}':{{{}}}", name, fmt::join(mesh_groups, ", ")));
+
   return fmt::format(
       "{{\n"
       "  filepath: {}\n"
@@ -46,7 +61,10 @@ std::string Catch::StringMaker<Context>::convert(const Context& ctx) {
       "  default_text_coords: [{}]\n"
       "  default_normals: [{}]\n"
       "  mesh_groups: {{{}}}\n"
+      "  prototypes: {{{}}}\n"
+      "  instances: [{}]\n"
       "  associated_group: {}\n"
+      "  associated_prototype: {}\n"
       "}}\n",
       ctx.filepath,
       ctx.linenum,
@@ -55,7 +73,10 @@ std::string Catch::StringMaker<Context>::convert(const Context& ctx) {
       ctx.default_text_coords,
       ctx.default_normals,
       fmt::join(ctx.mesh_groups, ", "),
-      fmt::ptr(ctx.associated_group));
+      fmt::join(prototypes, ", "),
+      fmt::join(ctx.instances, ", "),
+      fmt::ptr(ctx.associated_group),
+      fmt::ptr(ctx.associated_prototype));
 }
 
 bool Equals::match(const Context& lhs) const {
@@ -66,8 +87,12 @@ bool Equals::match(const Context& lhs) const {
          lhs.default_text_coords == rhs.get().default_text_coords &&
          lhs.default_normals == rhs.get().default_normals &&
          lhs.mesh_groups == rhs.get().mesh_groups &&
+         lhs.prototypes == rhs.get().prototypes &&
+         lhs.instances == rhs.get().instances &&
          ( (lhs.associated_group == nullptr && rhs.get().associated_group == nullptr) ||
-           *lhs.associated_group == *rhs.get().associated_group );
+           *lhs.associated_group == *rhs.get().associated_group ) &&
+         ( (lhs.associated_prototype == nullptr && rhs.get().associated_prototype == nullptr) ||
+           *lhs.associated_prototype == *rhs.get().associated_prototype );
 }
 
 std::string Equals::describe() const {
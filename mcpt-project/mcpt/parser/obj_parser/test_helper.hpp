@@ -108,6 +108,22 @@ struct fmt::formatter<mcpt::MeshIndexGroup> {
   }
 };
 
+template <>
+struct fmt::formatter<mcpt::MeshInstance> {
+  using Type = mcpt::MeshInstance;
+
+  inline static const Eigen::IOFormat FORMAT{
+      Eigen::StreamPrecision, Eigen::DontAlignCols, ",", ";", "", "", "(", ")"};
+
+  auto parse(format_parse_context& ctx) -> decltype(ctx.begin());
+
+  template <typename FormatContext>
+  auto format(const Type& v, FormatContext& ctx) const -> decltype(ctx.out()) {
+    return fmt::format_to(
+        ctx.out(), "{{prototype='{}', transform={}}}", v.prototype, v.transform.format(FORMAT));
+  }
+};
+
 template <>
 struct Catch::StringMaker<mcpt::obj_parser::Context> {
   static std::string convert(const mcpt::obj_parser::Context& ctx);
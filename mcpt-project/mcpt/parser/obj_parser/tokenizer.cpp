@@ -1,16 +1,10 @@
 #include "mcpt/parser/obj_parser/tokenizer.hpp"
 
-#include <charconv>
 #include <regex>
 #include <string>
 
-#include "mcpt/common/assert.hpp"
 #include "mcpt/parser/mtl_parser/parser.hpp"
-
-#define ASSERT_PARSE(assertion, msg_tpl, ...) \
-  ASSERT(assertion, "fail to parse {} ({}): " msg_tpl, ctx().filepath, ctx().linenum, ##__VA_ARGS__)
-#define ASSERT_PARSE_FAIL(msg_tpl, ...) \
-  ASSERT_FAIL("fail to parse {} ({}): " msg_tpl, ctx().filepath, ctx().linenum, ##__VA_ARGS__)
+#include "mcpt/parser/parse_helper.hpp"
 
 namespace mcpt::obj_parser {
 
@@ -19,32 +13,10 @@ namespace {
 const std::regex SPLIT_STATEMENT{R"(([\S^#]+)\s+([^#]+).*)"};
 const std::regex SPLIT_SPACE{R"(\s+)"};
 const std::regex SPLIT_SLASH{R"((\d+)/(\d+)/(\d+))"};
+const std::regex NAME{R"((\S+)\s*)"};
+const std::regex SPLIT_INSTANCE{R"((\S+)\s+(.*\S)\s*)"};
 
-template <typename T>
-bool as_number(const std::sub_match<const char*>& match, T& number) {
-  auto ret = std::from_chars(match.first, match.second, number);
-  return ret.ec == std::errc{};
-}
-
-#ifdef __clang__
-
-template <>
-bool as_number<float>(const std::sub_match<const char*>& match, float& number) {
-  number = std::strtof(match.first, nullptr);
-  return true;
-}
-template <>
-bool as_number<double>(const std::sub_match<const char*>& match, double& number) {
-  number = std::strtod(match.first, nullptr);
-  return true;
-}
-template <>
-bool as_number<long double>(const std::sub_match<const char*>& match, long double& number) {
-  number = std::strtold(match.first, nullptr);
-  return true;
-}
-
-#endif
+using parse_helper::as_number;
 
 }  // namespace
 
@@ -84,6 +56,12 @@ void Tokenizer::Proc(std::string_view identifier, std::string_view declaration)
   } else if (identifier == "usemtl") {
     // declaration: material name
     ProcMaterialDecl(declaration);
+  } else if (identifier == "proto") {
+    // declaration: prototype name
+    ProcPrototypeName(declaration);
+  } else if (identifier == "inst") {
+    // declaration: prototype name & row-major 3x4 affine transform
+    ProcInstance(declaration);
   } else {
     ASSERT_PARSE_FAIL("unknown identifier `{}'", identifier);
   }
@@ -100,6 +78,7 @@ void Tokenizer::ProcMTLFilename(std::string_view mtl_filename) {
 
 void Tokenizer::ProcGroupName(std::string_view group_name) {
   ctx().associated_group = nullptr;
+  ctx().associated_prototype = nullptr;
 }
 
 template <size_t Size, typename T>
@@ -142,10 +121,33 @@ void Tokenizer::ProcMeshIndex(std::string_view tokens) {
 }
 
 void Tokenizer::ProcMaterialDecl(std::string_view material_name) {
-  ctx().associated_group = &ctx().mesh_groups[std::string(material_name)];
+  auto& mesh_groups = ctx().associated_prototype ? *ctx().associated_prototype : ctx().mesh_groups;
+  ctx().associated_group = &mesh_groups[std::string(material_name)];
   ctx().associated_group->material = material_name;
 }
 
+void Tokenizer::ProcPrototypeName(std::string_view prototype_name) {
+  std::cmatch matches;
+  bool matched = std::regex_match(prototype_name.cbegin(), prototype_name.cend(), matches, NAME);
+  ASSERT_PARSE(matched, "invalid prototype name `{}'", prototype_name);
+  ctx().associated_group = nullptr;
+  ctx().associated_prototype = &ctx().prototypes[matches[1].str()];
+}
+
+void Tokenizer::ProcInstance(std::string_view tokens) {
+  std::cmatch matches;
+  bool matched = std::regex_match(tokens.cbegin(), tokens.cend(), matches, SPLIT_INSTANCE);
+  ASSERT_PARSE(matched, "instance must be in the form of `prototype transform'");
+
+  auto prototype = matches[1].str();
+  ASSERT_PARSE(ctx().prototypes.count(prototype), "prototype `{}' is not declared", prototype);
+
+  Eigen::Matrix<float, 4, 3> transform_t;
+  auto transform = std::string_view(matches[2].first, matches[2].length());
+  ProcNumericVector<12>(transform, transform_t.data());
+  ctx().instances.push_back({std::move(prototype), transform_t.transpose()});
+}
+
 }  // namespace mcpt::obj_parser
 
 #undef ASSERT_PARSE
@@ -24,6 +24,8 @@ private:
 
   void ProcMeshIndex(std::string_view tokens);
   void ProcMaterialDecl(std::string_view material_name);
+  void ProcPrototypeName(std::string_view prototype_name);
+  void ProcInstance(std::string_view tokens);
 
 private:
   auto& ctx() noexcept { return m_ctx.get(); }
@@ -22,7 +22,10 @@ SECTION("default context") {
   CHECK(ctx.default_text_coords.empty());
   CHECK(ctx.default_normals.empty());
   CHECK(ctx.mesh_groups.empty());
+  CHECK(ctx.prototypes.empty());
+  CHECK(ctx.instances.empty());
   CHECK(ctx.associated_group == nullptr);
+  CHECK(ctx.associated_prototype == nullptr);
 }
 
 auto mock_ctx = ctx;
@@ -82,4 +85,37 @@ SECTION("parse `s 1'") {
   }
 }
 
+SECTION("parse `proto chair'") {
+  tokenizer.Process("proto chair");
+  mock_ctx.associated_prototype = &mock_ctx.prototypes["chair"];
+  REQUIRE_THAT(ctx, Equals(mock_ctx));
+
+  SECTION("parse one prototype group") {
+    INFO("parse `usemtl material'");
+    tokenizer.Process("usemtl material");
+    INFO("parse `f 1/1/1 2/1/1 3/1/1'");
+    tokenizer.Process("f 1/1/1 2/1/1 3/1/1");
+
+    mock_ctx.associated_group = &(*mock_ctx.associated_prototype)["material"];
+    mock_ctx.associated_group->material = "material";
+    mock_ctx.associated_group->mesh_index.push_back({{0, 1, 2}, {0, 0, 0}, {0, 0, 0}});
+
+    REQUIRE_THAT(ctx, Equals(mock_ctx));
+    CHECK(ctx.mesh_groups.empty());
+
+    SECTION("parse `g default' `inst chair 1 0 0 1 0 1 0 2 0 0 1 3'") {
+      tokenizer.Process("g default");
+      tokenizer.Process("inst chair 1 0 0 1 0 1 0 2 0 0 1 3");
+
+      Eigen::Matrix<float, 3, 4> transform;
+      transform << 1, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 3;
+      mock_ctx.associated_group = nullptr;
+      mock_ctx.associated_prototype = nullptr;
+      mock_ctx.instances.push_back({"chair", transform});
+
+      REQUIRE_THAT(ctx, Equals(mock_ctx));
+    }
+  }
+}
+
 }
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdlib>
+#include <charconv>
+#include <regex>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ostr.h>
+
+// the tokenizers report the failures with the position in the file, `ctx()' must hold its
+// `filepath' & `linenum'
+#define ASSERT_PARSE(assertion, msg_tpl, ...) \
+  (static_cast<bool>(assertion) ? void(0) : ASSERT_PARSE_FAIL(msg_tpl, ##__VA_ARGS__))
+#define ASSERT_PARSE_FAIL(msg_tpl, ...) \
+  mcpt::parse_helper::ThrowParseError(  \
+      "fail to parse {} ({}): " msg_tpl, ctx().filepath, ctx().linenum, ##__VA_ARGS__)
+
+namespace mcpt {
+
+// thrown by the parsers on the files that are missing or malformed, so that long-running callers
+// can survive a bad input
+class ParseError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+}  // namespace mcpt
+
+namespace mcpt::parse_helper {
+
+template <typename... Args>
+[[noreturn]] void ThrowParseError(const Args&... args) {
+  throw ParseError(fmt::format(args...));
+}
+
+template <typename T>
+bool as_number(const std::sub_match<const char*>& match, T& number) {
+  auto ret = std::from_chars(match.first, match.second, number);
+  return ret.ec == std::errc{};
+}
+
+template <typename T>
+bool as_number(const std::string_view& token, T& number) {
+  auto ret = std::from_chars(token.cbegin(), token.cend(), number);
+  return ret.ec == std::errc{};
+}
+
+#ifdef __clang__
+
+template <>
+inline bool as_number<float>(const std::sub_match<const char*>& match, float& number) {
+  number = std::strtof(match.first, nullptr);
+  return true;
+}
+template <>
+inline bool as_number<double>(const std::sub_match<const char*>& match, double& number) {
+  number = std::strtod(match.first, nullptr);
+  return true;
+}
+template <>
+inline bool as_number<long double>(const std::sub_match<const char*>& match, long double& number) {
+  number = std::strtold(match.first, nullptr);
+  return true;
+}
+
+template <>
+inline bool as_number<float>(const std::string_view& token, float& number) {
+  number = std::strtof(token.cbegin(), nullptr);
+  return true;
+}
+template <>
+inline bool as_number<double>(const std::string_view& token, double& number) {
+  number = std::strtod(token.cbegin(), nullptr);
+  return true;
+}
+template <>
+inline bool as_number<long double>(const std::string_view& token, long double& number) {
+  number = std::strtold(token.cbegin(), nullptr);
+  return true;
+}
+
+#endif
+
+}  // namespace mcpt::parse_helper
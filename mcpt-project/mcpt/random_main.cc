@@ -32,9 +32,9 @@ std::vector<Line<float>> SampleLines(const Eigen::Vector3f& center,
   std::vector<Line<float>> lines;
   while (num--) {
     auto sa = gen.Random(alpha);
-    Eigen::Vector3f dir(std::sin(sa.depression) * std::cos(sa.azimuth),
-                        std::sin(sa.depression) * std::sin(sa.azimuth),
-                        std::cos(sa.depression));
+    Eigen::Vector3f dir(sa.sin_depression * sa.cos_azimuth,
+                        sa.sin_depression * sa.sin_azimuth,
+                        sa.cos_depression);
     lines.emplace_back(center, axes * (dir * 10.0F) + center);
   }
   return lines;
@@ -1,23 +1,151 @@
 #include "mcpt/renderer/bxdf.hpp"
 
 #include <cmath>
+#include <algorithm>
+
+#include "mcpt/common/fast_math.hpp"
+#include "mcpt/common/random.hpp"
 
 namespace mcpt {
 
-Eigen::Vector3f BlinnPhongBxDF::Shade(const Material& p_mtl,
-                                      const Eigen::Vector3f& n,
-                                      const Eigen::Vector3f& wi,
-                                      const Eigen::Vector3f& wo) const {
-  if (Material::Type(p_mtl) == Material::TR)
-    return Eigen::Vector3f::Constant(p_mtl.Tr);
+void ShadingBatch::clear() noexcept {
+  material.clear();
+  type.clear();
+  normal.clear();
+  wi.clear();
+  wo.clear();
+}
+
+void ShadingBatch::push_back(const Material& mtl,
+                             Material::TypeEnum t,
+                             const Eigen::Vector3f& n,
+                             const Eigen::Vector3f& in,
+                             const Eigen::Vector3f& out) {
+  material.push_back(&mtl);
+  type.push_back(t);
+  normal.push_back(n);
+  wi.push_back(in);
+  wo.push_back(out);
+}
+
+void BlinnPhongBxDF::Shade(ShadingBatch& batch) const {
+  size_t n = batch.size();
+  batch.fr.resize(n);
+  batch.cos.resize(n);
+  batch.exponent.resize(n);
+
+  for (size_t i = 0; i < n; ++i) {
+    Eigen::Vector3f halfway = (batch.wi[i] + batch.wo[i]).normalized();
+    batch.cos[i] = std::max(0.0F, batch.normal[i].dot(halfway));
+    batch.exponent[i] = batch.material[i]->Ns;
+  }
+  math::Pow(batch.cos.data(), batch.exponent.data(), batch.cos.data(), n);
+
+  for (size_t i = 0; i < n; ++i) {
+    const Material& mtl = *batch.material[i];
+    if (batch.type[i] == Material::TR)
+      batch.fr[i] = Eigen::Vector3f::Constant(mtl.Tr);
+    else
+      batch.fr[i] = mtl.Kd / M_PI + mtl.Ks * batch.cos[i];
+  }
+}
+
+BxDFSample BlinnPhongBxDF::Sample(const Material& p_mtl,
+                                  const Eigen::Vector3f& n,
+                                  const Eigen::Vector3f& /* wo */) const {
+  auto sa = CosPowHemisphere<float>().Random(p_mtl.Ns + 1.0F);
+  Eigen::Vector3f dir(sa.sin_depression * sa.cos_azimuth,
+                      sa.sin_depression * sa.sin_azimuth,
+                      sa.cos_depression);
+  return {NormalFrame(n) * dir, sa.pdf};
+}
+
+double BlinnPhongBxDF::Pdf(const Material& p_mtl,
+                           const Eigen::Vector3f& n,
+                           const Eigen::Vector3f& wi,
+                           const Eigen::Vector3f& /* wo */) const {
+  // (a+1)cos^a/(2pi) of the power a = Ns+1
+  double cos = n.dot(wi);
+  return cos > 0.0 ? (p_mtl.Ns + 2.0) * std::pow(cos, p_mtl.Ns + 1.0) / (2.0 * M_PI) : 0.0;
+}
+
+void GGXBxDF::Shade(ShadingBatch& batch) const {
+  size_t n = batch.size();
+  batch.fr.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    batch.fr[i] =
+        Shade(*batch.material[i], batch.type[i], batch.normal[i], batch.wi[i], batch.wo[i]);
+}
+
+BxDFSample GGXBxDF::Sample(const Material& p_mtl,
+                           const Eigen::Vector3f& n,
+                           const Eigen::Vector3f& wo) const {
+  Lobes lobes = Map(p_mtl);
+  Eigen::Matrix3f frame = NormalFrame(n);
+  Eigen::Vector3f wo_n = frame.transpose() * wo;
+
+  Uniform<float> uniform;
+  float u0 = uniform.Random();
+  float u1 = uniform.Random();
+  float u2 = uniform.Random();
+
+  Eigen::Vector3f wi_n;
+  if (wo_n.z() > 0.0F && u0 < lobes.p_specular) {
+    // the visible normals, stretched to the hemisphere of alpha = 1
+    Eigen::Vector3f v =
+        Eigen::Vector3f(lobes.alpha * wo_n.x(), lobes.alpha * wo_n.y(), wo_n.z()).normalized();
+    float len2 = v.x() * v.x() + v.y() * v.y();
+    Eigen::Vector3f t1 = Eigen::Vector3f::UnitX();
+    if (len2 > 0.0F)
+      t1 = Eigen::Vector3f(-v.y(), v.x(), 0.0F) / std::sqrt(len2);
+    Eigen::Vector3f t2 = v.cross(t1);
+
+    // a point on the disk projected from the visible half of the hemisphere
+    float r = std::sqrt(u1);
+    float phi = 2.0F * float(M_PI) * u2;
+    float p1 = r * std::cos(phi);
+    float p2 = r * std::sin(phi);
+    float s = 0.5F * (1.0F + v.z());
+    p2 = (1.0F - s) * std::sqrt(1.0F - p1 * p1) + s * p2;
+    float p3 = std::sqrt(std::max(0.0F, 1.0F - p1 * p1 - p2 * p2));
+    Eigen::Vector3f h = p1 * t1 + p2 * t2 + p3 * v;
+
+    // unstretch the normal & reflect on it
+    h = Eigen::Vector3f(lobes.alpha * h.x(), lobes.alpha * h.y(), std::max(0.0F, h.z()))
+            .normalized();
+    wi_n = 2.0F * wo_n.dot(h) * h - wo_n;
+  } else {
+    float r = std::sqrt(u1);
+    float phi = 2.0F * float(M_PI) * u2;
+    wi_n = Eigen::Vector3f(r * std::cos(phi), r * std::sin(phi), std::sqrt(1.0F - u1));
+  }
+  return {frame * wi_n, Pdf(lobes, wi_n, wo_n)};
+}
+
+double GGXBxDF::Pdf(const Material& p_mtl,
+                    const Eigen::Vector3f& n,
+                    const Eigen::Vector3f& wi,
+                    const Eigen::Vector3f& wo) const {
+  Eigen::Matrix3f frame_t = NormalFrame(n).transpose();
+  return Pdf(Map(p_mtl), frame_t * wi, frame_t * wo);
+}
 
-  Eigen::Vector3f halfway = (wi + wo).normalized();
-  float cos_h = std::max(0.0F, n.dot(halfway));
-  float pow_cos_h = std::pow(cos_h, p_mtl.Ns);
+double GGXBxDF::Pdf(const Lobes& lobes, const Eigen::Vector3f& wi, const Eigen::Vector3f& wo) {
+  // the specular lobe is not sampled from below the surface
+  float p_specular = wo.z() > 0.0F ? lobes.p_specular : 0.0F;
+  double pdf = (1.0 - p_specular) * std::max(0.0F, wi.z()) / M_PI;
 
-  Eigen::Vector3f diffusion = p_mtl.Kd / M_PI;
-  Eigen::Vector3f specular = p_mtl.Ks * pow_cos_h;
-  return diffusion + specular;
+  Eigen::Vector3f halfway = wi + wo;
+  if (p_specular > 0.0F && halfway.squaredNorm() > 0.0F) {
+    // the PDF of the visible normals is G1(wo) * max(0, wo.h) * D(h) / wo.z, reflected by the
+    // Jacobian 1 / (4 * wo.h)
+    halfway.normalize();
+    float alpha2 = lobes.alpha * lobes.alpha;
+    float g1 = 1.0F / (1.0F + Lambda(wo.z(), alpha2));
+    if (wo.dot(halfway) > 0.0F)
+      pdf += p_specular * g1 * D(halfway.z(), alpha2) / (4.0F * wo.z());
+  }
+  return pdf;
 }
 
 }  // namespace mcpt
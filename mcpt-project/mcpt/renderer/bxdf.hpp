@@ -1,27 +1,224 @@
 #pragma once
 
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <variant>
+#include <vector>
+
 #include <Eigen/Eigen>
 
 #include "mcpt/common/object/material.hpp"
 
 namespace mcpt {
 
-class BxDF {
+// exit direction sampled at a diffusive surface, with its solid angle PDF
+struct BxDFSample {
+  Eigen::Vector3f direction;
+  double pdf;
+};
+
+// orthonormal frame of a surface, with the normal as the z axis
+inline Eigen::Matrix3f NormalFrame(const Eigen::Vector3f& normal) {
+  Eigen::Index x;
+  normal.cwiseAbs().minCoeff(&x);
+
+  Eigen::Matrix3f axes;
+  axes.col(2) = normal;
+  axes.col(1) = axes.col(2).cross(Eigen::Vector3f::Unit(x)).normalized();
+  axes.col(0) = axes.col(1).cross(axes.col(2)).normalized();
+  return axes;
+}
+
+// the inputs & the outputs of the BxDF evaluations at a batch of hit points, in SoA
+struct ShadingBatch {
+  std::vector<const Material*> material;
+  std::vector<Material::TypeEnum> type;  // of the material
+  std::vector<Eigen::Vector3f> normal;
+  std::vector<Eigen::Vector3f> wi;
+  std::vector<Eigen::Vector3f> wo;
+
+  // the BxDF values, written by the evaluation
+  std::vector<Eigen::Vector3f> fr;
+  // scratch of the evaluation
+  std::vector<float> cos;
+  std::vector<float> exponent;
+
+  size_t size() const noexcept { return material.size(); }
+  void clear() noexcept;
+  void push_back(const Material& mtl,
+                 Material::TypeEnum t,
+                 const Eigen::Vector3f& n,
+                 const Eigen::Vector3f& in,
+                 const Eigen::Vector3f& out);
+};
+
+class BlinnPhongBxDF {
 public:
-  virtual ~BxDF() noexcept = default;
-  virtual Eigen::Vector3f Shade(const Material& p_mtl,
-                                const Eigen::Vector3f& n,
-                                const Eigen::Vector3f& wi,
-                                const Eigen::Vector3f& wo) const = 0;
+  Eigen::Vector3f Shade(const Material& p_mtl,
+                        const Eigen::Vector3f& n,
+                        const Eigen::Vector3f& wi,
+                        const Eigen::Vector3f& wo) const {
+    return Shade(p_mtl, Material::Type(p_mtl), n, wi, wo);
+  }
+
+  // same as above with the type of the material known
+  Eigen::Vector3f Shade(const Material& p_mtl,
+                        Material::TypeEnum type,
+                        const Eigen::Vector3f& n,
+                        const Eigen::Vector3f& wi,
+                        const Eigen::Vector3f& wo) const {
+    if (type == Material::TR)
+      return Eigen::Vector3f::Constant(p_mtl.Tr);
+
+    Eigen::Vector3f halfway = (wi + wo).normalized();
+    float cos_h = std::max(0.0F, n.dot(halfway));
+    float pow_cos_h = std::pow(cos_h, p_mtl.Ns);
+
+    Eigen::Vector3f diffusion = p_mtl.Kd / M_PI;
+    Eigen::Vector3f specular = p_mtl.Ks * pow_cos_h;
+    return diffusion + specular;
+  }
+
+  // evaluate all the BxDFs of a batch into batch.fr, the powers are taken in one pass by math::Pow
+  void Shade(ShadingBatch& batch) const;
+
+  // whether the BxDF is the constant Kd / pi for a diffusive material
+  bool IsLambertian(const Material& p_mtl, Material::TypeEnum type) const {
+    return type == Material::DIFF && (p_mtl.Ks.array() == 0.0F).all();
+  }
+
+  // sample the exit direction of a diffusive surface from the cosine power lobe of the power Ns+1
+  // around the normal
+  BxDFSample Sample(const Material& p_mtl,
+                    const Eigen::Vector3f& n,
+                    const Eigen::Vector3f& wo) const;
+
+  // the PDF of Sample
+  double Pdf(const Material& p_mtl,
+             const Eigen::Vector3f& n,
+             const Eigen::Vector3f& wi,
+             const Eigen::Vector3f& wo) const;
 };
 
-class BlinnPhongBxDF : public BxDF {
+/**
+ * GGX (Trowbridge-Reitz) microfacet BRDF over a Lambertian base, see
+ * - Walter et al., "Microfacet Models for Refraction through Rough Surfaces"
+ * - Heitz, "Sampling the GGX Distribution of Visible Normals"
+ *
+ * the MTL parameters are mapped as:
+ * - roughness alpha = sqrt(2 / (Ns + 2)), the width matching the Phong lobe of the exponent Ns
+ * - Fresnel reflectance at normal incidence F0 = Ks, or ((Ni - 1) / (Ni + 1))^2 of a dielectric if
+ *   Ks is black
+ * - Kd & F0 are scaled to sum up to at most 1, & the Fresnel term rises to 1 - max(Kd) at grazing
+ *   angles, so that the surface never reflects more than it receives
+ *
+ * the transparent & the mirror materials keep the delta lobes of the path tracer, & shade as the
+ * Blinn-Phong BxDF does
+ */
+class GGXBxDF {
 public:
-  ~BlinnPhongBxDF() noexcept override = default;
+  static constexpr float MIN_ALPHA = 1.0e-3F;
+
+  // the lobes of a material
+  struct Lobes {
+    Eigen::Vector3f kd;
+    Eigen::Vector3f f0;
+    float f90;
+    float alpha;
+    float p_specular;  // probability to sample the specular lobe
+  };
+
+  static Lobes Map(const Material& p_mtl) {
+    Lobes lobes;
+    lobes.f0 = p_mtl.Ks;
+    if ((lobes.f0.array() == 0.0F).all()) {
+      float r = (p_mtl.Ni - 1.0F) / (p_mtl.Ni + 1.0F);
+      lobes.f0.setConstant(r * r);
+    }
+    float kd_max = p_mtl.Kd.maxCoeff();
+    float f0_max = lobes.f0.maxCoeff();
+    float scale = std::max(1.0F, kd_max + f0_max);
+    lobes.kd = p_mtl.Kd / scale;
+    lobes.f0 /= scale;
+    lobes.f90 = 1.0F - kd_max / scale;
+    lobes.alpha = std::max(MIN_ALPHA, std::sqrt(2.0F / (p_mtl.Ns + 2.0F)));
+    lobes.p_specular = f0_max > 0.0F ? f0_max / (kd_max + f0_max) : 0.0F;
+    return lobes;
+  }
+
   Eigen::Vector3f Shade(const Material& p_mtl,
                         const Eigen::Vector3f& n,
                         const Eigen::Vector3f& wi,
-                        const Eigen::Vector3f& wo) const override;
+                        const Eigen::Vector3f& wo) const {
+    return Shade(p_mtl, Material::Type(p_mtl), n, wi, wo);
+  }
+
+  // same as above with the type of the material known
+  Eigen::Vector3f Shade(const Material& p_mtl,
+                        Material::TypeEnum type,
+                        const Eigen::Vector3f& n,
+                        const Eigen::Vector3f& wi,
+                        const Eigen::Vector3f& wo) const {
+    if (type == Material::TR || type == Material::SPEC)
+      return BlinnPhongBxDF().Shade(p_mtl, type, n, wi, wo);
+
+    Lobes lobes = Map(p_mtl);
+    Eigen::Vector3f diffusion = lobes.kd / M_PI;
+    float cos_i = n.dot(wi);
+    float cos_o = n.dot(wo);
+    if (cos_i <= 0.0F || cos_o <= 0.0F)
+      return diffusion;
+
+    Eigen::Vector3f halfway = (wi + wo).normalized();
+    float alpha2 = lobes.alpha * lobes.alpha;
+    float g2 = 1.0F / (1.0F + Lambda(cos_i, alpha2) + Lambda(cos_o, alpha2));
+    float schlick = std::pow(1.0F - std::clamp(wi.dot(halfway), 0.0F, 1.0F), 5.0F);
+    Eigen::Vector3f fresnel = lobes.f0 + (lobes.f90 - lobes.f0.array()).matrix() * schlick;
+    return diffusion + fresnel * (D(n.dot(halfway), alpha2) * g2 / (4.0F * cos_i * cos_o));
+  }
+
+  // evaluate all the BxDFs of a batch into batch.fr
+  void Shade(ShadingBatch& batch) const;
+
+  // whether the BxDF is constant for a diffusive material, i.e. it has no specular lobe
+  bool IsLambertian(const Material& p_mtl, Material::TypeEnum type) const {
+    return type == Material::DIFF && Map(p_mtl).p_specular == 0.0F;
+  }
+
+  // sample the exit direction of a diffusive surface from the visible normals of the specular lobe
+  // or the cosine weighted hemisphere, chosen by Lobes::p_specular
+  BxDFSample Sample(const Material& p_mtl,
+                    const Eigen::Vector3f& n,
+                    const Eigen::Vector3f& wo) const;
+
+  // the PDF of Sample
+  double Pdf(const Material& p_mtl,
+             const Eigen::Vector3f& n,
+             const Eigen::Vector3f& wi,
+             const Eigen::Vector3f& wo) const;
+
+private:
+  // normal distribution of the microfacets
+  static float D(float cos_h, float alpha2) {
+    float d = cos_h * cos_h * (alpha2 - 1.0F) + 1.0F;
+    return cos_h > 0.0F ? alpha2 / (float(M_PI) * d * d) : 0.0F;
+  }
+
+  // Smith's auxiliary function, G1 = 1 / (1 + Lambda)
+  static float Lambda(float cos, float alpha2) {
+    float cos2 = cos * cos;
+    return 0.5F * (std::sqrt(1.0F + alpha2 * (1.0F - cos2) / cos2) - 1.0F);
+  }
+
+  // in the normal frame
+  static double Pdf(const Lobes& lobes, const Eigen::Vector3f& wi, const Eigen::Vector3f& wo);
 };
 
+// the closed set of the BxDFs
+//
+// the integrators visit it once per path or per stage of a wavefront, & run their loops with the
+// type of the BxDF known, so that the evaluations are inlined
+using BxDF = std::variant<BlinnPhongBxDF, GGXBxDF>;
+
 }  // namespace mcpt
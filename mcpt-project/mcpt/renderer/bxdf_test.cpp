@@ -0,0 +1,207 @@
+#include "mcpt/renderer/bxdf.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <variant>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcpt/common/object/material.hpp"
+#include "mcpt/common/random.hpp"
+
+TEST_CASE("batch BxDF evaluation matches the single one", "[bxdf]") {
+
+std::mt19937 gen(42);
+std::uniform_real_distribution<float> uni(0.0F, 1.0F);
+
+// every 4th material is transparent
+std::vector<mcpt::Material> materials(64);
+for (size_t i = 0; i < materials.size(); ++i) {
+  auto& mtl = materials[i];
+  mtl.Kd = Eigen::Vector3f(uni(gen), uni(gen), uni(gen));
+  mtl.Ks = Eigen::Vector3f(uni(gen), uni(gen), uni(gen));
+  mtl.Ns = 1000.0F * uni(gen);
+  mtl.Tr = i % 4 ? 0.0F : uni(gen);
+}
+
+// directions on the hemisphere of the normal, for the cosines of the halfways to spread over (0, 1]
+auto random_dir = [&](const Eigen::Vector3f& n) {
+  Eigen::Vector3f d;
+  do {
+    d = Eigen::Vector3f(uni(gen), uni(gen), uni(gen)) * 2.0F - Eigen::Vector3f::Ones();
+  } while (d.squaredNorm() > 1.0F || d.squaredNorm() < 1.0e-4F);
+  d.normalize();
+  return n.dot(d) < 0.0F ? Eigen::Vector3f(-d) : d;
+};
+
+mcpt::ShadingBatch batch;
+for (size_t i = 0; i < 10000; ++i) {
+  const auto& mtl = materials[i % materials.size()];
+  Eigen::Vector3f n = random_dir(Eigen::Vector3f::UnitZ());
+  batch.push_back(mtl, mcpt::Material::Type(mtl), n, random_dir(n), random_dir(n));
+}
+
+mcpt::BxDF bxdf = mcpt::BlinnPhongBxDF();
+std::visit([&](const auto& impl) { impl.Shade(batch); }, bxdf);
+REQUIRE(batch.fr.size() == batch.size());
+
+// the powers of the batch may be taken by the fast math kernels
+mcpt::BlinnPhongBxDF blinn_phong;
+for (size_t i = 0; i < batch.size(); ++i) {
+  Eigen::Vector3f expected =
+      blinn_phong.Shade(*batch.material[i], batch.normal[i], batch.wi[i], batch.wo[i]);
+  for (int c = 0; c < 3; ++c)
+    REQUIRE(batch.fr[i][c] == Catch::Approx(expected[c]).epsilon(1.0e-4).margin(1.0e-6));
+}
+
+}
+
+TEST_CASE("GGX BxDF samples by its PDF & conserves the energy", "[bxdf]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::GGXBxDF ggx;
+Eigen::Vector3f n = Eigen::Vector3f(0.3F, -0.2F, 1.0F).normalized();
+
+// glossy plastic, rough metal & mirror-like metal, like the MTLs of the examples
+mcpt::Material plastic;
+plastic.Kd = Eigen::Vector3f(0.5F, 0.5F, 0.5F);
+plastic.Ks = Eigen::Vector3f(1.0F, 1.0F, 1.0F);
+plastic.Ns = 20.0F;
+mcpt::Material rough;
+rough.Kd = Eigen::Vector3f(0.1F, 0.0F, 0.0F);
+rough.Ks = Eigen::Vector3f(0.9F, 0.6F, 0.3F);
+rough.Ns = 2.0F;
+mcpt::Material shiny;
+shiny.Kd = Eigen::Vector3f(0.05F, 0.05F, 0.05F);
+shiny.Ks = Eigen::Vector3f(0.95F, 0.95F, 0.95F);
+shiny.Ns = 500.0F;
+
+for (const auto* mtl : {&plastic, &rough, &shiny}) {
+  for (float cos_o : {0.9F, 0.5F, 0.1F}) {
+    Eigen::Matrix3f frame = mcpt::NormalFrame(n);
+    Eigen::Vector3f wo = frame * Eigen::Vector3f(std::sqrt(1.0F - cos_o * cos_o), 0.0F, cos_o);
+
+    // the albedo estimated by the importance samples & by the uniform samples of the hemisphere
+    constexpr size_t NUM_SAMPLES = 200000;
+    Eigen::Vector3d albedo = Eigen::Vector3d::Zero();
+    Eigen::Vector3d albedo_uniform = Eigen::Vector3d::Zero();
+    double pdf_mass = 0.0;
+    size_t num_below = 0;
+    mcpt::UniformHemisphere<float> hemisphere;
+    for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+      auto [wi, pdf] = ggx.Sample(*mtl, n, wo);
+      REQUIRE(pdf > 0.0);
+      REQUIRE(pdf == Catch::Approx(ggx.Pdf(*mtl, n, wi, wo)).epsilon(1.0e-3));
+      float cos_i = n.dot(wi);
+      num_below += cos_i <= 0.0F;
+      if (cos_i > 0.0F)
+        albedo += (ggx.Shade(*mtl, n, wi, wo) * (cos_i / pdf)).cast<double>();
+
+      auto sa = hemisphere.Random();
+      Eigen::Vector3f wu = frame * Eigen::Vector3f(sa.sin_depression * sa.cos_azimuth,
+                                                   sa.sin_depression * sa.sin_azimuth,
+                                                   sa.cos_depression);
+      albedo_uniform += (ggx.Shade(*mtl, n, wu, wo) * (sa.cos_depression / sa.pdf)).cast<double>();
+      pdf_mass += ggx.Pdf(*mtl, n, wu, wo) / sa.pdf;
+    }
+    albedo /= NUM_SAMPLES;
+    albedo_uniform /= NUM_SAMPLES;
+    pdf_mass /= NUM_SAMPLES;
+
+    for (int c = 0; c < 3; ++c)
+      CHECK(albedo[c] <= 1.0);
+
+    // the uniform samples hardly hit the narrow lobes
+    if (mtl == &shiny)
+      continue;
+    for (int c = 0; c < 3; ++c)
+      CHECK(albedo[c] == Catch::Approx(albedo_uniform[c]).epsilon(0.03).margin(0.005));
+    // the specular samples reflected below the surface take the PDF mass missing above it
+    double below = double(num_below) / NUM_SAMPLES;
+    CHECK(pdf_mass == Catch::Approx(1.0 - below).epsilon(0.02));
+  }
+}
+
+}
+
+TEST_CASE("GGX batch evaluation matches the single one", "[bxdf]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::Material mtl;
+mtl.Kd = Eigen::Vector3f(0.5F, 0.2F, 0.1F);
+mtl.Ks = Eigen::Vector3f(0.3F, 0.3F, 0.3F);
+mtl.Ns = 50.0F;
+Eigen::Vector3f n = Eigen::Vector3f::UnitZ();
+
+mcpt::ShadingBatch batch;
+mcpt::CosHemisphere<float> hemisphere;
+for (size_t i = 0; i < 1000; ++i) {
+  auto a = hemisphere.Random();
+  auto b = hemisphere.Random();
+  batch.push_back(mtl,
+                  mcpt::Material::Type(mtl),
+                  n,
+                  Eigen::Vector3f(a.sin_depression * a.cos_azimuth,
+                                  a.sin_depression * a.sin_azimuth,
+                                  a.cos_depression),
+                  Eigen::Vector3f(b.sin_depression * b.cos_azimuth,
+                                  b.sin_depression * b.sin_azimuth,
+                                  b.cos_depression));
+}
+
+mcpt::BxDF bxdf = mcpt::GGXBxDF();
+std::visit([&](const auto& impl) { impl.Shade(batch); }, bxdf);
+mcpt::GGXBxDF ggx;
+for (size_t i = 0; i < batch.size(); ++i)
+  REQUIRE(batch.fr[i] == ggx.Shade(mtl, n, batch.wi[i], batch.wo[i]));
+
+}
+
+TEST_CASE("GGX BxDF shades the transparent & the mirror materials as Blinn-Phong", "[bxdf]") {
+
+mcpt::Material glass;
+glass.Ks = Eigen::Vector3f(0.9F, 0.9F, 0.9F);
+glass.Ns = 100.0F;
+glass.Tr = 0.8F;
+mcpt::Material mirror;
+mirror.Ks = Eigen::Vector3f(0.8F, 0.7F, 0.6F);
+mirror.Ns = 200.0F;
+REQUIRE(mcpt::Material::Type(glass) == mcpt::Material::TR);
+REQUIRE(mcpt::Material::Type(mirror) == mcpt::Material::SPEC);
+
+Eigen::Vector3f n = Eigen::Vector3f::UnitZ();
+Eigen::Vector3f wo = Eigen::Vector3f(0.3F, 0.0F, 1.0F).normalized();
+mcpt::GGXBxDF ggx;
+mcpt::BlinnPhongBxDF blinn_phong;
+for (const auto& wi : {Eigen::Vector3f(-0.3F, 0.0F, 1.0F).normalized(),
+                       Eigen::Vector3f(0.5F, 0.5F, 0.7F).normalized()}) {
+  CAPTURE(wi.transpose());
+  CHECK(ggx.Shade(glass, n, wi, wo) == blinn_phong.Shade(glass, n, wi, wo));
+  CHECK(ggx.Shade(mirror, n, wi, wo) == blinn_phong.Shade(mirror, n, wi, wo));
+}
+
+}
+
+TEST_CASE("Blinn-Phong BxDF samples by its PDF", "[bxdf]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::BlinnPhongBxDF blinn_phong;
+Eigen::Vector3f n = Eigen::Vector3f(-0.5F, 0.1F, 1.0F).normalized();
+Eigen::Vector3f wo = Eigen::Vector3f(0.3F, 0.2F, 1.0F).normalized();
+
+for (float ns : {0.0F, 10.0F, 200.0F}) {
+  mcpt::Material mtl;
+  mtl.Kd = Eigen::Vector3f(0.5F, 0.5F, 0.5F);
+  mtl.Ns = ns;
+  for (int i = 0; i < 1000; ++i) {
+    auto [wi, pdf] = blinn_phong.Sample(mtl, n, wo);
+    REQUIRE(pdf == Catch::Approx(blinn_phong.Pdf(mtl, n, wi, wo)).epsilon(1.0e-3));
+  }
+  CHECK(blinn_phong.Pdf(mtl, n, -n, wo) == 0.0);
+}
+
+}
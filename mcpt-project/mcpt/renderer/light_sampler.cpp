@@ -6,8 +6,10 @@
 #include <spdlog/spdlog.h>
 
 #include "mcpt/common/assert.hpp"
+#include "mcpt/common/geometry/ray_offset.hpp"
 #include "mcpt/common/random.hpp"
 #include "mcpt/common/random_triangle.hpp"
+#include "mcpt/common/stats.hpp"
 
 namespace mcpt {
 
@@ -18,30 +20,72 @@ constexpr float AREA_EPSILON = 0.001F;
 constexpr float COSINE_EPSILON = 0.0001F;
 }  // namespace
 
+void LightSampler::TriangleLights::push_back(const Mesh* m,
+                                             const Material* mtl,
+                                             const Eigen::Vector3f& v,
+                                             const Eigen::Vector3f& e_1,
+                                             const Eigen::Vector3f& e_2) {
+  float a = e_1.cross(e_2).norm() / 2.0F;
+  mesh.push_back(m);
+  material.push_back(mtl);
+  vertex.push_back(v);
+  edge_1.push_back(e_1);
+  edge_2.push_back(e_2);
+  normal.push_back(m->normal);
+  area.push_back(a);
+  accum_area.push_back(accum_area.empty() ? a : accum_area.back() + a);
+}
+
 LightSampler::LightSampler(const Object& object, const BVHTree<float>& bvh_tree)
     : m_associated_object(object), m_ray_caster(bvh_tree) {
   for (const auto& mesh : object.light_sources())
     AddTriangleLights(mesh);
-  ASSERT(!m_triangle_lights.empty(), "no light source mesh in the scene");
+  ASSERT(m_triangle_lights.size() != 0, "no light source mesh in the scene");
 }
 
 std::optional<PathToLight> LightSampler::Run(const Eigen::Vector3f& start_point,
                                              const Eigen::Vector3f& start_normal) {
-  // first select a triangle
-  float area = Uniform<float>().Random() * m_triangle_lights.back().accum_area;
-  size_t sel = 0;
-  while (sel < m_triangle_lights.size() && area >= m_triangle_lights[sel].accum_area)
-    ++sel;
-  const auto& light = m_triangle_lights[sel];
+  auto lpath = Sample(start_point, start_normal);
+  if (lpath.has_value() && IsBlocked(start_point, start_normal, lpath.value()))
+    return std::nullopt;
+  return lpath;
+}
+
+std::optional<PathToLight> LightSampler::Sample(const Eigen::Vector3f& start_point,
+                                                const Eigen::Vector3f& start_normal) {
+  // first select a triangle by area
+  const auto& accum_area = m_triangle_lights.accum_area;
+  float area = Uniform<float>().Random() * accum_area.back();
+  size_t sel = std::upper_bound(accum_area.cbegin(), accum_area.cend(), area) - accum_area.cbegin();
+  sel = std::min(sel, accum_area.size() - 1);
 
   // sample a vertex in the selected triangle
-  auto [hit_pdf, hit_point, hit_dir] = HitDirection(start_point, start_normal, light);
-  if (hit_pdf == 0.0)
+  STATS_INC(LIGHT_SAMPLES);
+  auto [hit_pdf, hit_point, hit_dir] = HitDirection(start_point, start_normal, sel);
+  if (hit_pdf == 0.0) {
+    STATS_INC(LIGHT_SAMPLE_REJECTIONS);
     return std::nullopt;
-  hit_pdf *= light.area / m_triangle_lights.back().accum_area;
+  }
+  hit_pdf *= m_triangle_lights.area[sel] / accum_area.back();
+
+  return PathToLight{*m_triangle_lights.material[sel],
+                     *m_triangle_lights.mesh[sel],
+                     hit_point,
+                     m_triangle_lights.normal[sel],
+                     hit_dir,
+                     hit_pdf};
+}
 
-  const auto& mtl = m_associated_object.get().GetMaterialByName(light.mesh.get().material);
-  return PathToLight{mtl, hit_point, light.mesh.get().normal, hit_dir, hit_pdf};
+bool LightSampler::IsBlocked(const Eigen::Vector3f& start_point,
+                             const Eigen::Vector3f& start_normal,
+                             const PathToLight& lpath,
+                             const PrimitiveId& exclude) const {
+  // move both ends off their surfaces, so the meshes around them can not block the shadow ray
+  Eigen::Vector3f origin = OffsetRayOrigin(start_point, start_normal, lpath.hit_dir);
+  Eigen::Vector3f target = OffsetRayOrigin<float>(lpath.point, lpath.normal, -lpath.hit_dir);
+  Eigen::Vector3f hit_path = target - origin;
+  Ray<float> hit_ray(origin, hit_path);
+  return m_ray_caster.IsBlocked(hit_ray, lpath.mesh, hit_path.norm(), exclude);
 }
 
 void LightSampler::AddTriangleLights(const Mesh& light) {
@@ -49,99 +93,86 @@ void LightSampler::AddTriangleLights(const Mesh& light) {
   ASSERT(verts.size() >= 3, "invalid number of vertices: {}", verts.size());
 
   // split the convex polygon light into triangle fans
+  const Material& mtl = m_associated_object.get().GetMaterialByName(light.material);
   for (size_t i = 1; i + 1 < verts.size(); ++i) {
-    float area = (verts[i] - verts[0]).cross(verts[i + 1] - verts[0]).norm() / 2.0F;
-    float accum_area = area;
-    if (!m_triangle_lights.empty())
-      accum_area += m_triangle_lights.back().accum_area;
-
-    // create association between trianlge light and the original mesh
-    ConvexPolygon<float> triangle(verts[0], verts[i], verts[i + 1]);
-    m_triangle_lights.push_back({light, triangle, area, accum_area});
+    m_triangle_lights.push_back(
+        &light, &mtl, verts[0], verts[i] - verts[0], verts[i + 1] - verts[0]);
   }
 }
 
 LightSampler::sample LightSampler::HitDirection(const Eigen::Vector3f& point,
                                                 const Eigen::Vector3f& normal,
-                                                const TriangleLight& light) {
+                                                size_t light) {
+  // the light faces away from the point, any sample would be rejected
+  const Eigen::Vector3f& vertex = m_triangle_lights.vertex[light];
+  if (m_triangle_lights.normal[light].dot(point - vertex) <= 0.0F)
+    return {0.0};
+
   // project the triangle onto the unit sphere
-  Eigen::Vector3f A = light.triangle.vertices[0] - point;
-  Eigen::Vector3f B = light.triangle.vertices[1] - point;
-  Eigen::Vector3f C = light.triangle.vertices[2] - point;
-
-  // internal angles of the spherical triangle
-  Eigen::Vector3f n_arc_a = B.cross(C).normalized();
-  Eigen::Vector3f n_arc_b = C.cross(A).normalized();
-  Eigen::Vector3f n_arc_c = A.cross(B).normalized();
-  float alpha = std::acos(std::clamp(-n_arc_b.dot(n_arc_c), -1.0F, 1.0F));
-  float beta = std::acos(std::clamp(-n_arc_a.dot(n_arc_c), -1.0F, 1.0F));
-  float gamma = std::acos(std::clamp(-n_arc_a.dot(n_arc_b), -1.0F, 1.0F));
-
-  // each spherical internal angle is between (0,pi)
-  DASSERT(
-      alpha > 0.0F && beta > 0.0F && gamma > 0.0F, "invalid angles: {} {} {}", alpha, beta, gamma);
-
-  float area = alpha + beta + gamma - M_PI;
-  if (area <= AREA_EPSILON) {
+  Eigen::Vector3f A = vertex - point;
+  Eigen::Vector3f B = A + m_triangle_lights.edge_1[light];
+  Eigen::Vector3f C = A + m_triangle_lights.edge_2[light];
+  A.normalize();
+  B.normalize();
+  C.normalize();
+
+  float area = UniformUnitSphericalTriangle<float>::Area(A, B, C);
+  if (area <= AREA_EPSILON)
     return SamplePlaneLight(point, normal, light);
-  } else {
-    A.normalize();
-    B.normalize();
-    C.normalize();
+  else
     return SampleSphericalLight(point, normal, light, A, B, C, area);
-  }
 }
 
 LightSampler::sample LightSampler::SamplePlaneLight(const Eigen::Vector3f& point,
                                                     const Eigen::Vector3f& normal,
-                                                    const TriangleLight& light) {
-  const Mesh& light_mesh = light.mesh;
-
-  Eigen::Vector3f hit_point = UniformTriangle<float>().Random(
-      light.triangle.vertices[0], light.triangle.vertices[1], light.triangle.vertices[2]);
+                                                    size_t light) {
+  const Eigen::Vector3f& vertex = m_triangle_lights.vertex[light];
+  const Eigen::Vector3f& light_normal = m_triangle_lights.normal[light];
+
+  Eigen::Vector3f hit_point =
+      UniformTriangle<float>().Random(vertex,
+                                      Eigen::Vector3f(vertex + m_triangle_lights.edge_1[light]),
+                                      Eigen::Vector3f(vertex + m_triangle_lights.edge_2[light]));
   Eigen::Vector3f hit_path = hit_point - point;
-  Ray<float> hit_ray(point, hit_path);
+  float distance = hit_path.norm();
+  Eigen::Vector3f hit_dir = hit_path / distance;
 
-  if (!IsVisible(hit_ray, light_mesh, normal, hit_path.norm())) {
+  if (!IsFacing(hit_dir, normal, light_normal)) {
     return {0.0};
   } else {
-    double pdf = hit_path.squaredNorm() / light_mesh.normal.dot(-hit_ray.direction) / light.area;
+    double pdf = distance * distance / light_normal.dot(-hit_dir) / m_triangle_lights.area[light];
     ASSERT(pdf > 0.0, "invalid PDF sampling plane triangle: {}", pdf);
-    return {pdf, hit_point, hit_ray.direction};
+    return {pdf, hit_point, hit_dir};
   }
 }
 
 LightSampler::sample LightSampler::SampleSphericalLight(const Eigen::Vector3f& point,
                                                         const Eigen::Vector3f& normal,
-                                                        const TriangleLight& light,
+                                                        size_t light,
                                                         const Eigen::Vector3f& A,
                                                         const Eigen::Vector3f& B,
                                                         const Eigen::Vector3f& C,
                                                         float area) {
-  const Mesh& light_mesh = light.mesh;
+  const Eigen::Vector3f& light_normal = m_triangle_lights.normal[light];
 
-  Ray<float> hit_ray(point, UniformUnitSphericalTriangle<float>().Random(A, B, C));
-  Eigen::Vector4f inter_p = m_ray_caster.IntersectPlane(hit_ray, light_mesh.polygon);
-  if (inter_p.w() == 0.0F)
+  Eigen::Vector3f hit_dir = UniformUnitSphericalTriangle<float>().Random(A, B, C, area);
+  if (!IsFacing(hit_dir, normal, light_normal))
     return {0.0};
-  Eigen::Vector3f hit_point = inter_p.hnormalized();
 
-  if (!IsVisible(hit_ray, light_mesh, normal, (hit_point - point).norm())) {
-    return {0.0};
-  } else {
-    double pdf = 1.0 / area;
-    ASSERT(pdf > 0.0, "invalid PDF sampling spherical triangle: {}", pdf);
-    return {pdf, hit_point, hit_ray.direction};
-  }
+  // intersect the plane of the light, the direction is not parallel to it when facing
+  float distance =
+      light_normal.dot(m_triangle_lights.vertex[light] - point) / light_normal.dot(hit_dir);
+  Eigen::Vector3f hit_point = point + distance * hit_dir;
+
+  double pdf = 1.0 / area;
+  ASSERT(pdf > 0.0, "invalid PDF sampling spherical triangle: {}", pdf);
+  return {pdf, hit_point, hit_dir};
 }
 
-bool LightSampler::IsVisible(const Ray<float>& hit_ray,
-                             const Mesh& target,
-                             const Eigen::Vector3f& normal,
-                             float hit_dist) const {
-  return (hit_ray.direction.dot(normal) > COSINE_EPSILON) &&
-         (hit_ray.direction.dot(-target.normal) > COSINE_EPSILON) &&
-         !m_ray_caster.IsBlocked(hit_ray, target, hit_dist);
+bool LightSampler::IsFacing(const Eigen::Vector3f& hit_dir,
+                            const Eigen::Vector3f& normal,
+                            const Eigen::Vector3f& light_normal) const {
+  return (hit_dir.dot(normal) > COSINE_EPSILON) && (hit_dir.dot(-light_normal) > COSINE_EPSILON);
 }
 
 }  // namespace mcpt
@@ -18,6 +18,7 @@ namespace mcpt {
 
 struct PathToLight {
   std::reference_wrapper<const Material> material;  // light source material
+  std::reference_wrapper<const Mesh> mesh;          // light source mesh
 
   Eigen::Vector3f point;   // intersection point at the light surface
   Eigen::Vector3f normal;  // surface normal at the intersection
@@ -30,15 +31,39 @@ class LightSampler {
 public:
   LightSampler(const Object& object, const BVHTree<float>& bvh_tree);
 
+  // sample a visible path to some light source
   std::optional<PathToLight> Run(const Eigen::Vector3f& start_point,
                                  const Eigen::Vector3f& start_normal);
 
+  // sample a path to some light source without testing occlusion
+  std::optional<PathToLight> Sample(const Eigen::Vector3f& start_point,
+                                    const Eigen::Vector3f& start_normal);
+  // test whether the sampled path is blocked by other meshes (the shadow ray), the start normal is
+  // the geometric one of the surface the shadow ray leaves, whose mesh is excluded if given
+  bool IsBlocked(const Eigen::Vector3f& start_point,
+                 const Eigen::Vector3f& start_normal,
+                 const PathToLight& lpath,
+                 const PrimitiveId& exclude = {}) const;
+
 private:
-  struct TriangleLight {
-    std::reference_wrapper<const Mesh> mesh;
-    ConvexPolygon<float> triangle;
-    float area;
-    float accum_area;
+  // the light meshes split into triangle fans, the geometry independent of the shading points is
+  // computed once
+  struct TriangleLights {
+    std::vector<const Mesh*> mesh;
+    std::vector<const Material*> material;
+    std::vector<Eigen::Vector3f> vertex;  // first vertex
+    std::vector<Eigen::Vector3f> edge_1;  // from the first vertex to the second
+    std::vector<Eigen::Vector3f> edge_2;  // from the first vertex to the third
+    std::vector<Eigen::Vector3f> normal;  // normal of the light mesh
+    std::vector<float> area;
+    std::vector<float> accum_area;
+
+    size_t size() const noexcept { return mesh.size(); }
+    void push_back(const Mesh* m,
+                   const Material* mtl,
+                   const Eigen::Vector3f& v,
+                   const Eigen::Vector3f& e_1,
+                   const Eigen::Vector3f& e_2);
   };
 
   struct sample {
@@ -49,30 +74,28 @@ private:
 
   void AddTriangleLights(const Mesh& light);
 
-  sample HitDirection(const Eigen::Vector3f& point,
-                      const Eigen::Vector3f& normal,
-                      const TriangleLight& light);
+  // the light is given by its index in the triangle lights
+  sample HitDirection(const Eigen::Vector3f& point, const Eigen::Vector3f& normal, size_t light);
 
   sample SamplePlaneLight(const Eigen::Vector3f& point,
                           const Eigen::Vector3f& normal,
-                          const TriangleLight& light);
+                          size_t light);
 
   sample SampleSphericalLight(const Eigen::Vector3f& point,
                               const Eigen::Vector3f& normal,
-                              const TriangleLight& light,
+                              size_t light,
                               const Eigen::Vector3f& A,
                               const Eigen::Vector3f& B,
                               const Eigen::Vector3f& C,
                               float area);
 
-  bool IsVisible(const Ray<float>& hit_ray,
-                 const Mesh& target,
-                 const Eigen::Vector3f& normal,
-                 float hit_dist) const;
+  bool IsFacing(const Eigen::Vector3f& hit_dir,
+                const Eigen::Vector3f& normal,
+                const Eigen::Vector3f& light_normal) const;
 
 private:
   std::reference_wrapper<const Object> m_associated_object;
-  std::vector<TriangleLight> m_triangle_lights;
+  TriangleLights m_triangle_lights;
   RayCaster m_ray_caster;
 };
 
@@ -0,0 +1,101 @@
+#include "mcpt/renderer/light_sampler.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include "mcpt/common/object/material.hpp"
+#include "mcpt/common/object/mesh.hpp"
+#include "mcpt/common/object/object.hpp"
+#include "mcpt/common/random.hpp"
+
+namespace {
+
+constexpr unsigned int SEED = 42;
+
+// random triangle lights facing down to the floor [0, SCENE_EXTENT]^2 at z = 0, the shading points
+// are on the floor & close enough to sample the solid angles of most lights
+struct LightScene {
+  static constexpr float SCENE_EXTENT = 20.0F;
+  static constexpr float LIGHT_HEIGHT = 5.0F;
+  // max coordinate offset of the light vertices from the triangle center
+  static constexpr float LIGHT_SIZE = 2.0F;
+
+  mcpt::Object object;
+  mcpt::BVHTree<float> bvh_tree;
+  std::vector<Eigen::Vector3f> points;
+};
+
+const LightScene& GetLightScene(size_t num_lights, size_t num_points = 1024) {
+  static std::unique_ptr<LightScene> scene;
+  if (scene && scene->object.light_sources().size() == num_lights)
+    return *scene;
+
+  scene.reset();
+  scene = std::make_unique<LightScene>();
+  auto& object = scene->object;
+  object.materials()["light"].Ke = Eigen::Vector3f::Ones();
+  object.materials()["floor"].Kd = Eigen::Vector3f::Constant(0.5F);
+  object.text_coords().emplace_back(0.0F, 0.0F);
+  object.normals().emplace_back(0.0F, 0.0F, -1.0F);
+  object.normals().emplace_back(0.0F, 0.0F, 1.0F);
+
+  mcpt::Uniform<float>::Seed(SEED);
+  mcpt::Uniform<float> uniform;
+  auto& vertices = object.vertices();
+  auto& lights = object.mesh_groups().emplace_back(mcpt::MeshIndexGroup{"light", {}});
+  for (size_t i = 0; i < num_lights; ++i) {
+    Eigen::Vector3f center(uniform.Random() * LightScene::SCENE_EXTENT,
+                           uniform.Random() * LightScene::SCENE_EXTENT,
+                           LightScene::LIGHT_HEIGHT);
+    for (int k = 0; k < 3; ++k) {
+      Eigen::Vector3f offset(uniform.Random(), uniform.Random(), 0.0F);
+      vertices.push_back(center + offset * LightScene::LIGHT_SIZE);
+    }
+    size_t v = vertices.size() - 3;
+    lights.mesh_index.push_back({{v, v + 1, v + 2}, {0, 0, 0}, {0, 0, 0}});
+  }
+
+  size_t v = vertices.size();
+  for (float y : {0.0F, LightScene::SCENE_EXTENT}) {
+    for (float x : {0.0F, LightScene::SCENE_EXTENT})
+      vertices.emplace_back(x, y, 0.0F);
+  }
+  auto& floor = object.mesh_groups().emplace_back(mcpt::MeshIndexGroup{"floor", {}});
+  floor.mesh_index.push_back({{v, v + 1, v + 3, v + 2}, {0, 0, 0, 0}, {1, 1, 1, 1}});
+
+  auto level = spdlog::get_level();
+  spdlog::set_level(spdlog::level::warn);
+  scene->bvh_tree = object.CreateBVHTree();
+  spdlog::set_level(level);
+
+  for (size_t i = 0; i < num_points; ++i) {
+    scene->points.emplace_back(uniform.Random() * LightScene::SCENE_EXTENT,
+                               uniform.Random() * LightScene::SCENE_EXTENT,
+                               0.0F);
+  }
+  return *scene;
+}
+
+// sample a light point for each shading point without testing occlusion
+void BM_LightSamplerSample(benchmark::State& state) {
+  const auto& scene = GetLightScene(state.range(0));
+  mcpt::LightSampler light_sampler(scene.object, scene.bvh_tree);
+
+  size_t i = 0;
+  size_t num_rejections = 0;
+  for (auto _ : state) {
+    const auto& point = scene.points[i % scene.points.size()];
+    auto lpath = light_sampler.Sample(point, Eigen::Vector3f::UnitZ());
+    num_rejections += !lpath.has_value();
+    benchmark::DoNotOptimize(lpath);
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["rejection_rate"] = double(num_rejections) / double(state.iterations());
+}
+BENCHMARK(BM_LightSamplerSample)->RangeMultiplier(16)->Range(1, 4096);
+
+}  // namespace
@@ -1,9 +1,12 @@
 #include "mcpt/renderer/monte_carlo.hpp"
 
 #include <cmath>
+#include <variant>
 
 #include "mcpt/common/assert.hpp"
+#include "mcpt/common/geometry/ray_offset.hpp"
 #include "mcpt/common/object/material.hpp"
+#include "mcpt/common/stats.hpp"
 
 namespace mcpt {
 
@@ -12,8 +15,15 @@ MonteCarlo::Result MonteCarlo::Run(unsigned int u, unsigned int v) {
   Eigen::Vector3f xy1 = m_intrin_inv * uv.homogeneous();
 
   Result result;
-  result.rpaths = Backtrace(xy1);
-  result.radiance = Propagate(m_options.t, result.rpaths);
+  uint64_t steps = RayCaster::traversal_steps();
+  std::visit(
+      [&](const auto& bxdf) {
+        result.rpaths = Backtrace(bxdf, xy1, result.rays);
+        STATS_PATH_LENGTH(result.rpaths.size());
+        result.radiance = Propagate(bxdf, m_options.t, result.rpaths);
+      },
+      m_bxdf);
+  result.cost = RayCaster::traversal_steps() - steps;
   return result;
 }
 
@@ -33,33 +43,69 @@ MonteCarlo::Result MonteCarlo::Run(unsigned int u, unsigned int v) {
  *           ____|/____
  *                        |rpaths| = 6
  */
-MonteCarlo::RPaths MonteCarlo::Backtrace(const Eigen::Vector3f& xy1) {
+template <typename BxDFImpl>
+MonteCarlo::RPaths MonteCarlo::Backtrace(const BxDFImpl& bxdf,
+                                         const Eigen::Vector3f& xy1,
+                                         RayCount& rays) {
   RPaths rpaths;
   Ray<float> ray(m_options.t, m_options.R * xy1);
+  PrimitiveId exclude;
+  Eigen::Vector3f throughput = Eigen::Vector3f::Ones();
   while (true) {
-    auto rpath = m_path_tracer.Run(ray);
+    auto rpath = m_path_tracer.Run(ray, exclude);
+    ++(rpaths.empty() ? rays.primary : rays.extension);
     // stop if no intersection
     if (!rpath.has_value())
       return rpaths;
 
     // only sample direct lighting for diffusion material
-    if (Material::Type(rpath.value().material) == Material::DIFF) {
-      auto lpath = m_light_sampler.Run(rpath.value().point, rpath.value().normal);
+    if (rpath.value().type == Material::DIFF) {
+      auto lpath = m_light_sampler.Sample(rpath.value().point, rpath.value().normal);
+      if (lpath.has_value()) {
+        ++rays.shadow;
+        if (m_light_sampler.IsBlocked(
+                rpath.value().point, rpath.value().normal, lpath.value(), rpath.value().primitive))
+          lpath.reset();
+      }
       rpaths.push_back({rpath.value(), lpath});
     } else {
       rpaths.push_back({rpath.value()});
     }
 
     // stop if hit a light source
-    if (Material::Type(rpath.value().material) == Material::EM)
+    if (rpath.value().type == Material::EM)
       return rpaths;
 
-    // stop if russian roulette fail
-    if (m_russian_roulette.Random() >= m_options.rr_cont_prob)
+    // stop if the radiance cache knows the indirect irradiance
+    const auto& exit = rpaths.back().rpath;
+    if (m_radiance_cache && rpaths.size() >= m_radiance_cache->options().min_depth &&
+        bxdf.IsLambertian(exit.material, exit.type)) {
+      rpaths.back().cached_irradiance = m_radiance_cache->Lookup(exit.point, exit.normal);
+      if (rpaths.back().cached_irradiance.has_value())
+        return rpaths;
+    }
+
+    // stop if reaching the maximum depth
+    if (m_options.max_depth && rpaths.size() >= m_options.max_depth)
       return rpaths;
 
-    // generate next ray
-    ray = Ray<float>(rpath.value().point, rpath.value().exit_dir);
+    // stop if russian roulette fail, by the throughput through the exit direction
+    float cos_wi = std::max(0.0F, exit.normal.dot(exit.exit_dir));
+    Eigen::Vector3f weight =
+        bxdf.Shade(exit.material, exit.type, exit.normal, exit.exit_dir, -ray.direction) *
+        (cos_wi / exit.exit_pdf);
+    double cont_prob = m_options.ContinuationProb(rpaths.size(), throughput.cwiseProduct(weight));
+    if (m_russian_roulette.Random() >= cont_prob)
+      return rpaths;
+    rpaths.back().weight = weight / float(cont_prob);
+    rpaths.back().cont_prob = float(cont_prob);
+    throughput = throughput.cwiseProduct(rpaths.back().weight);
+
+    // generate next ray off the surface
+    Eigen::Vector3f origin =
+        OffsetRayOrigin(rpath.value().point, rpath.value().normal, rpath.value().exit_dir);
+    ray = Ray<float>(origin, rpath.value().exit_dir);
+    exclude = rpath.value().primitive;
   }
 }
 
@@ -73,7 +119,10 @@ MonteCarlo::RPaths MonteCarlo::Backtrace(const Eigen::Vector3f& xy1) {
  *         \ | /
  *    ______\|/_______
  */
-Eigen::Vector3f MonteCarlo::Propagate(const Eigen::Vector3f& eye, const RPaths& rpaths) const {
+template <typename BxDFImpl>
+Eigen::Vector3f MonteCarlo::Propagate(const BxDFImpl& bxdf,
+                                      const Eigen::Vector3f& eye,
+                                      const RPaths& rpaths) const {
   static const Eigen::IOFormat FMT{Eigen::FullPrecision, Eigen::DontAlignCols, " ", " "};
 
   if (rpaths.empty())
@@ -82,7 +131,7 @@ Eigen::Vector3f MonteCarlo::Propagate(const Eigen::Vector3f& eye, const RPaths&
 
   // back propagate from the light source
   for (auto rit = rpaths.crbegin(); rit != rpaths.crend(); ++rit) {
-    const auto& [rpath, lpath] = *rit;
+    const auto& [rpath, lpath, weight, cont_prob, cached_irradiance] = *rit;
 
     Eigen::Vector3f wo;
     if (rit + 1 == rpaths.crend())
@@ -90,7 +139,7 @@ Eigen::Vector3f MonteCarlo::Propagate(const Eigen::Vector3f& eye, const RPaths&
     else
       wo = -(rit + 1)->rpath.exit_dir;
 
-    switch (Material::Type(rpath.material)) {
+    switch (rpath.type) {
       case Material::EM: {
         // ray hit the light source directly
         DASSERT(rit == rpaths.crbegin());
@@ -100,19 +149,37 @@ Eigen::Vector3f MonteCarlo::Propagate(const Eigen::Vector3f& eye, const RPaths&
       case Material::TR:
       case Material::SPEC: {
         // only compute contribution from other reflectors & refractors
-        radiance = shade_indirect(radiance, wo, rpath) / m_options.rr_cont_prob;
+        radiance = radiance.cwiseProduct(weight);
       } break;
 
       case Material::DIFF: {
         // contribution from the light sources
         Eigen::Vector3f r_direct = Eigen::Vector3f::Zero();
         if (lpath.has_value())
-          r_direct = shade_direct(wo, rpath, lpath.value());
+          r_direct = shade_direct(bxdf, wo, rpath, lpath.value());
 
         // contribution from other reflectors & refractors
         Eigen::Vector3f r_indirect = Eigen::Vector3f::Zero();
-        if (rit != rpaths.crbegin() && Material::Type((rit - 1)->rpath.material) != Material::EM)
-          r_indirect = shade_indirect(radiance, wo, rpath) / m_options.rr_cont_prob;
+        if (cached_irradiance.has_value()) {
+          // the BxDF is constant, any incident direction does
+          Eigen::Vector3f fr =
+              bxdf.Shade(rpath.material, rpath.type, rpath.normal, rpath.normal, wo);
+          r_indirect = fr.cwiseProduct(cached_irradiance.value());
+        } else {
+          // the incident radiance over the PDF of the exit direction, zero for the paths ending
+          // here, as their survivors are weighted up
+          Eigen::Vector3f incident = Eigen::Vector3f::Zero();
+          if (rit != rpaths.crbegin() && (rit - 1)->rpath.type != Material::EM) {
+            r_indirect = radiance.cwiseProduct(weight);
+            incident = radiance / float(rpath.exit_pdf * cont_prob);
+          }
+          if (m_radiance_cache && bxdf.IsLambertian(rpath.material, rpath.type)) {
+            float cos_wi = std::max(0.0F, rpath.normal.dot(rpath.exit_dir));
+            m_radiance_cache->Add(rpath.point, rpath.normal, incident * cos_wi);
+          }
+          if (m_path_guide)
+            m_path_guide->Record(rpath.point, rpath.exit_dir, incident.mean());
+        }
 
         radiance = r_direct + r_indirect;
       } break;
@@ -131,20 +198,14 @@ Eigen::Vector3f MonteCarlo::shade_light(const Eigen::Vector3f& wo, const Reverse
     return Eigen::Vector3f::Zero();
 }
 
-Eigen::Vector3f MonteCarlo::shade_direct(const Eigen::Vector3f& wo,
+template <typename BxDFImpl>
+Eigen::Vector3f MonteCarlo::shade_direct(const BxDFImpl& bxdf,
+                                         const Eigen::Vector3f& wo,
                                          const ReversePath& rpath,
                                          const PathToLight& lpath) const {
-  Eigen::Vector3f fr = m_bxdf->Shade(rpath.material, rpath.normal, lpath.hit_dir, wo);
+  Eigen::Vector3f fr = bxdf.Shade(rpath.material, rpath.type, rpath.normal, lpath.hit_dir, wo);
   float cos_wi = std::max(0.0F, rpath.normal.dot(lpath.hit_dir));
   return fr.cwiseProduct(Material::AsEmission(lpath.material)) * (cos_wi / lpath.hit_pdf);
 }
 
-Eigen::Vector3f MonteCarlo::shade_indirect(const Eigen::Vector3f& radiance,
-                                           const Eigen::Vector3f& wo,
-                                           const ReversePath& rpath) const {
-  Eigen::Vector3f fr = m_bxdf->Shade(rpath.material, rpath.normal, rpath.exit_dir, wo);
-  float cos_wi = std::max(0.0F, rpath.normal.dot(rpath.exit_dir));
-  return fr.cwiseProduct(radiance) * (cos_wi / rpath.exit_pdf);
-}
-
 }  // namespace mcpt
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <utility>
@@ -15,6 +17,9 @@
 #include "mcpt/renderer/bxdf.hpp"
 #include "mcpt/renderer/light_sampler.hpp"
 #include "mcpt/renderer/path_tracer.hpp"
+#include "mcpt/renderer/radiance_cache.hpp"
+#include "mcpt/renderer/ray_caster.hpp"
+#include "mcpt/renderer/sd_tree.hpp"
 
 namespace mcpt {
 
@@ -24,19 +29,58 @@ public:
   struct RPath {
     ReversePath rpath;
     std::optional<PathToLight> lpath;
+    // fr * cos / pdf of the exit direction over the continuation probability, i.e. the throughput
+    // factor of the vertex, zero if the path ends here
+    Eigen::Vector3f weight{Eigen::Vector3f::Zero()};
+    // continuation probability of the vertex, zero if the path ends here
+    float cont_prob = 0.0F;
+    // indirect irradiance from the radiance cache, which ends the path here
+    std::optional<Eigen::Vector3f> cached_irradiance;
+  };
+
+  // number of rays traced
+  struct RayCount {
+    size_t primary = 0;
+    size_t extension = 0;
+    size_t shadow = 0;
+
+    size_t total() const noexcept { return primary + extension + shadow; }
+    RayCount& operator+=(const RayCount& rhs) noexcept {
+      primary += rhs.primary;
+      extension += rhs.extension;
+      shadow += rhs.shadow;
+      return *this;
+    }
   };
 
   struct Result {
     std::vector<RPath> rpaths;
     Eigen::Vector3f radiance;
+    RayCount rays;
+    // BVH nodes visited by all the rays of the sample
+    uint64_t cost = 0;
   };
 
   struct Options {
-    double rr_cont_prob = 0.5;
+    // Russian roulette starts at the path vertex `rr_min_depth', from where a path continues with
+    // the probability of the max component of its throughput, bounded by `rr_cont_prob'
+    double rr_cont_prob = 0.95;
+    unsigned int rr_min_depth = 3;
+    // maximum number of path vertices (zero means unlimited)
+    unsigned int max_depth = 0;
     // camera options
     Eigen::Vector4f intrin{Eigen::Vector4f::Zero()};
     Eigen::Matrix3f R{Eigen::Matrix3f::Zero()};
     Eigen::Vector3f t{Eigen::Vector3f::Zero()};
+
+    // the probability for a path of `depth' vertices to continue, by the throughput through the
+    // last exit direction, the paths of no throughput end anyway
+    double ContinuationProb(size_t depth, const Eigen::Vector3f& throughput) const noexcept {
+      double max_throughput = throughput.maxCoeff();
+      if (depth < rr_min_depth)
+        return max_throughput > 0.0 ? 1.0 : 0.0;
+      return std::min(rr_cont_prob, max_throughput);
+    }
   };
 
   MonteCarlo(const Options& options, const Object& object, const BVHTree<float>& bvh_tree)
@@ -48,7 +92,23 @@ public:
     m_intrin_inv << 1.0F / fx, 0.0F, -cx / fx, 0.0F, 1.0F / fy, -cy / fy, 0.0F, 0.0F, 1.0F;
   }
 
-  void SetBxDF(std::unique_ptr<BxDF> bxdf) { m_bxdf = std::move(bxdf); }
+  void SetBxDF(const BxDF& bxdf) {
+    m_bxdf = bxdf;
+    m_path_tracer.SetBxDF(bxdf);
+  }
+
+  // look up the indirect irradiance of the Lambertian vertices in the cache & fill it by the paths,
+  // the cache may be shared by the runners of a scene
+  void SetRadianceCache(std::shared_ptr<RadianceCache> cache) {
+    m_radiance_cache = std::move(cache);
+  }
+
+  // guide the exit directions of the diffusive surfaces by the incident radiance learned from the
+  // paths, the guide may be shared by the runners of a scene
+  void SetPathGuide(std::shared_ptr<SDTree> guide) {
+    m_path_guide = guide;
+    m_path_tracer.SetPathGuide(std::move(guide));
+  }
 
   Result Run(unsigned int u, unsigned int v);
 
@@ -60,21 +120,29 @@ private:
   // backtrace from the eye until:
   // - escaping from the scene (no more intersection)
   // - failing in Russian roulette
-  RPaths Backtrace(const Eigen::Vector3f& xy1);
-  // propagate the light from the light source
-  Eigen::Vector3f Propagate(const Eigen::Vector3f& eye, const RPaths& rpaths) const;
+  // - reaching the maximum depth
+  // - finding the indirect irradiance in the radiance cache
+  template <typename BxDFImpl>
+  RPaths Backtrace(const BxDFImpl& bxdf, const Eigen::Vector3f& xy1, RayCount& rays);
+  // propagate the light from the light source, adding the irradiance samples to the radiance cache
+  // & the incident radiance to the path guide
+  template <typename BxDFImpl>
+  Eigen::Vector3f Propagate(const BxDFImpl& bxdf,
+                            const Eigen::Vector3f& eye,
+                            const RPaths& rpaths) const;
 
   Eigen::Vector3f shade_light(const Eigen::Vector3f& wo, const ReversePath& rpath) const;
-  Eigen::Vector3f shade_direct(const Eigen::Vector3f& wo,
+  template <typename BxDFImpl>
+  Eigen::Vector3f shade_direct(const BxDFImpl& bxdf,
+                               const Eigen::Vector3f& wo,
                                const ReversePath& rpath,
                                const PathToLight& lpath) const;
-  Eigen::Vector3f shade_indirect(const Eigen::Vector3f& radiance,
-                                 const Eigen::Vector3f& wo,
-                                 const ReversePath& rpath) const;
 
 private:
   Options m_options;
-  std::unique_ptr<BxDF> m_bxdf;
+  BxDF m_bxdf;
+  std::shared_ptr<RadianceCache> m_radiance_cache;
+  std::shared_ptr<SDTree> m_path_guide;
 
   Eigen::Matrix3f m_intrin_inv;
   PathTracer m_path_tracer;
@@ -1,7 +1,7 @@
 #include "mcpt/renderer/path_tracer.hpp"
 
 #include <cmath>
-#include <any>
+#include <variant>
 
 #include "mcpt/common/assert.hpp"
 #include "mcpt/common/object/mesh.hpp"
@@ -9,18 +9,40 @@
 
 namespace mcpt {
 
-std::optional<ReversePath> PathTracer::Run(const Ray<float>& incident_ray) {
-  auto intersection = m_ray_caster.Run(incident_ray);
+std::optional<ReversePath> PathTracer::Run(const Ray<float>& incident_ray,
+                                           const PrimitiveId& exclude) {
+  auto intersection = m_ray_caster.Run(incident_ray, exclude);
   // not intersected
   if (intersection.node == nullptr)
     return std::nullopt;
 
-  const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(intersection.node->mesh);
+  const Mesh& mesh = *intersection.primitive.mesh;
+  auto rpath = Scatter(incident_ray.direction, mesh, intersection.point, intersection.normal);
+  rpath.primitive = intersection.primitive;
+  return rpath;
+}
+
+ReversePath PathTracer::Scatter(const Eigen::Vector3f& incident,
+                                const Mesh& mesh,
+                                const Eigen::Vector3f& point,
+                                const Eigen::Vector3f& normal) {
   const Material& mtl = m_associated_object.get().GetMaterialByName(mesh.material);
+  Material::TypeEnum type = Material::Type(mtl);
 
   // sample a new direction
-  auto [exit_pdf, exit_normal, exit_dir] = NextDirection(incident_ray.direction, mesh.normal, mtl);
-  return ReversePath{mtl, intersection.point, exit_normal, exit_dir, exit_pdf};
+  auto [exit_pdf, exit_normal, exit_dir] = NextDirection(incident, point, normal, mtl, type);
+  return ReversePath{mtl, type, point, exit_normal, exit_dir, exit_pdf};
+}
+
+ReversePath PathTracer::Scatter(const Eigen::Vector3f& incident,
+                                const Material& mtl,
+                                const Eigen::Vector3f& point,
+                                const Eigen::Vector3f& normal,
+                                const SolidAngle<float>& diffusion) {
+  Material::TypeEnum type = Material::Type(mtl);
+  auto [exit_pdf, exit_normal, exit_dir] =
+      NextDirection(incident, point, normal, mtl, type, &diffusion);
+  return ReversePath{mtl, type, point, exit_normal, exit_dir, exit_pdf};
 }
 
 /**
@@ -44,10 +66,13 @@ std::optional<ReversePath> PathTracer::Run(const Ray<float>& incident_ray) {
  *                N
  */
 PathTracer::sample PathTracer::NextDirection(const Eigen::Vector3f& incident,
+                                             const Eigen::Vector3f& point,
                                              const Eigen::Vector3f& normal,
-                                             const Material& material) {
+                                             const Material& material,
+                                             Material::TypeEnum type,
+                                             const SolidAngle<float>* diffusion) {
   DASSERT(normal.dot(incident) != 0.0F, "incident parallel to the mesh should have been rejected");
-  switch (Material::Type(material)) {
+  switch (type) {
     case Material::TR:
       // refraction
       return SampleRefraction(incident, normal, material.Ni);
@@ -58,9 +83,18 @@ PathTracer::sample PathTracer::NextDirection(const Eigen::Vector3f& incident,
       break;
     case Material::DIFF:
       // diffusion
-      return SampleDiffusion(normal, material.Ns + 1.0F);
+      if (diffusion)
+        return SampleDiffusion(normal, *diffusion);
+      return std::visit(
+          [&](const auto& bxdf) {
+            if (m_guide)
+              return SampleGuided(bxdf, -incident, point, normal, material);
+            auto [direction, pdf] = bxdf.Sample(material, normal, -incident);
+            return sample{pdf, normal, direction};
+          },
+          m_bxdf);
       break;
-    default: return {0.0}; break;
+    default: return {0.0, normal}; break;
   }
 }
 
@@ -95,24 +129,41 @@ PathTracer::sample PathTracer::SampleRefraction(const Eigen::Vector3f& incident,
   }
 }
 
-PathTracer::sample PathTracer::SampleDiffusion(const Eigen::Vector3f& normal, float alpha) {
-  auto [azimuth, depression, pdf] = CosPowHemisphere<float>().Random(alpha);
-  DASSERT(depression < M_PI_2, "depression can not reach pi/2");
+PathTracer::sample PathTracer::SampleDiffusion(const Eigen::Vector3f& normal,
+                                                const SolidAngle<float>& sa) {
+  DASSERT(sa.cos_depression > 0.0F, "depression can not reach pi/2");
 
-  Eigen::Vector3f dir(std::sin(depression) * std::cos(azimuth),
-                      std::sin(depression) * std::sin(azimuth),
-                      std::cos(depression));
+  Eigen::Vector3f dir(sa.sin_depression * sa.cos_azimuth,
+                      sa.sin_depression * sa.sin_azimuth,
+                      sa.cos_depression);
 
-  Eigen::Index x;
-  normal.cwiseAbs().minCoeff(&x);
+  return {sa.pdf, normal, NormalFrame(normal) * dir};
+}
 
-  // find the plane coordinate system
-  Eigen::Matrix3f axes;
-  axes.col(2) = normal;
-  axes.col(1) = axes.col(2).cross(Eigen::Vector3f::Unit(x)).normalized();
-  axes.col(0) = axes.col(1).cross(axes.col(2)).normalized();
+template <typename BxDFImpl>
+PathTracer::sample PathTracer::SampleGuided(const BxDFImpl& bxdf,
+                                            const Eigen::Vector3f& wo,
+                                            const Eigen::Vector3f& point,
+                                            const Eigen::Vector3f& normal,
+                                            const Material& material) {
+  auto distribution = m_guide->Find(point);
+  if (distribution.learned()) {
+    // the PDF of the mixture is the one of the direction, whichever sampled it
+    double guide_prob = m_guide->options().guide_prob;
+    Eigen::Vector3f direction;
+    if (Uniform<double>().Random() < guide_prob)
+      direction = distribution.Sample();
+    else
+      direction = bxdf.Sample(material, normal, wo).direction;
+    double pdf = guide_prob * distribution.Pdf(direction) +
+                 (1.0 - guide_prob) * bxdf.Pdf(material, normal, direction, wo);
+    // a learned sample rounded over the edge of its quadrant may find no PDF
+    if (pdf > 0.0)
+      return {pdf, normal, direction};
+  }
 
-  return {pdf, normal, axes * dir};
+  auto [direction, pdf] = bxdf.Sample(material, normal, wo);
+  return {pdf, normal, direction};
 }
 
 }  // namespace mcpt
@@ -1,27 +1,36 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <optional>
+#include <variant>
 
 #include <Eigen/Eigen>
 
 #include "mcpt/common/geometry/bvh_tree.hpp"
 #include "mcpt/common/geometry/types.hpp"
 #include "mcpt/common/object/material.hpp"
+#include "mcpt/common/object/mesh.hpp"
 #include "mcpt/common/object/object.hpp"
+#include "mcpt/common/random.hpp"
 
+#include "mcpt/renderer/bxdf.hpp"
 #include "mcpt/renderer/ray_caster.hpp"
+#include "mcpt/renderer/sd_tree.hpp"
 
 namespace mcpt {
 
 struct ReversePath {
   std::reference_wrapper<const Material> material;  // surface material at the intersection
+  Material::TypeEnum type;  // of the material, see Material::Type
 
   Eigen::Vector3f point;   // intersection point
   Eigen::Vector3f normal;  // surface normal at the intersection
 
   Eigen::Vector3f exit_dir;
   double exit_pdf;
+
+  PrimitiveId primitive;  // mesh at the intersection
 };
 
 class PathTracer {
@@ -29,8 +38,33 @@ public:
   PathTracer(const Object& object, const BVHTree<float>& bvh_tree)
       : m_associated_object(object), m_ray_caster(bvh_tree) {}
 
-  // return the exit path at the intersection of the incident ray and the surface
-  std::optional<ReversePath> Run(const Ray<float>& incident_ray);
+  // the BxDF sampling the exit directions of the diffusive surfaces
+  void SetBxDF(const BxDF& bxdf) { m_bxdf = bxdf; }
+
+  // the learned incident radiance, mixed with the BxDF to sample the exit directions of the
+  // diffusive surfaces but the pre-generated ones
+  void SetPathGuide(std::shared_ptr<const SDTree> guide) { m_guide = std::move(guide); }
+
+  // return the exit path at the intersection of the incident ray and the surface, the ray leaving
+  // a surface excludes its mesh (see RayCaster::Run)
+  std::optional<ReversePath> Run(const Ray<float>& incident_ray,
+                                 const PrimitiveId& exclude = {});
+
+  // return the exit path at a known intersection point of the incident ray and the mesh, the normal
+  // is the world space one of the mesh (see RayCaster::Intersection)
+  ReversePath Scatter(const Eigen::Vector3f& incident,
+                      const Mesh& mesh,
+                      const Eigen::Vector3f& point,
+                      const Eigen::Vector3f& normal);
+
+  // same as above with the material of the mesh known, a diffusive surface takes the exit direction
+  // from a pre-generated cosine power sample of the power Ns+1, e.g. one of a batch (see
+  // CosPowHemisphere), i.e. the one Blinn-Phong BxDF samples
+  ReversePath Scatter(const Eigen::Vector3f& incident,
+                      const Material& mtl,
+                      const Eigen::Vector3f& point,
+                      const Eigen::Vector3f& normal,
+                      const SolidAngle<float>& diffusion);
 
 private:
   struct sample {
@@ -40,8 +74,11 @@ private:
   };
 
   sample NextDirection(const Eigen::Vector3f& incident,
+                       const Eigen::Vector3f& point,
                        const Eigen::Vector3f& normal,
-                       const Material& material);
+                       const Material& material,
+                       Material::TypeEnum type,
+                       const SolidAngle<float>* diffusion = nullptr);
 
   sample SampleReflection(const Eigen::Vector3f& incident, const Eigen::Vector3f& normal);
 
@@ -49,11 +86,21 @@ private:
                           const Eigen::Vector3f& normal,
                           float refr_k);
 
-  sample SampleDiffusion(const Eigen::Vector3f& normal, float alpha);
+  sample SampleDiffusion(const Eigen::Vector3f& normal, const SolidAngle<float>& sa);
+
+  // one sample of the mixture of the BxDF & the learned distribution at the point
+  template <typename BxDFImpl>
+  sample SampleGuided(const BxDFImpl& bxdf,
+                      const Eigen::Vector3f& wo,
+                      const Eigen::Vector3f& point,
+                      const Eigen::Vector3f& normal,
+                      const Material& material);
 
 private:
   std::reference_wrapper<const Object> m_associated_object;
   RayCaster m_ray_caster;
+  BxDF m_bxdf;
+  std::shared_ptr<const SDTree> m_guide;
 };
 
 }  // namespace mcpt
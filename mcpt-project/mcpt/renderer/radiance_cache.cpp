@@ -0,0 +1,104 @@
+#include "mcpt/renderer/radiance_cache.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "mcpt/common/assert.hpp"
+
+namespace mcpt {
+
+namespace {
+
+constexpr int COORD_BITS = 20;
+constexpr int64_t COORD_MASK = (int64_t(1) << COORD_BITS) - 1;
+// the keys of the occupied cells have the top bit set
+constexpr uint64_t OCCUPIED = uint64_t(1) << 63;
+
+// the finalizer of SplitMix64
+uint64_t Mix(uint64_t x) noexcept {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+}  // namespace
+
+RadianceCache::RadianceCache(const Options& options)
+    : m_options(options),
+      m_inv_cell_size(1.0F / options.cell_size),
+      m_num_sets(std::max<size_t>(1, options.num_cells / SET_SIZE)),
+      m_locks(new std::mutex[NUM_LOCKS]) {
+  ASSERT(options.cell_size > 0.0F, "non-positive cell size: {}", options.cell_size);
+  ASSERT(options.min_samples <= options.max_samples,
+         "the cells never reach {} samples with the max of {}",
+         options.min_samples,
+         options.max_samples);
+  m_cells.resize(m_num_sets * SET_SIZE);
+}
+
+void RadianceCache::Add(const Eigen::Vector3f& point,
+                        const Eigen::Vector3f& normal,
+                        const Eigen::Vector3f& irradiance) {
+  uint64_t key = Key(point, normal);
+  size_t set = Set(key);
+  Cell* first = &m_cells[set * SET_SIZE];
+  std::lock_guard lock(Lock(set));
+
+  // the cell of the key, or the one to be evicted
+  Cell* cell = std::find_if(first, first + SET_SIZE, [key](const Cell& c) { return c.key == key; });
+  if (cell == first + SET_SIZE) {
+    cell = std::min_element(first, first + SET_SIZE, [](const Cell& lhs, const Cell& rhs) {
+      return lhs.count < rhs.count;
+    });
+    *cell = Cell{key};
+  }
+
+  cell->sum += irradiance;
+  if (++cell->count >= m_options.max_samples) {
+    cell->sum *= 0.5F;
+    cell->count /= 2;
+  }
+}
+
+std::optional<Eigen::Vector3f> RadianceCache::Lookup(const Eigen::Vector3f& point,
+                                                     const Eigen::Vector3f& normal) const {
+  uint64_t key = Key(point, normal);
+  size_t set = Set(key);
+  const Cell* first = &m_cells[set * SET_SIZE];
+  std::lock_guard lock(Lock(set));
+
+  for (const Cell* cell = first; cell != first + SET_SIZE; ++cell) {
+    if (cell->key == key) {
+      if (cell->count < m_options.min_samples)
+        break;
+      return cell->sum / float(cell->count);
+    }
+  }
+  return std::nullopt;
+}
+
+void RadianceCache::Clear() {
+  for (size_t set = 0; set < m_num_sets; ++set) {
+    std::lock_guard lock(Lock(set));
+    std::fill_n(&m_cells[set * SET_SIZE], SET_SIZE, Cell{});
+  }
+}
+
+uint64_t RadianceCache::Key(const Eigen::Vector3f& point, const Eigen::Vector3f& normal) const {
+  uint64_t key = OCCUPIED;
+  for (int i = 0; i < 3; ++i) {
+    auto coord = int64_t(std::floor(point[i] * m_inv_cell_size));
+    key |= uint64_t(coord & COORD_MASK) << (i * COORD_BITS);
+  }
+  // the dominant axis of the normal & its sign, in [0, 6)
+  Eigen::Index axis;
+  normal.cwiseAbs().maxCoeff(&axis);
+  key |= uint64_t(axis * 2 + (normal[axis] < 0.0F)) << (3 * COORD_BITS);
+  return key;
+}
+
+size_t RadianceCache::Set(uint64_t key) const noexcept {
+  return Mix(key) % m_num_sets;
+}
+
+}  // namespace mcpt
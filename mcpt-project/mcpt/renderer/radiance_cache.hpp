@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+namespace mcpt {
+
+/**
+ * world-space hash grid of the indirect irradiance at the Lambertian surfaces
+ *
+ * the cells are keyed by the position quantized by `cell_size' & the dominant axis of the normal,
+ * so that the opposite faces of a thin wall never share a cell, & filled progressively by the
+ * irradiance estimated along the traced paths
+ *
+ * - bias: a cell answers the lookups once it holds `min_samples' samples, the smaller the cells &
+ *   the more samples, the less the bias, but the later the cache kicks in
+ * - invalidation: a cell keeps the weight of at most `max_samples' samples, halving its sums when
+ *   reaching it, so that the early estimates (gathered through a younger cache) fade out; `Clear'
+ *   drops everything, e.g. when the scene changes
+ * - memory: the table has `num_cells' cells in sets of SET_SIZE, a new cell evicts the one of the
+ *   fewest samples in its set
+ *
+ * thread safe, the sets are guarded by a pool of mutexes
+ */
+class RadianceCache {
+public:
+  static constexpr size_t SET_SIZE = 4;
+  static constexpr size_t NUM_LOCKS = 256;
+
+  struct Options {
+    float cell_size = 0.1F;
+    uint32_t min_samples = 32;
+    uint32_t max_samples = 1024;
+    size_t num_cells = 1 << 20;
+    // number of the path vertices from where the lookups end the paths, the vertex 1 being the
+    // first hit from the eye
+    unsigned int min_depth = 2;
+  };
+
+  explicit RadianceCache(const Options& options);
+
+  // add a sample of the irradiance at a point of the given normal
+  void Add(const Eigen::Vector3f& point,
+           const Eigen::Vector3f& normal,
+           const Eigen::Vector3f& irradiance);
+  // the mean irradiance of the cell of a point, if it holds enough samples
+  std::optional<Eigen::Vector3f> Lookup(const Eigen::Vector3f& point,
+                                        const Eigen::Vector3f& normal) const;
+  void Clear();
+
+  auto& options() const noexcept { return m_options; }
+
+private:
+  struct Cell {
+    uint64_t key = 0;  // zero if empty
+    uint32_t count = 0;
+    Eigen::Vector3f sum{Eigen::Vector3f::Zero()};
+  };
+
+  uint64_t Key(const Eigen::Vector3f& point, const Eigen::Vector3f& normal) const;
+  size_t Set(uint64_t key) const noexcept;
+  std::mutex& Lock(size_t set) const noexcept { return m_locks[set % NUM_LOCKS]; }
+
+private:
+  Options m_options;
+  float m_inv_cell_size;
+
+  std::vector<Cell> m_cells;
+  size_t m_num_sets;
+  std::unique_ptr<std::mutex[]> m_locks;
+};
+
+}  // namespace mcpt
@@ -0,0 +1,81 @@
+#include "mcpt/renderer/radiance_cache.hpp"
+
+#include <Eigen/Eigen>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("radiance cache answers by the mean of its cells", "[radiance_cache]") {
+
+mcpt::RadianceCache::Options options;
+options.cell_size = 0.5F;
+options.min_samples = 4;
+options.num_cells = 64;
+mcpt::RadianceCache cache(options);
+
+Eigen::Vector3f up = Eigen::Vector3f::UnitY();
+Eigen::Vector3f p(0.1F, 0.2F, 0.3F);
+for (int i = 0; i < 3; ++i)
+  cache.Add(p, up, Eigen::Vector3f(1.0F, 2.0F, 3.0F));
+// too few samples yet
+REQUIRE(!cache.Lookup(p, up).has_value());
+
+cache.Add(Eigen::Vector3f(0.4F, 0.4F, 0.4F),
+          Eigen::Vector3f(0.1F, 0.9F, -0.2F).normalized(),
+          Eigen::Vector3f(5.0F, 6.0F, 7.0F));
+auto irradiance = cache.Lookup(Eigen::Vector3f(0.0F, 0.49F, 0.0F), up);
+REQUIRE(irradiance.has_value());
+CHECK(irradiance.value().x() == Catch::Approx(2.0F));
+CHECK(irradiance.value().y() == Catch::Approx(3.0F));
+CHECK(irradiance.value().z() == Catch::Approx(4.0F));
+
+// the neighbour cells & the opposite faces are apart
+CHECK(!cache.Lookup(Eigen::Vector3f(0.1F, 0.2F, -0.3F), up).has_value());
+CHECK(!cache.Lookup(p, -up).has_value());
+
+cache.Clear();
+CHECK(!cache.Lookup(p, up).has_value());
+
+}
+
+TEST_CASE("radiance cache forgets the old samples", "[radiance_cache]") {
+
+mcpt::RadianceCache::Options options;
+options.min_samples = 4;
+options.max_samples = 8;
+options.num_cells = 64;
+mcpt::RadianceCache cache(options);
+
+Eigen::Vector3f p = Eigen::Vector3f::Zero();
+Eigen::Vector3f n = Eigen::Vector3f::UnitZ();
+for (int i = 0; i < 8; ++i)
+  cache.Add(p, n, Eigen::Vector3f::Ones());
+for (int i = 0; i < 100; ++i)
+  cache.Add(p, n, Eigen::Vector3f::Zero());
+// the weight of the first samples is halved for every 4 new ones
+CHECK(cache.Lookup(p, n).value().maxCoeff() < 1.0e-3F);
+
+}
+
+TEST_CASE("radiance cache evicts the cells of the fewest samples", "[radiance_cache]") {
+
+mcpt::RadianceCache::Options options;
+options.cell_size = 1.0F;
+options.min_samples = 1;
+options.num_cells = mcpt::RadianceCache::SET_SIZE;
+mcpt::RadianceCache cache(options);
+
+// one set for all the cells, the first one is the most sampled
+constexpr int SET_SIZE = mcpt::RadianceCache::SET_SIZE;
+Eigen::Vector3f n = Eigen::Vector3f::UnitX();
+cache.Add(Eigen::Vector3f::Zero(), n, Eigen::Vector3f::Ones());
+for (int i = 0; i <= SET_SIZE; ++i)
+  cache.Add(Eigen::Vector3f(float(i), 0.0F, 0.0F), n, Eigen::Vector3f::Ones());
+
+CHECK(cache.Lookup(Eigen::Vector3f::Zero(), n).has_value());
+CHECK(cache.Lookup(Eigen::Vector3f(float(SET_SIZE), 0.0F, 0.0F), n).has_value());
+int num_evicted = 0;
+for (int i = 1; i < SET_SIZE; ++i)
+  num_evicted += !cache.Lookup(Eigen::Vector3f(float(i), 0.0F, 0.0F), n).has_value();
+CHECK(num_evicted == 1);
+
+}
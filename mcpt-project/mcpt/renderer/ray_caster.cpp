@@ -2,73 +2,304 @@
 
 #include <cmath>
 #include <any>
+#include <array>
 #include <deque>
+#include <utility>
+#include <vector>
+
+#include "mcpt/common/stats.hpp"
 
 namespace mcpt {
 
 namespace {
 
-// threshold for rejecting self when doing intersection test
-constexpr float MIN_PROJECTION_LENGTH = 0.001F;
+thread_local uint64_t t_traversal_steps = 0;
+
+// return the instance if the leaf node of the top level tree refers to a bottom level tree
+const BVHInstance<float>* as_instance(const BVHNode<float>* node) {
+  auto instance = std::any_cast<std::reference_wrapper<const BVHInstance<float>>>(&node->mesh);
+  return instance ? &instance->get() : nullptr;
+}
+
+// push the children hit by the ray, the farther one first so that the nearer one is popped first
+template <typename Node>
+void push_near_first(std::vector<std::pair<Node, float>>& stack,
+                     const std::array<Node, 2>& children,
+                     const std::array<float, 2>& t_enter,
+                     const std::array<bool, 2>& hits) {
+  if (hits[0] && hits[1]) {
+    int near = t_enter[1] < t_enter[0];
+    stack.emplace_back(children[1 - near], t_enter[1 - near]);
+    stack.emplace_back(children[near], t_enter[near]);
+  } else if (hits[0] || hits[1]) {
+    int hit = hits[1];
+    stack.emplace_back(children[hit], t_enter[hit]);
+  }
+}
+
+// transform the ray into the space of the instance
+Ray<float> to_local(const Ray<float>& ray, const BVHInstance<float>& instance) {
+  return Ray<float>(instance.to_local * ray.point_a, instance.to_local.linear() * ray.direction);
+}
 
 }  // namespace
 
-RayCaster::Intersection RayCaster::Run(const Ray<float>& ray) const {
+RayCaster::Intersection RayCaster::Run(const Ray<float>& ray, const PrimitiveId& exclude) const {
+  STATS_INC(CLOSEST_HIT_RAYS);
   Intersection ret;
-  float max_abs_cos_incident = 0.0F;
 
   // compute intersection with all the meshes and select the closest one
-  for (std::deque queue{m_bvh_tree.get().root.get()}; !queue.empty(); queue.pop_front()) {
-    auto node = queue.front();
-    if (!m_intersect.Test(ray, node->aabb))
+  uint64_t steps = 0;
+  if (m_quantized_bvh)
+    TraverseQuantized(ray, exclude, ret, steps);
+  else
+    Traverse(ray, m_bvh_tree.get().root.get(), nullptr, exclude, ret, steps);
+
+  STATS_ADD(NODE_VISITS, steps);
+  t_traversal_steps += steps;
+  return ret;
+}
+
+void RayCaster::Traverse(const Ray<float>& ray,
+                         const BVHNode<float>* root,
+                         const BVHInstance<float>* instance,
+                         const PrimitiveId& exclude,
+                         Intersection& ret,
+                         uint64_t& steps) const {
+  ++steps;
+  float t_enter;
+  float t_exit;
+  if (!m_intersect.Test(ray, root->aabb, t_enter, t_exit))
+    return;
+
+  // depth first & the nearer child first, so that the closest mesh found early culls the farther
+  // nodes
+  std::vector<std::pair<const BVHNode<float>*, float>> stack{{root, t_enter}};
+  while (!stack.empty()) {
+    auto [node, node_t_enter] = stack.back();
+    stack.pop_back();
+    // cull the nodes behind the closest mesh so far, the distances along the ray are in the world
+    // space only out of the instances
+    if (!instance && node_t_enter > ret.distance)
+      continue;
+
+    // is leaf node
+    if (node->mesh.has_value()) {
+      VisitLeaf(ray, node, instance, exclude, ret, steps);
+      continue;
+    }
+
+    std::array<const BVHNode<float>*, 2> children = {node->l_child.get(), node->r_child.get()};
+    std::array<float, 2> children_t_enter;
+    std::array<bool, 2> hits;
+    for (int i = 0; i < 2; ++i) {
+      ++steps;
+      hits[i] = children[i] &&
+                m_intersect.Test(ray, children[i]->aabb, children_t_enter[i], t_exit);
+    }
+    push_near_first(stack, children, children_t_enter, hits);
+  }
+}
+
+void RayCaster::TraverseQuantized(const Ray<float>& ray,
+                                  const PrimitiveId& exclude,
+                                  Intersection& ret,
+                                  uint64_t& steps) const {
+  const auto& quantized_bvh = *m_quantized_bvh;
+  ++steps;
+  float t_enter;
+  float t_exit;
+  if (!m_intersect.Test(ray, quantized_bvh.aabb(), t_enter, t_exit))
+    return;
+
+  // depth first & the nearer child first as Traverse does
+  std::vector<std::pair<uint32_t, float>> stack{{quantized_bvh.root(), t_enter}};
+  while (!stack.empty()) {
+    auto [index, node_t_enter] = stack.back();
+    stack.pop_back();
+    if (node_t_enter > ret.distance)
+      continue;
+    if (QuantizedBVH<float>::IsLeaf(index)) {
+      VisitLeaf(ray, quantized_bvh.GetLeaf(index), nullptr, exclude, ret, steps);
+      continue;
+    }
+
+    const auto& node = quantized_bvh.nodes()[index];
+    std::array<float, 2> children_t_enter;
+    std::array<bool, 2> hits;
+    for (int i = 0; i < 2; ++i) {
+      ++steps;
+      hits[i] = m_intersect.Test(
+          ray, quantized_bvh.GetChildBounds(node, i), children_t_enter[i], t_exit);
+    }
+    push_near_first(stack, node.children, children_t_enter, hits);
+  }
+}
+
+void RayCaster::VisitLeaf(const Ray<float>& ray,
+                          const BVHNode<float>* node,
+                          const BVHInstance<float>* instance,
+                          const PrimitiveId& exclude,
+                          Intersection& ret,
+                          uint64_t& steps) const {
+  if (auto leaf_instance = as_instance(node)) {
+    DASSERT(!instance, "instances can not be nested");
+    Traverse(to_local(ray, *leaf_instance),
+             leaf_instance->bvh_tree.get().root.get(),
+             leaf_instance,
+             exclude,
+             ret,
+             steps);
+  } else {
+    TestLeaf(ray, node, instance, exclude, ret);
+  }
+}
+
+template <int N>
+void RayCaster::Run(const RayPacket<float, N>& packet, Intersection hits[]) const {
+  using Mask = typename RayPacket<float, N>::Mask;
+
+  STATS_ADD(CLOSEST_HIT_RAYS, packet.size());
+  for (int i = 0; i < packet.size(); ++i)
+    hits[i] = Intersection{};
+
+  // each node is visited with the rays of the packet still alive
+  std::deque<std::pair<const BVHNode<float>*, Mask>> queue;
+  queue.emplace_back(m_bvh_tree.get().root.get(), packet.active);
+  for (; !queue.empty(); queue.pop_front()) {
+    auto [node, parent_mask] = queue.front();
+
+    // cull the whole packet, or the rays which have found closer meshes
+    Eigen::Array<float, N, 1> t_enter;
+    Mask mask = m_intersect.Test(packet, node->aabb, t_enter) && parent_mask;
+    STATS_ADD(NODE_VISITS, parent_mask.count());
+    t_traversal_steps += parent_mask.count();
+    for (int i = 0; i < packet.size(); ++i)
+      mask.coeffRef(i) = mask.coeff(i) && t_enter.coeff(i) <= hits[i].distance;
+    if (!mask.any())
       continue;
+
     if (node->l_child)
-      queue.push_back(node->l_child.get());
+      queue.emplace_back(node->l_child.get(), mask);
     if (node->r_child)
-      queue.push_back(node->r_child.get());
+      queue.emplace_back(node->r_child.get(), mask);
 
     // is leaf node
-    if (node->mesh.has_value()) {
-      const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(node->mesh);
-
-      // no intersection
-      Eigen::Vector4f point_h = m_intersect.Get(ray, mesh.polygon);
-      if (point_h.w() == 0.0F)
-        continue;
-
-      // reject self
-      Eigen::Vector3f segment = point_h.head<3>() - ray.point_a;
-      if (std::abs(segment.dot(mesh.normal)) <= MIN_PROJECTION_LENGTH)
-        continue;
-
-      // reject farther mesh
-      float distance = segment.norm();
-      if (distance > ret.distance)
-        continue;
-
-      // take closer mesh
-      float abs_cos_incident = std::abs(ray.direction.dot(mesh.normal));
-      if (distance < ret.distance || abs_cos_incident > max_abs_cos_incident) {
-        max_abs_cos_incident = abs_cos_incident;
-        ret.distance = distance;
-        ret.point = point_h.head<3>();
-        ret.node = node;
+    if (!node->mesh.has_value())
+      continue;
+    if (auto instance = as_instance(node)) {
+      // the rays of the packet leave the instance one by one
+      uint64_t steps = 0;
+      for (int i = 0; i < packet.size(); ++i) {
+        if (mask.coeff(i)) {
+          Traverse(to_local(packet.rays[i], *instance),
+                   instance->bvh_tree.get().root.get(),
+                   instance,
+                   {},
+                   hits[i],
+                   steps);
+        }
+      }
+      STATS_ADD(NODE_VISITS, steps);
+      t_traversal_steps += steps;
+    } else {
+      for (int i = 0; i < packet.size(); ++i) {
+        if (mask.coeff(i))
+          TestLeaf(packet.rays[i], node, nullptr, {}, hits[i]);
       }
     }
   }
+}
 
-  return ret;
+template void RayCaster::Run(const RayPacket<float, 4>&, Intersection[]) const;
+template void RayCaster::Run(const RayPacket<float, 8>&, Intersection[]) const;
+template void RayCaster::Run(const RayPacket<float, 16>&, Intersection[]) const;
+
+void RayCaster::TestLeaf(const Ray<float>& ray,
+                         const BVHNode<float>* node,
+                         const BVHInstance<float>* instance,
+                         const PrimitiveId& exclude,
+                         Intersection& ret) const {
+  const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(node->mesh);
+  STATS_INC(LEAF_VISITS);
+  // reject self
+  PrimitiveId primitive{&mesh, instance};
+  if (primitive == exclude)
+    return;
+
+  // no intersection
+  STATS_INC(POLYGON_TESTS);
+  Eigen::Vector4f point_h = m_intersect.Get(ray, mesh.polygon);
+  if (point_h.w() == 0.0F)
+    return;
+
+  Eigen::Vector3f segment = point_h.head<3>() - ray.point_a;
+
+  // back to the world space
+  Eigen::Vector3f point = point_h.head<3>();
+  Eigen::Vector3f normal = mesh.normal;
+  Eigen::Vector3f direction = ray.direction;
+  if (instance) {
+    point = instance->to_world * point;
+    segment = instance->to_world.linear() * segment;
+    normal = (instance->normal_to_world * normal).normalized();
+    direction = (instance->to_world.linear() * direction).normalized();
+  }
+
+  // reject farther mesh
+  float distance = segment.norm();
+  if (distance > ret.distance)
+    return;
+
+  // take closer mesh
+  float abs_cos_incident = std::abs(direction.dot(normal));
+  if (distance < ret.distance || abs_cos_incident > ret.abs_cos_incident) {
+    ret.abs_cos_incident = abs_cos_incident;
+    ret.distance = distance;
+    ret.point = point;
+    ret.normal = normal;
+    ret.node = node;
+    ret.primitive = primitive;
+  }
 }
 
 Eigen::Vector4f RayCaster::IntersectPlane(const Ray<float>& ray, const Plane<float>& plane) const {
   return m_intersect.Get(ray, plane);
 }
 
-bool RayCaster::IsBlocked(const Ray<float>& ray, const Mesh& target, float distance) const {
-  // compute intersection with all the meshes and select the closest one
-  for (std::deque queue{m_bvh_tree.get().root.get()}; !queue.empty(); queue.pop_front()) {
+bool RayCaster::IsBlocked(const Ray<float>& ray,
+                          const Mesh& target,
+                          float distance,
+                          const PrimitiveId& exclude) const {
+  STATS_INC(SHADOW_RAYS);
+  uint64_t steps = 0;
+  bool blocked =
+      m_quantized_bvh
+          ? TraverseQuantizedShadow(ray, target, distance, exclude, steps)
+          : TraverseShadow(
+                ray, m_bvh_tree.get().root.get(), nullptr, target, distance, exclude, steps);
+  STATS_ADD(NODE_VISITS, steps);
+  t_traversal_steps += steps;
+  return blocked;
+}
+
+bool RayCaster::TraverseShadow(const Ray<float>& ray,
+                               const BVHNode<float>* root,
+                               const BVHInstance<float>* instance,
+                               const Mesh& target,
+                               float distance,
+                               const PrimitiveId& exclude,
+                               uint64_t& steps) const {
+  // stop at any mesh in between
+  for (std::deque queue{root}; !queue.empty(); queue.pop_front()) {
     auto node = queue.front();
-    if (!m_intersect.Test(ray, node->aabb))
+    ++steps;
+    float t_enter;
+    float t_exit;
+    if (!m_intersect.Test(ray, node->aabb, t_enter, t_exit))
+      continue;
+    // cull the nodes behind the target
+    if (!instance && t_enter > distance)
       continue;
     if (node->l_child)
       queue.push_back(node->l_child.get());
@@ -76,28 +307,85 @@ bool RayCaster::IsBlocked(const Ray<float>& ray, const Mesh& target, float dista
       queue.push_back(node->r_child.get());
 
     // is leaf node
-    if (node->mesh.has_value()) {
-      const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(node->mesh);
-      // reject target mesh
-      if (&mesh == &target)
-        continue;
-
-      // no intersection
-      Eigen::Vector4f point_h = m_intersect.Get(ray, mesh.polygon);
-      if (point_h.w() == 0.0F)
-        continue;
-
-      // reject self
-      Eigen::Vector3f segment = point_h.head<3>() - ray.point_a;
-      if (std::abs(segment.dot(mesh.normal)) <= MIN_PROJECTION_LENGTH)
-        continue;
-
-      if (segment.norm() <= distance - MIN_PROJECTION_LENGTH)
+    if (node->mesh.has_value() &&
+        VisitShadowLeaf(ray, node, instance, target, distance, exclude, steps))
+      return true;
+  }
+  return false;
+}
+
+bool RayCaster::TraverseQuantizedShadow(const Ray<float>& ray,
+                                        const Mesh& target,
+                                        float distance,
+                                        const PrimitiveId& exclude,
+                                        uint64_t& steps) const {
+  const auto& quantized_bvh = *m_quantized_bvh;
+  ++steps;
+  if (!m_intersect.Test(ray, quantized_bvh.aabb()))
+    return false;
+
+  // stop at any mesh in between
+  for (std::deque queue{quantized_bvh.root()}; !queue.empty(); queue.pop_front()) {
+    uint32_t index = queue.front();
+    if (QuantizedBVH<float>::IsLeaf(index)) {
+      const BVHNode<float>* leaf = quantized_bvh.GetLeaf(index);
+      if (VisitShadowLeaf(ray, leaf, nullptr, target, distance, exclude, steps))
         return true;
+      continue;
     }
-  }
 
+    const auto& node = quantized_bvh.nodes()[index];
+    for (int i = 0; i < 2; ++i) {
+      ++steps;
+      float t_enter;
+      float t_exit;
+      if (m_intersect.Test(ray, quantized_bvh.GetChildBounds(node, i), t_enter, t_exit) &&
+          t_enter <= distance)
+        queue.push_back(node.children[i]);
+    }
+  }
   return false;
 }
 
+bool RayCaster::VisitShadowLeaf(const Ray<float>& ray,
+                                const BVHNode<float>* node,
+                                const BVHInstance<float>* instance,
+                                const Mesh& target,
+                                float distance,
+                                const PrimitiveId& exclude,
+                                uint64_t& steps) const {
+  if (auto leaf_instance = as_instance(node)) {
+    DASSERT(!instance, "instances can not be nested");
+    return TraverseShadow(to_local(ray, *leaf_instance),
+                          leaf_instance->bvh_tree.get().root.get(),
+                          leaf_instance,
+                          target,
+                          distance,
+                          exclude,
+                          steps);
+  }
+
+  const Mesh& mesh = std::any_cast<std::reference_wrapper<const Mesh>>(node->mesh);
+  STATS_INC(LEAF_VISITS);
+  // reject self & target mesh
+  if (PrimitiveId{&mesh, instance} == exclude || &mesh == &target)
+    return false;
+
+  // no intersection
+  STATS_INC(POLYGON_TESTS);
+  Eigen::Vector4f point_h = m_intersect.Get(ray, mesh.polygon);
+  if (point_h.w() == 0.0F)
+    return false;
+
+  // back to the world space
+  Eigen::Vector3f segment = point_h.head<3>() - ray.point_a;
+  if (instance)
+    segment = instance->to_world.linear() * segment;
+  return segment.norm() < distance;
+}
+
+uint64_t RayCaster::traversal_steps() noexcept {
+  return t_traversal_steps;
+}
+
 }  // namespace mcpt
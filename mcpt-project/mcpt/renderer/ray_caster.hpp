@@ -1,23 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <limits>
 
 #include <Eigen/Eigen>
 
+#include "mcpt/common/geometry/bvh_instance.hpp"
 #include "mcpt/common/geometry/bvh_tree.hpp"
 #include "mcpt/common/geometry/intersect.hpp"
+#include "mcpt/common/geometry/quantized_bvh.hpp"
+#include "mcpt/common/geometry/ray_packet.hpp"
 #include "mcpt/common/geometry/types.hpp"
 #include "mcpt/common/object/mesh.hpp"
 
 namespace mcpt {
 
+// a mesh in the world, the meshes of a prototype are shared by all its instances
+struct PrimitiveId {
+  const Mesh* mesh = nullptr;
+  const BVHInstance<float>* instance = nullptr;
+
+  bool operator==(const PrimitiveId& other) const noexcept {
+    return mesh == other.mesh && instance == other.instance;
+  }
+};
+
 class RayCaster {
 public:
   struct Intersection {
     float distance = std::numeric_limits<float>::max();
     Eigen::Vector3f point{Eigen::Vector3f::Zero()};
+    // surface normal in the world space, differs from the mesh normal if the mesh is instanced
+    Eigen::Vector3f normal{Eigen::Vector3f::Zero()};
+    // leaf node of the mesh, which belongs to the bottom level tree if the mesh is instanced
     const BVHNode<float>* node = nullptr;
+    // mesh of the leaf node & its instance, the rays spawned at the intersection exclude it
+    PrimitiveId primitive;
+    // breaks ties between meshes at the same distance
+    float abs_cos_incident = 0.0F;
   };
 
   explicit RayCaster(const BVHTree<float>& bvh_tree)
@@ -25,13 +46,82 @@ public:
 
   RayCaster(const BVHTree<float>& bvh_tree, float prec) : m_bvh_tree(bvh_tree), m_intersect(prec) {}
 
-  Intersection Run(const Ray<float>& ray) const;
+  // traverse the compressed copy of the tree for single rays, the packets & the bottom level trees
+  // of the instances still traverse the uncompressed nodes
+  RayCaster(const BVHTree<float>& bvh_tree, const QuantizedBVH<float>& quantized_bvh)
+      : RayCaster(bvh_tree) {
+    m_quantized_bvh = &quantized_bvh;
+  }
+
+  // the rays leaving a surface exclude its mesh, which saves testing it & can not hit it again
+  Intersection Run(const Ray<float>& ray, const PrimitiveId& exclude = {}) const;
+
+  // trace a packet of coherent rays together, the i-th intersection is written to hits[i]
+  template <int N>
+  void Run(const RayPacket<float, N>& packet, Intersection hits[]) const;
 
   Eigen::Vector4f IntersectPlane(const Ray<float>& ray, const Plane<float>& plane) const;
-  bool IsBlocked(const Ray<float>& ray, const Mesh& target, float distance) const;
+  bool IsBlocked(const Ray<float>& ray,
+                 const Mesh& target,
+                 float distance,
+                 const PrimitiveId& exclude = {}) const;
+
+  // number of BVH nodes visited by the rays cast on the calling thread so far
+  // the difference between two calls is the traversal cost of the rays cast in between
+  static uint64_t traversal_steps() noexcept;
 
 private:
+  // the ray is in the space of the instance when traversing a bottom level tree
+  void Traverse(const Ray<float>& ray,
+                const BVHNode<float>* root,
+                const BVHInstance<float>* instance,
+                const PrimitiveId& exclude,
+                Intersection& ret,
+                uint64_t& steps) const;
+
+  bool TraverseShadow(const Ray<float>& ray,
+                      const BVHNode<float>* root,
+                      const BVHInstance<float>* instance,
+                      const Mesh& target,
+                      float distance,
+                      const PrimitiveId& exclude,
+                      uint64_t& steps) const;
+
+  // the children boxes are decoded & tested before pushing them
+  void TraverseQuantized(const Ray<float>& ray,
+                         const PrimitiveId& exclude,
+                         Intersection& ret,
+                         uint64_t& steps) const;
+  bool TraverseQuantizedShadow(const Ray<float>& ray,
+                               const Mesh& target,
+                               float distance,
+                               const PrimitiveId& exclude,
+                               uint64_t& steps) const;
+
+  // descend into the bottom level tree if the leaf node refers to an instance
+  void VisitLeaf(const Ray<float>& ray,
+                 const BVHNode<float>* node,
+                 const BVHInstance<float>* instance,
+                 const PrimitiveId& exclude,
+                 Intersection& ret,
+                 uint64_t& steps) const;
+  bool VisitShadowLeaf(const Ray<float>& ray,
+                       const BVHNode<float>* node,
+                       const BVHInstance<float>* instance,
+                       const Mesh& target,
+                       float distance,
+                       const PrimitiveId& exclude,
+                       uint64_t& steps) const;
+
+  // update the intersection if the ray hits the mesh of the leaf node closer
+  void TestLeaf(const Ray<float>& ray,
+                const BVHNode<float>* node,
+                const BVHInstance<float>* instance,
+                const PrimitiveId& exclude,
+                Intersection& ret) const;
+
   std::reference_wrapper<const BVHTree<float>> m_bvh_tree;
+  const QuantizedBVH<float>* m_quantized_bvh = nullptr;
   Intersect<float> m_intersect;
 };
 
@@ -0,0 +1,88 @@
+#include "mcpt/renderer/ray_caster.hpp"
+
+#include <deque>
+
+#include <benchmark/benchmark.h>
+
+#include "mcpt/common/geometry/quantized_bvh.hpp"
+#include "mcpt/common/object/bench_helper.hpp"
+
+namespace {
+
+using mcpt::bench::GetRandomScene;
+
+// bytes of the uncompressed nodes, excluding the allocator overhead of each node
+size_t GetMemoryUsage(const mcpt::BVHTree<float>& bvh_tree) {
+  size_t num_nodes = 0;
+  for (std::deque queue{bvh_tree.root.get()}; !queue.empty(); queue.pop_front()) {
+    auto node = queue.front();
+    ++num_nodes;
+    if (node->l_child)
+      queue.push_back(node->l_child.get());
+    if (node->r_child)
+      queue.push_back(node->r_child.get());
+  }
+  return num_nodes * sizeof(mcpt::BVHNode<float>);
+}
+
+void BM_RayCasterRun(benchmark::State& state) {
+  const auto& scene = GetRandomScene(state.range(0));
+  mcpt::RayCaster ray_caster(scene.bvh_tree);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ray_caster.Run(scene.rays[i % scene.rays.size()]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bvh_bytes"] = GetMemoryUsage(scene.bvh_tree);
+}
+BENCHMARK(BM_RayCasterRun)->RangeMultiplier(10)->Range(1'000, 10'000'000);
+
+void BM_RayCasterRunQuantized(benchmark::State& state) {
+  const auto& scene = GetRandomScene(state.range(0));
+  mcpt::QuantizedBVH<float> quantized_bvh(scene.bvh_tree);
+  mcpt::RayCaster ray_caster(scene.bvh_tree, quantized_bvh);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ray_caster.Run(scene.rays[i % scene.rays.size()]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bvh_bytes"] = quantized_bvh.GetMemoryUsage();
+}
+BENCHMARK(BM_RayCasterRunQuantized)->RangeMultiplier(10)->Range(1'000, 10'000'000);
+
+void BM_RayCasterIsBlocked(benchmark::State& state) {
+  const auto& scene = GetRandomScene(state.range(0));
+  mcpt::RayCaster ray_caster(scene.bvh_tree);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t k = i % scene.rays.size();
+    benchmark::DoNotOptimize(
+        ray_caster.IsBlocked(scene.rays[k], *scene.targets[k], scene.distances[k]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RayCasterIsBlocked)->RangeMultiplier(10)->Range(1'000, 10'000'000);
+
+void BM_RayCasterIsBlockedQuantized(benchmark::State& state) {
+  const auto& scene = GetRandomScene(state.range(0));
+  mcpt::QuantizedBVH<float> quantized_bvh(scene.bvh_tree);
+  mcpt::RayCaster ray_caster(scene.bvh_tree, quantized_bvh);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t k = i % scene.rays.size();
+    benchmark::DoNotOptimize(
+        ray_caster.IsBlocked(scene.rays[k], *scene.targets[k], scene.distances[k]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RayCasterIsBlockedQuantized)->RangeMultiplier(10)->Range(1'000, 10'000'000);
+
+}  // namespace
@@ -0,0 +1,80 @@
+#include "mcpt/renderer/ray_sorter.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "mcpt/common/assert.hpp"
+
+namespace mcpt {
+
+RaySorter::RaySorter(const AABB<float>& scene_aabb) : m_min_vertex(scene_aabb.min_vertex()) {
+  // avoid dividing by zero for flat scenes
+  Eigen::Vector3f diagonal = scene_aabb.GetDiagonal().cwiseMax(Eigen::NumTraits<float>::epsilon());
+  m_inv_diagonal = diagonal.cwiseInverse();
+}
+
+/**
+ *  63          33 32  30 29                                      0
+ *  +-------------+------+----------------------------------------+
+ *  |   (unused)  |octant| z9 y9 x9 z8 y8 x8 ... z0 y0 x0 (morton) |
+ *  +-------------+------+----------------------------------------+
+ */
+uint64_t RaySorter::Key(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction) const {
+  static constexpr float MAX_CELL = (1U << MORTON_BITS) - 1U;
+
+  Eigen::Vector3f cell = (origin - m_min_vertex).cwiseProduct(m_inv_diagonal) * MAX_CELL;
+  cell = cell.cwiseMax(0.0F).cwiseMin(MAX_CELL);
+
+  uint64_t morton = ExpandBits(static_cast<uint64_t>(cell.x())) |
+                    ExpandBits(static_cast<uint64_t>(cell.y())) << 1 |
+                    ExpandBits(static_cast<uint64_t>(cell.z())) << 2;
+  uint64_t octant = (direction.x() < 0.0F) | (direction.y() < 0.0F) << 1 |
+                    (direction.z() < 0.0F) << 2;
+  return octant << (3 * MORTON_BITS) | morton;
+}
+
+RaySorter::Coherence RaySorter::Sort(const std::vector<Eigen::Vector3f>& origin,
+                                     const std::vector<Eigen::Vector3f>& direction,
+                                     std::vector<unsigned int>& order) const {
+  DASSERT(origin.size() == direction.size());
+
+  std::vector<uint64_t> keys(origin.size());
+  for (size_t i = 0; i < keys.size(); ++i)
+    keys[i] = Key(origin[i], direction[i]);
+
+  order.resize(keys.size());
+  std::iota(order.begin(), order.end(), 0U);
+
+  Coherence coherence;
+  coherence.before = MeasureCoherence(keys, order);
+  std::sort(order.begin(), order.end(), [&keys](auto lhs, auto rhs) {
+    return keys[lhs] < keys[rhs];
+  });
+  coherence.after = MeasureCoherence(keys, order);
+  return coherence;
+}
+
+// insert two zero bits after each of the lower 10 bits
+uint64_t RaySorter::ExpandBits(uint64_t v) {
+  v = (v * 0x00010001U) & 0xFF0000FFU;
+  v = (v * 0x00000101U) & 0x0F00F00FU;
+  v = (v * 0x00000011U) & 0xC30C30C3U;
+  v = (v * 0x00000005U) & 0x49249249U;
+  return v;
+}
+
+double RaySorter::MeasureCoherence(const std::vector<uint64_t>& keys,
+                                   const std::vector<unsigned int>& order) {
+  if (order.size() < 2)
+    return 1.0;
+
+  // the octant and the higher bits of the morton code identify a coarse bin
+  static constexpr unsigned int SHIFT = 3 * (MORTON_BITS - COHERENCE_BITS);
+
+  size_t num_coherent = 0;
+  for (size_t i = 1; i < order.size(); ++i)
+    num_coherent += (keys[order[i - 1]] >> SHIFT) == (keys[order[i]] >> SHIFT);
+  return static_cast<double>(num_coherent) / (order.size() - 1);
+}
+
+}  // namespace mcpt
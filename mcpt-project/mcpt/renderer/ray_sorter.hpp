@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/geometry/aabb.hpp"
+
+namespace mcpt {
+
+// bin & sort incoherent rays before traversal
+//
+// each ray is keyed by its direction octant followed by the Morton code of its origin cell in the
+// scene AABB, sorting by the key makes consecutive rays start nearby and head similar directions
+class RaySorter {
+public:
+  // number of bits per axis of the origin cell
+  static constexpr unsigned int MORTON_BITS = 10;
+  // cells at this level (bits per axis) are used to measure coherence
+  static constexpr unsigned int COHERENCE_BITS = 3;
+
+  // fraction of consecutive rays falling into the same bin (octant + coarse origin cell)
+  struct Coherence {
+    double before = 0.0;
+    double after = 0.0;
+
+    double gain() const noexcept { return before > 0.0 ? after / before : 0.0; }
+  };
+
+  explicit RaySorter(const AABB<float>& scene_aabb);
+
+  // write the indices of the rays in sorted order to `order'
+  Coherence Sort(const std::vector<Eigen::Vector3f>& origin,
+                 const std::vector<Eigen::Vector3f>& direction,
+                 std::vector<unsigned int>& order) const;
+
+  uint64_t Key(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction) const;
+
+private:
+  static uint64_t ExpandBits(uint64_t v);
+  static double MeasureCoherence(const std::vector<uint64_t>& keys,
+                                 const std::vector<unsigned int>& order);
+
+  Eigen::Vector3f m_min_vertex;
+  Eigen::Vector3f m_inv_diagonal;
+};
+
+}  // namespace mcpt
@@ -0,0 +1,93 @@
+#include "mcpt/renderer/ray_sorter.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcpt/common/geometry/aabb.hpp"
+
+TEST_CASE("ray sorter", "[renderer][ray_sorter]") {
+
+mcpt::AABB<float> aabb(Eigen::Vector3f(-1.0F, 0.0F, -2.0F), Eigen::Vector3f(1.0F, 2.0F, 2.0F));
+mcpt::RaySorter sorter(aabb);
+
+auto octant = [](const Eigen::Vector3f& d) {
+  return (d.x() < 0.0F) | (d.y() < 0.0F) << 1 | (d.z() < 0.0F) << 2;
+};
+
+SECTION("the order is a permutation sorted by the keys") {
+  // rays of random origins in the scene & random directions
+  std::mt19937 gen{0};
+  std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+  std::vector<Eigen::Vector3f> origin;
+  std::vector<Eigen::Vector3f> direction;
+  for (int i = 0; i < 1000; ++i) {
+    Eigen::Vector3f u(uniform(gen), uniform(gen), uniform(gen));
+    origin.push_back(aabb.min_vertex() + aabb.GetDiagonal().cwiseProduct(u));
+    Eigen::Vector3f v(uniform(gen), uniform(gen), uniform(gen));
+    direction.push_back((2.0F * v - Eigen::Vector3f::Ones()).normalized());
+  }
+
+  std::vector<unsigned int> order;
+  auto coherence = sorter.Sort(origin, direction, order);
+
+  std::vector<unsigned int> indices = order;
+  std::sort(indices.begin(), indices.end());
+  std::vector<unsigned int> expected(origin.size());
+  std::iota(expected.begin(), expected.end(), 0U);
+  REQUIRE(indices == expected);
+
+  for (size_t i = 1; i < order.size(); ++i) {
+    CAPTURE(i);
+    uint64_t prev_key = sorter.Key(origin[order[i - 1]], direction[order[i - 1]]);
+    uint64_t key = sorter.Key(origin[order[i]], direction[order[i]]);
+    CHECK(prev_key <= key);
+    // the rays of the same octant are consecutive
+    CHECK(octant(direction[order[i - 1]]) <= octant(direction[order[i]]));
+  }
+
+  CHECK(coherence.before >= 0.0);
+  CHECK(coherence.after <= 1.0);
+  CHECK(coherence.after > coherence.before);
+
+  // sorting again changes nothing
+  std::vector<Eigen::Vector3f> sorted_origin;
+  std::vector<Eigen::Vector3f> sorted_direction;
+  for (unsigned int i : order) {
+    sorted_origin.push_back(origin[i]);
+    sorted_direction.push_back(direction[i]);
+  }
+  std::vector<unsigned int> sorted_order;
+  auto sorted_coherence = sorter.Sort(sorted_origin, sorted_direction, sorted_order);
+  CHECK(sorted_coherence.before == sorted_coherence.after);
+  CHECK(sorted_coherence.after == coherence.after);
+}
+
+SECTION("the keys put the direction octant before the origin cell") {
+  Eigen::Vector3f o(-0.9F, 0.1F, -1.9F);
+  Eigen::Vector3f far_o(0.9F, 1.9F, 1.9F);
+  for (float x : {1.0F, -1.0F}) {
+    for (float y : {1.0F, -1.0F}) {
+      for (float z : {1.0F, -1.0F}) {
+        Eigen::Vector3f d = Eigen::Vector3f(x, y, z).normalized();
+        CAPTURE(d.transpose());
+        CHECK(sorter.Key(o, d) >> (3 * mcpt::RaySorter::MORTON_BITS) == uint64_t(octant(d)));
+        CHECK(sorter.Key(o, d) < sorter.Key(far_o, d));
+      }
+    }
+  }
+
+  // the origins out of the scene are clamped into the border cells
+  Eigen::Vector3f d = Eigen::Vector3f::UnitX();
+  CHECK(sorter.Key(aabb.min_vertex() - Eigen::Vector3f::Ones(), d) ==
+        sorter.Key(aabb.min_vertex(), d));
+  CHECK(sorter.Key(aabb.max_vertex() + Eigen::Vector3f::Ones(), d) ==
+        sorter.Key(aabb.max_vertex(), d));
+}
+
+}
@@ -0,0 +1,255 @@
+#include "mcpt/renderer/sd_tree.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/random.hpp"
+
+namespace mcpt {
+
+void DTree::Record(const Eigen::Vector3f& direction, float value) {
+  ++m_num_samples;
+  if (!(value > 0.0F) || !std::isfinite(value))
+    return;
+
+  Eigen::Vector2f p = ToSquare(direction);
+  for (uint32_t idx = 0;;) {
+    Node& node = m_nodes[idx];
+    int q = Quadrant(p);
+    node.sum[q] += value;
+    if (node.child[q] == 0)
+      break;
+    idx = node.child[q];
+  }
+}
+
+Eigen::Vector3f DTree::Sample() const {
+  DASSERT(total() > 0.0F, "sampling a DTree of nothing recorded");
+  Uniform<float> uniform;
+
+  Eigen::Vector2f origin = Eigen::Vector2f::Zero();
+  float size = 1.0F;
+  for (uint32_t idx = 0;;) {
+    const Node& node = m_nodes[idx];
+    // the quadrant by the recorded radiance, skipping the empty ones against the rounding
+    float r = uniform.Random() * (node.sum[0] + node.sum[1] + node.sum[2] + node.sum[3]);
+    int q = 0;
+    while (q < 3 && (r >= node.sum[q] || node.sum[q] == 0.0F)) {
+      r -= node.sum[q];
+      ++q;
+    }
+    while (node.sum[q] == 0.0F)
+      --q;
+
+    size *= 0.5F;
+    origin += size * Eigen::Vector2f(float(q & 1), float(q >> 1));
+    if (node.child[q] == 0)
+      break;
+    idx = node.child[q];
+  }
+  return ToDirection(origin + size * Eigen::Vector2f(uniform.Random(), uniform.Random()));
+}
+
+double DTree::Pdf(const Eigen::Vector3f& direction) const {
+  Eigen::Vector2f p = ToSquare(direction);
+  // the PDF over the unit square, whose area is the one of the sphere over 4pi
+  double pdf = 1.0 / (4.0 * M_PI);
+  for (uint32_t idx = 0;;) {
+    const Node& node = m_nodes[idx];
+    float sum = node.sum[0] + node.sum[1] + node.sum[2] + node.sum[3];
+    int q = Quadrant(p);
+    if (sum <= 0.0F)
+      return 0.0;
+    pdf *= 4.0 * node.sum[q] / sum;
+    if (node.child[q] == 0)
+      break;
+    idx = node.child[q];
+  }
+  return pdf;
+}
+
+DTree DTree::Refined(float threshold, unsigned int max_depth) const {
+  DTree out;
+  float sum = total();
+  if (sum > 0.0F)
+    Refine(out, 0, &m_nodes[0], m_nodes[0].sum, threshold * sum, 1, max_depth);
+  return out;
+}
+
+void DTree::Refine(DTree& out,
+                   uint32_t out_idx,
+                   const Node* node,
+                   const std::array<float, 4>& sum,
+                   float threshold,
+                   unsigned int depth,
+                   unsigned int max_depth) const {
+  for (int q = 0; q < 4; ++q) {
+    if (sum[q] <= threshold || depth >= max_depth)
+      continue;
+
+    // the quadrants not subdivided yet are taken as uniform
+    const Node* child = node && node->child[q] ? &m_nodes[node->child[q]] : nullptr;
+    std::array<float, 4> child_sum;
+    if (child)
+      child_sum = child->sum;
+    else
+      child_sum.fill(sum[q] * 0.25F);
+
+    auto idx = uint32_t(out.m_nodes.size());
+    out.m_nodes.emplace_back();
+    out.m_nodes[out_idx].child[q] = idx;
+    Refine(out, idx, child, child_sum, threshold, depth + 1, max_depth);
+  }
+}
+
+float DTree::total() const noexcept {
+  const auto& sum = m_nodes.front().sum;
+  return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+void DTree::Halve() noexcept {
+  for (auto& node : m_nodes)
+    for (auto& sum : node.sum)
+      sum *= 0.5F;
+  m_num_samples /= 2;
+}
+
+Eigen::Vector2f DTree::ToSquare(const Eigen::Vector3f& direction) {
+  constexpr float ONE_MINUS = 1.0F - 1.0e-7F;
+  float cos_theta = std::clamp(direction.z(), -1.0F, 1.0F);
+  float phi = std::atan2(direction.y(), direction.x());
+  if (phi < 0.0F)
+    phi += 2.0F * float(M_PI);
+  return {std::clamp((cos_theta + 1.0F) * 0.5F, 0.0F, ONE_MINUS),
+          std::clamp(phi / (2.0F * float(M_PI)), 0.0F, ONE_MINUS)};
+}
+
+Eigen::Vector3f DTree::ToDirection(const Eigen::Vector2f& p) {
+  float cos_theta = 2.0F * p.x() - 1.0F;
+  float sin_theta = std::sqrt(std::max(0.0F, 1.0F - cos_theta * cos_theta));
+  float phi = 2.0F * float(M_PI) * p.y();
+  return {sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+}
+
+int DTree::Quadrant(Eigen::Vector2f& p) {
+  int q = 0;
+  for (int i = 0; i < 2; ++i) {
+    if (p[i] >= 0.5F) {
+      q |= 1 << i;
+      p[i] -= 0.5F;
+    }
+  }
+  p *= 2.0F;
+  return q;
+}
+
+SDTree::SDTree(const Options& options, const AABB<float>& aabb)
+    : m_options(options), m_dtree_locks(new std::mutex[NUM_LOCKS]) {
+  ASSERT(options.guide_prob >= 0.0F && options.guide_prob <= 1.0F,
+         "invalid probability to guide: {}",
+         options.guide_prob);
+
+  // a cube around the scene, for the splits to keep the leaves in shape
+  Eigen::Vector3f center = (aabb.min_vertex() + aabb.max_vertex()) * 0.5F;
+  float half = std::max(aabb.GetDiagonal().maxCoeff() * 0.5F, 1.0e-3F);
+  Node root;
+  root.min_vertex = center - Eigen::Vector3f::Constant(half);
+  root.max_vertex = center + Eigen::Vector3f::Constant(half);
+
+  m_recording.nodes.push_back(root);
+  m_recording.dtrees.emplace_back();
+  m_sampling = m_recording;
+}
+
+SDTree::Distribution SDTree::Find(const Eigen::Vector3f& point) const {
+  Distribution distribution;
+  // the trees are frozen when not training
+  if (training())
+    distribution.m_lock = std::shared_lock(m_mutex);
+  distribution.m_dtree = &m_sampling.dtrees[m_sampling.Find(point)];
+  return distribution;
+}
+
+void SDTree::Record(const Eigen::Vector3f& point, const Eigen::Vector3f& direction, float value) {
+  if (!training())
+    return;
+
+  size_t budget;
+  {
+    std::shared_lock lock(m_mutex);
+    if (!training())
+      return;
+    uint32_t dtree = m_recording.Find(point);
+    std::lock_guard dtree_lock(m_dtree_locks[dtree % NUM_LOCKS]);
+    m_recording.dtrees[dtree].Record(direction, value);
+    budget = m_options.iteration_samples << m_iteration;
+  }
+  if (m_num_recorded.fetch_add(1) + 1 == budget)
+    Refine();
+}
+
+unsigned int SDTree::iteration() const {
+  std::shared_lock lock(m_mutex);
+  return m_iteration;
+}
+
+size_t SDTree::num_leaves() const {
+  std::shared_lock lock(m_mutex);
+  return m_sampling.dtrees.size();
+}
+
+void SDTree::Refine() {
+  std::unique_lock lock(m_mutex);
+  m_num_recorded = 0;
+
+  // split the spatial leaves of many samples, their halves share the DTree recorded so far
+  auto threshold =
+      size_t(double(m_options.spatial_threshold) * std::sqrt(std::ldexp(1.0, int(m_iteration))));
+  auto& nodes = m_recording.nodes;
+  auto& dtrees = m_recording.dtrees;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].child[0] != 0 || dtrees[nodes[i].dtree].num_samples() <= threshold)
+      continue;
+    dtrees[nodes[i].dtree].Halve();
+
+    Node lower = nodes[i];
+    Node upper = nodes[i];
+    int axis = nodes[i].axis;
+    float middle = (lower.min_vertex[axis] + lower.max_vertex[axis]) * 0.5F;
+    lower.max_vertex[axis] = middle;
+    upper.min_vertex[axis] = middle;
+    lower.axis = upper.axis = (axis + 1) % 3;
+    upper.dtree = uint32_t(dtrees.size());
+    dtrees.push_back(dtrees[nodes[i].dtree]);
+
+    nodes[i].child = {uint32_t(nodes.size()), uint32_t(nodes.size() + 1)};
+    nodes.push_back(lower);
+    nodes.push_back(upper);
+  }
+
+  // sample by the trees just recorded, & record into their refinements
+  Field next{nodes, {}};
+  next.dtrees.reserve(dtrees.size());
+  for (const auto& dtree : dtrees)
+    next.dtrees.push_back(dtree.Refined(m_options.flux_threshold, m_options.max_quad_depth));
+  m_sampling = std::exchange(m_recording, std::move(next));
+
+  if (++m_iteration >= m_options.num_iterations) {
+    m_recording = {};
+    m_training.store(false, std::memory_order_release);
+  }
+}
+
+uint32_t SDTree::Field::Find(const Eigen::Vector3f& point) const {
+  uint32_t idx = 0;
+  while (nodes[idx].child[0] != 0) {
+    const Node& node = nodes[idx];
+    float middle = (node.min_vertex[node.axis] + node.max_vertex[node.axis]) * 0.5F;
+    idx = node.child[point[node.axis] >= middle];
+  }
+  return nodes[idx].dtree;
+}
+
+}  // namespace mcpt
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/geometry/aabb.hpp"
+
+namespace mcpt {
+
+// quadtree of the incident radiance over the directions, mapped to the unit square by the
+// cylindrical coordinates ((cos(theta) + 1) / 2, phi / 2pi), which keep the areas of the sphere
+class DTree {
+public:
+  DTree() : m_nodes(1) {}
+
+  // add the radiance of a direction over its sampling PDF, not thread safe
+  void Record(const Eigen::Vector3f& direction, float value);
+  // sample a direction proportionally to the recorded radiance, the tree must have some
+  Eigen::Vector3f Sample() const;
+  // the solid angle PDF of Sample
+  double Pdf(const Eigen::Vector3f& direction) const;
+
+  // the tree for the next iteration, subdivided where a node holds more than `threshold' of the
+  // total radiance of this one & collapsed elsewhere, with nothing recorded
+  DTree Refined(float threshold, unsigned int max_depth) const;
+
+  float total() const noexcept;
+  size_t num_samples() const noexcept { return m_num_samples; }
+  size_t num_nodes() const noexcept { return m_nodes.size(); }
+  // the recorded radiance halves along with the samples when a spatial leaf splits
+  void Halve() noexcept;
+
+private:
+  struct Node {
+    std::array<float, 4> sum{};
+    std::array<uint32_t, 4> child{};  // zero for the leaf quadrants
+  };
+
+  static Eigen::Vector2f ToSquare(const Eigen::Vector3f& direction);
+  static Eigen::Vector3f ToDirection(const Eigen::Vector2f& p);
+  static int Quadrant(Eigen::Vector2f& p);
+
+  void Refine(DTree& out,
+              uint32_t out_idx,
+              const Node* node,
+              const std::array<float, 4>& sum,
+              float threshold,
+              unsigned int depth,
+              unsigned int max_depth) const;
+
+private:
+  std::vector<Node> m_nodes;
+  size_t m_num_samples = 0;
+};
+
+/**
+ * spatial-directional tree of the incident radiance (SD-tree), learned by the paths for guiding
+ * the exit directions of the diffusive surfaces, see Müller et al., "Practical Path Guiding for
+ * Efficient Light-Transport Simulation"
+ *
+ * a binary tree over the scene AABB, splitting the middles of the axes in turn, holds a DTree in
+ * every leaf; the paths are sampled by the trees learned in the last iteration while recording
+ * into the trees of the current one
+ *
+ * - iteration k records `iteration_samples' * 2^k samples, then the spatial leaves of more than
+ *   `spatial_threshold' * sqrt(2^k) samples split & the DTrees are refined by `flux_threshold'
+ * - the learning stops after `num_iterations', the trees are frozen from then on
+ *
+ * thread safe, the trees are refined by the thread recording the last sample of an iteration
+ */
+class SDTree {
+public:
+  struct Options {
+    size_t spatial_threshold = 4000;
+    float flux_threshold = 0.01F;
+    unsigned int max_quad_depth = 16;
+    size_t iteration_samples = 1 << 18;
+    unsigned int num_iterations = 6;
+    // probability to sample the exit directions from the learned distributions, against the BxDF
+    float guide_prob = 0.5F;
+  };
+
+  // the learned distribution at a point, keeping the trees from being refined while in use
+  class Distribution {
+  public:
+    bool learned() const noexcept { return m_dtree && m_dtree->total() > 0.0F; }
+    Eigen::Vector3f Sample() const { return m_dtree->Sample(); }
+    double Pdf(const Eigen::Vector3f& direction) const { return m_dtree->Pdf(direction); }
+
+  private:
+    friend class SDTree;
+    std::shared_lock<std::shared_mutex> m_lock;
+    const DTree* m_dtree = nullptr;
+  };
+
+  SDTree(const Options& options, const AABB<float>& aabb);
+
+  Distribution Find(const Eigen::Vector3f& point) const;
+  // add the incident radiance of an exit direction over its sampling PDF, no-op once learned
+  void Record(const Eigen::Vector3f& point, const Eigen::Vector3f& direction, float value);
+
+  bool training() const noexcept { return m_training.load(std::memory_order_acquire); }
+  unsigned int iteration() const;
+  size_t num_leaves() const;
+  auto& options() const noexcept { return m_options; }
+
+private:
+  static constexpr size_t NUM_LOCKS = 256;
+
+  struct Node {
+    Eigen::Vector3f min_vertex;
+    Eigen::Vector3f max_vertex;
+    int axis = 0;  // of the split
+    std::array<uint32_t, 2> child{};  // zeros for the leaves
+    uint32_t dtree = 0;  // of the leaves
+  };
+
+  // the spatial tree with the DTrees of its leaves
+  struct Field {
+    std::vector<Node> nodes;
+    std::vector<DTree> dtrees;
+
+    uint32_t Find(const Eigen::Vector3f& point) const;
+  };
+
+  // end the iteration
+  void Refine();
+
+private:
+  Options m_options;
+
+  mutable std::shared_mutex m_mutex;
+  std::unique_ptr<std::mutex[]> m_dtree_locks;
+  Field m_sampling;
+  Field m_recording;
+
+  std::atomic_bool m_training{true};
+  std::atomic_size_t m_num_recorded{0};
+  unsigned int m_iteration = 0;
+};
+
+}  // namespace mcpt
@@ -0,0 +1,99 @@
+#include "mcpt/renderer/sd_tree.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+
+#include <Eigen/Eigen>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcpt/common/geometry/aabb.hpp"
+#include "mcpt/common/random.hpp"
+
+namespace {
+
+Eigen::Vector3f UniformSphere(mcpt::Uniform<float>& uniform) {
+  float cos = 2.0F * uniform.Random() - 1.0F;
+  float sin = std::sqrt(std::max(0.0F, 1.0F - cos * cos));
+  float phi = 2.0F * float(M_PI) * uniform.Random();
+  return {sin * std::cos(phi), sin * std::sin(phi), cos};
+}
+
+}  // namespace
+
+TEST_CASE("DTree learns & samples the incident radiance", "[sd_tree]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::Uniform<float> uniform;
+constexpr double UNIFORM_PDF = 1.0 / (4.0 * M_PI);
+
+// a bright cone around the z axis over a dim background, sampled uniformly
+Eigen::Vector3f axis = Eigen::Vector3f(0.2F, -0.3F, 1.0F).normalized();
+auto radiance = [&](const Eigen::Vector3f& d) { return axis.dot(d) > 0.9F ? 1.0F : 0.01F; };
+double cone_mass = 2.0 * M_PI * 0.1;
+double cone_fraction = cone_mass / (cone_mass + 0.01 * (4.0 * M_PI - cone_mass));
+
+// the refined tree of a learned one resolves the cone better
+mcpt::DTree dtree;
+for (int iteration = 0; iteration < 3; ++iteration) {
+  dtree = dtree.Refined(0.01F, 16);
+  for (size_t i = 0; i < 100000; ++i) {
+    Eigen::Vector3f d = UniformSphere(uniform);
+    dtree.Record(d, float(radiance(d) / UNIFORM_PDF));
+  }
+}
+REQUIRE(dtree.num_nodes() > 1);
+REQUIRE(dtree.num_samples() == 100000);
+
+constexpr size_t NUM_SAMPLES = 100000;
+double pdf_mass = 0.0;
+size_t num_in_cone = 0;
+for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+  Eigen::Vector3f d = dtree.Sample();
+  REQUIRE(d.norm() == Catch::Approx(1.0F).epsilon(1.0e-4));
+  REQUIRE(dtree.Pdf(d) > 0.0);
+  num_in_cone += axis.dot(d) > 0.9F;
+  pdf_mass += dtree.Pdf(UniformSphere(uniform)) / UNIFORM_PDF;
+}
+CHECK(pdf_mass / NUM_SAMPLES == Catch::Approx(1.0).epsilon(0.02));
+// the quadtree leaves straddling the edge of the cone take some mass out of it
+CHECK(double(num_in_cone) / NUM_SAMPLES == Catch::Approx(cone_fraction).epsilon(0.1));
+
+}
+
+TEST_CASE("SD-tree splits the space over the iterations & stops learning", "[sd_tree]") {
+
+mcpt::Uniform<float>::Seed(42);
+mcpt::Uniform<float> uniform;
+
+mcpt::SDTree::Options options;
+options.spatial_threshold = 500;
+options.iteration_samples = 4000;
+options.num_iterations = 3;
+mcpt::AABB<float> aabb(Eigen::Vector3f(-1.0F, 0.0F, 0.0F), Eigen::Vector3f(1.0F, 2.0F, 0.5F));
+mcpt::SDTree sd_tree(options, aabb);
+REQUIRE(!sd_tree.Find(Eigen::Vector3f::Zero()).learned());
+
+// the radiance comes from above everywhere
+for (unsigned int iteration = 0; iteration < options.num_iterations; ++iteration) {
+  REQUIRE(sd_tree.training());
+  REQUIRE(sd_tree.iteration() == iteration);
+  for (size_t i = 0; i < (options.iteration_samples << iteration); ++i) {
+    Eigen::Vector3f p = aabb.min_vertex() +
+                        aabb.GetDiagonal().cwiseProduct(
+                            Eigen::Vector3f(uniform.Random(), uniform.Random(), uniform.Random()));
+    Eigen::Vector3f d = UniformSphere(uniform);
+    sd_tree.Record(p, d, d.z() > 0.0F ? 1.0F : 0.0F);
+  }
+}
+CHECK(!sd_tree.training());
+CHECK(sd_tree.num_leaves() > 8);
+
+auto distribution = sd_tree.Find(Eigen::Vector3f(0.5F, 1.0F, 0.25F));
+REQUIRE(distribution.learned());
+for (int i = 0; i < 1000; ++i)
+  CHECK(distribution.Sample().z() >= 0.0F);
+CHECK(distribution.Pdf(Eigen::Vector3f(0.0F, 0.0F, -1.0F)) == 0.0);
+
+}
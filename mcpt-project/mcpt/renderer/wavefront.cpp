@@ -0,0 +1,399 @@
+#include "mcpt/renderer/wavefront.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <variant>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "mcpt/common/assert.hpp"
+#include "mcpt/common/geometry/ray_offset.hpp"
+#include "mcpt/common/geometry/ray_packet.hpp"
+#include "mcpt/common/geometry/types.hpp"
+#include "mcpt/common/object/material.hpp"
+#include "mcpt/common/stats.hpp"
+#include "mcpt/common/trace.hpp"
+
+namespace mcpt {
+
+void Wavefront::RayQueue::clear() noexcept {
+  origin.clear();
+  direction.clear();
+  throughput.clear();
+  pixel.clear();
+  after_diffusion.clear();
+  exclude.clear();
+}
+
+void Wavefront::RayQueue::push_back(const Eigen::Vector3f& o,
+                                    const Eigen::Vector3f& d,
+                                    const Eigen::Vector3f& beta,
+                                    unsigned int pix,
+                                    bool diff,
+                                    const PrimitiveId& ex) {
+  origin.push_back(o);
+  direction.push_back(d);
+  throughput.push_back(beta);
+  pixel.push_back(pix);
+  after_diffusion.push_back(diff);
+  exclude.push_back(ex);
+}
+
+void Wavefront::HitQueue::clear() noexcept {
+  ray.clear();
+  primitive.clear();
+  point.clear();
+  normal.clear();
+}
+
+void Wavefront::HitQueue::push_back(unsigned int r,
+                                    const PrimitiveId& prim,
+                                    const Eigen::Vector3f& p,
+                                    const Eigen::Vector3f& n) {
+  ray.push_back(r);
+  primitive.push_back(prim);
+  point.push_back(p);
+  normal.push_back(n);
+}
+
+void Wavefront::ShadowQueue::clear() noexcept {
+  origin.clear();
+  normal.clear();
+  exclude.clear();
+  lpath.clear();
+  contrib.clear();
+  pixel.clear();
+}
+
+void Wavefront::ShadowQueue::push_back(const Eigen::Vector3f& o,
+                                       const Eigen::Vector3f& n,
+                                       const PrimitiveId& ex,
+                                       const PathToLight& l,
+                                       const Eigen::Vector3f& c,
+                                       unsigned int pix) {
+  origin.push_back(o);
+  normal.push_back(n);
+  exclude.push_back(ex);
+  lpath.push_back(l);
+  contrib.push_back(c);
+  pixel.push_back(pix);
+}
+
+Wavefront::Wavefront(const MonteCarlo::Options& options,
+                     const Object& object,
+                     const BVHTree<float>& bvh_tree)
+    : m_options(options)
+    , m_associated_object(object)
+    , m_ray_caster(bvh_tree)
+    , m_ray_sorter(bvh_tree.root->aabb)
+    , m_path_tracer(object, bvh_tree)
+    , m_light_sampler(object, bvh_tree) {
+  float fx = m_options.intrin.x();
+  float fy = m_options.intrin.y();
+  float cx = m_options.intrin.z();
+  float cy = m_options.intrin.w();
+  m_intrin_inv << 1.0F / fx, 0.0F, -cx / fx, 0.0F, 1.0F / fy, -cy / fy, 0.0F, 0.0F, 1.0F;
+}
+
+/**
+ *   +----------+     +--------+     +---------------+     +-------+
+ *   | primary  |---->| extend |---->| sample lights |---->| shade |--+
+ *   +----------+     +--------+     +---------------+     +-------+  |
+ *                        ^                  |                        |
+ *                        |                  v                        |
+ *                        |          +---------------+                |
+ *                        |          | trace shadows |                |
+ *                        |          +---------------+                |
+ *                        +-------------------------------------------+
+ */
+MonteCarlo::RayCount Wavefront::Run(unsigned int width,
+                                    size_t first,
+                                    size_t last,
+                                    Eigen::Vector3f radiance[],
+                                    float cost[]) {
+  MonteCarlo::RayCount ray_count;
+
+  RayQueue rays;
+  RayQueue next_rays;
+  HitQueue hits;
+  ShadowQueue shadows;
+  Scratch scratch;
+
+  RaySorter::Coherence coherence;
+  size_t num_sorted = 0;
+
+  for (size_t batch_first = first; batch_first < last; batch_first += MAX_BATCH_SIZE) {
+    TRACE_ZONE("wavefront batch");
+    size_t batch_last = std::min(last, batch_first + MAX_BATCH_SIZE);
+    Eigen::Vector3f* batch_radiance = radiance + (batch_first - first);
+    std::fill(batch_radiance, batch_radiance + (batch_last - batch_first), Eigen::Vector3f::Zero());
+    float* batch_cost = nullptr;
+    if (cost) {
+      batch_cost = cost + (batch_first - first);
+      std::fill(batch_cost, batch_cost + (batch_last - batch_first), 0.0F);
+    }
+
+    GeneratePrimary(width, batch_first, batch_last, rays);
+    for (size_t depth = 0; rays.size() != 0; ++depth) {
+      bool primary = depth == 0;
+      if (primary) {
+        ExtendPrimary(rays, hits, batch_cost);
+        ray_count.primary += rays.size();
+      } else {
+        RaySorter::Coherence batch_coherence;
+        Extend(rays, hits, batch_coherence, batch_cost);
+        // weighted by the number of rays
+        coherence.before += batch_coherence.before * rays.size();
+        coherence.after += batch_coherence.after * rays.size();
+        num_sorted += rays.size();
+        ray_count.extension += rays.size();
+      }
+      SampleLights(rays, hits, scratch, shadows);
+      TraceShadows(shadows, batch_radiance, batch_cost);
+      ray_count.shadow += shadows.size();
+      Shade(rays, hits, scratch, depth + 1, next_rays, batch_radiance);
+      // paths reaching the maximum depth end here
+      if (m_options.max_depth && depth + 1 >= m_options.max_depth)
+        next_rays.clear();
+      // paths missing the scene end with `depth' vertices, the others ending here have one more
+      for (size_t i = hits.size(); i < rays.size(); ++i)
+        STATS_PATH_LENGTH(depth);
+      for (size_t i = next_rays.size(); i < hits.size(); ++i)
+        STATS_PATH_LENGTH(depth + 1);
+      std::swap(rays, next_rays);
+    }
+  }
+
+  if (num_sorted != 0) {
+    coherence.before /= num_sorted;
+    coherence.after /= num_sorted;
+    spdlog::debug("secondary ray coherence: {:.3f} -> {:.3f} (x{:.2f})",
+                  coherence.before,
+                  coherence.after,
+                  coherence.gain());
+  }
+  return ray_count;
+}
+
+void Wavefront::GeneratePrimary(unsigned int width, size_t first, size_t last, RayQueue& rays) {
+  TRACE_ZONE("generate primary rays");
+  rays.clear();
+
+  // enumerate pixels tile by tile so that consecutive rays form coherent packets
+  for (size_t v0 = first / width / TILE_SIZE * TILE_SIZE; v0 * width < last; v0 += TILE_SIZE) {
+    for (size_t u0 = 0; u0 < width; u0 += TILE_SIZE) {
+      for (size_t v = v0; v < v0 + TILE_SIZE; ++v) {
+        for (size_t u = u0; u < u0 + TILE_SIZE && u < width; ++u) {
+          size_t i = v * width + u;
+          if (i < first || i >= last)
+            continue;
+
+          Eigen::Vector2f uv(u + m_uni_subpixel.Random(), v + m_uni_subpixel.Random());
+          Eigen::Vector3f xy1 = m_intrin_inv * uv.homogeneous();
+          Eigen::Vector3f dir = (m_options.R * xy1).normalized();
+          rays.push_back(m_options.t, dir, Eigen::Vector3f::Ones(), i - first, false, {});
+        }
+      }
+    }
+  }
+}
+
+void Wavefront::Extend(const RayQueue& rays,
+                       HitQueue& hits,
+                       RaySorter::Coherence& coherence,
+                       float cost[]) const {
+  TRACE_ZONE("extend");
+  hits.clear();
+
+  // trace in sorted order, the following stages will also visit the hits in this order
+  std::vector<unsigned int> order;
+  coherence = m_ray_sorter.Sort(rays.origin, rays.direction, order);
+  for (unsigned int i : order) {
+    uint64_t steps = RayCaster::traversal_steps();
+    auto intersection =
+        m_ray_caster.Run(Ray<float>(rays.origin[i], rays.direction[i]), rays.exclude[i]);
+    if (cost)
+      cost[rays.pixel[i]] += RayCaster::traversal_steps() - steps;
+    // not intersected
+    if (intersection.node == nullptr)
+      continue;
+    hits.push_back(i, intersection.primitive, intersection.point, intersection.normal);
+  }
+}
+
+void Wavefront::ExtendPrimary(const RayQueue& rays, HitQueue& hits, float cost[]) const {
+  TRACE_ZONE("extend primary");
+  static constexpr int PACKET_SIZE = TILE_SIZE * TILE_SIZE;
+
+  hits.clear();
+  std::vector<Ray<float>> packet_rays;
+  RayCaster::Intersection intersections[PACKET_SIZE];
+  for (size_t first = 0; first < rays.size(); first += PACKET_SIZE) {
+    size_t last = std::min(rays.size(), first + PACKET_SIZE);
+
+    packet_rays.clear();
+    for (size_t i = first; i < last; ++i)
+      packet_rays.emplace_back(rays.origin[i], rays.direction[i]);
+    RayPacket<float, PACKET_SIZE> packet(packet_rays.cbegin(), packet_rays.cend());
+    uint64_t steps = RayCaster::traversal_steps();
+    m_ray_caster.Run(packet, intersections);
+    if (cost) {
+      // share the cost of the packet evenly
+      float packet_cost = float(RayCaster::traversal_steps() - steps) / packet.size();
+      for (size_t i = first; i < last; ++i)
+        cost[rays.pixel[i]] += packet_cost;
+    }
+
+    for (size_t i = first; i < last; ++i) {
+      const auto& intersection = intersections[i - first];
+      // not intersected
+      if (intersection.node == nullptr)
+        continue;
+      hits.push_back(i, intersection.primitive, intersection.point, intersection.normal);
+    }
+  }
+}
+
+void Wavefront::SampleLights(const RayQueue& rays,
+                             const HitQueue& hits,
+                             Scratch& scratch,
+                             ShadowQueue& shadows) {
+  TRACE_ZONE("sample lights");
+  shadows.clear();
+  auto& shading = scratch.shading;
+  auto& shading_hits = scratch.shading_hits;
+  auto& shading_lpaths = scratch.shading_lpaths;
+  shading.clear();
+  shading_hits.clear();
+  shading_lpaths.clear();
+  for (size_t i = 0; i < hits.size(); ++i) {
+    const Mesh& mesh = *hits.primitive[i].mesh;
+    const Material& mtl = m_associated_object.get().GetMaterialByName(mesh.material);
+    // only sample direct lighting for diffusion material
+    if (Material::Type(mtl) != Material::DIFF)
+      continue;
+
+    auto lpath = m_light_sampler.Sample(hits.point[i], hits.normal[i]);
+    if (!lpath.has_value())
+      continue;
+
+    Eigen::Vector3f wo = -rays.direction[hits.ray[i]];
+    shading.push_back(mtl, Material::DIFF, hits.normal[i], lpath.value().hit_dir, wo);
+    shading_hits.push_back(i);
+    shading_lpaths.push_back(lpath.value());
+  }
+  std::visit([&](const auto& bxdf) { bxdf.Shade(shading); }, m_bxdf);
+
+  for (size_t j = 0; j < shading.size(); ++j) {
+    unsigned int i = shading_hits[j];
+    unsigned int r = hits.ray[i];
+    const Eigen::Vector3f& point = hits.point[i];
+    const Eigen::Vector3f& normal = hits.normal[i];
+    const PathToLight& lpath = shading_lpaths[j];
+
+    float cos_wi = std::max(0.0F, normal.dot(lpath.hit_dir));
+    Eigen::Vector3f contrib = rays.throughput[r].cwiseProduct(shading.fr[j]).cwiseProduct(
+        Material::AsEmission(lpath.material) * (cos_wi / lpath.hit_pdf));
+    if ((contrib.array() > 0.0F).any())
+      shadows.push_back(point, normal, hits.primitive[i], lpath, contrib, rays.pixel[r]);
+  }
+}
+
+void Wavefront::Shade(const RayQueue& rays,
+                      const HitQueue& hits,
+                      Scratch& scratch,
+                      size_t depth,
+                      RayQueue& next_rays,
+                      Eigen::Vector3f radiance[]) {
+  TRACE_ZONE("shade");
+  next_rays.clear();
+
+  // sample the cosine power lobes of Blinn-Phong of all the hits in one pass, the hits of the other
+  // materials ignore theirs, the other BxDFs sample theirs in the path tracer
+  bool batch_diffusions = std::holds_alternative<BlinnPhongBxDF>(m_bxdf);
+  auto& hit_materials = scratch.hit_materials;
+  auto& hit_alphas = scratch.hit_alphas;
+  auto& diffusions = scratch.diffusions;
+  auto& shading = scratch.shading;
+  auto& shading_hits = scratch.shading_hits;
+  auto& shading_rpaths = scratch.shading_rpaths;
+  hit_materials.resize(hits.size());
+  hit_alphas.resize(hits.size());
+  for (size_t i = 0; i < hits.size(); ++i) {
+    const Mesh& mesh = *hits.primitive[i].mesh;
+    hit_materials[i] = &m_associated_object.get().GetMaterialByName(mesh.material);
+    hit_alphas[i] = hit_materials[i]->Ns + 1.0F;
+  }
+  if (batch_diffusions)
+    scratch.cos_pow_hemi.Random(hit_alphas.data(), hits.size(), diffusions);
+
+  shading.clear();
+  shading_hits.clear();
+  shading_rpaths.clear();
+  for (size_t i = 0; i < hits.size(); ++i) {
+    unsigned int r = hits.ray[i];
+    Eigen::Vector3f wo = -rays.direction[r];
+
+    auto rpath = batch_diffusions ? m_path_tracer.Scatter(rays.direction[r],
+                                                          *hit_materials[i],
+                                                          hits.point[i],
+                                                          hits.normal[i],
+                                                          diffusions[i])
+                                  : m_path_tracer.Scatter(rays.direction[r],
+                                                          *hits.primitive[i].mesh,
+                                                          hits.point[i],
+                                                          hits.normal[i]);
+    const Material& mtl = rpath.material;
+
+    if (rpath.type == Material::EM) {
+      // ray hit the light source directly, diffusion vertices have sampled it already
+      if (!rays.after_diffusion[r] && rpath.normal.dot(wo) > 0.0F)
+        radiance[rays.pixel[r]] += rays.throughput[r].cwiseProduct(Material::AsEmission(mtl));
+      continue;
+    }
+
+    shading.push_back(mtl, rpath.type, rpath.normal, rpath.exit_dir, wo);
+    shading_hits.push_back(i);
+    shading_rpaths.push_back(rpath);
+  }
+  std::visit([&](const auto& bxdf) { bxdf.Shade(shading); }, m_bxdf);
+
+  for (size_t j = 0; j < shading.size(); ++j) {
+    unsigned int i = shading_hits[j];
+    unsigned int r = hits.ray[i];
+    const ReversePath& rpath = shading_rpaths[j];
+
+    float cos_wi = std::max(0.0F, rpath.normal.dot(rpath.exit_dir));
+    Eigen::Vector3f beta =
+        rays.throughput[r].cwiseProduct(shading.fr[j]) * (cos_wi / rpath.exit_pdf);
+
+    // stop if russian roulette fail, by the throughput through the exit direction
+    double cont_prob = m_options.ContinuationProb(depth, beta);
+    if (m_russian_roulette.Random() >= cont_prob)
+      continue;
+    beta /= float(cont_prob);
+
+    // the next ray starts off the surface
+    bool diff = rpath.type == Material::DIFF;
+    Eigen::Vector3f origin = OffsetRayOrigin(rpath.point, hits.normal[i], rpath.exit_dir);
+    next_rays.push_back(origin, rpath.exit_dir, beta, rays.pixel[r], diff, hits.primitive[i]);
+  }
+}
+
+void Wavefront::TraceShadows(const ShadowQueue& shadows,
+                             Eigen::Vector3f radiance[],
+                             float cost[]) const {
+  TRACE_ZONE("trace shadows");
+  for (size_t i = 0; i < shadows.size(); ++i) {
+    uint64_t steps = RayCaster::traversal_steps();
+    if (!m_light_sampler.IsBlocked(
+            shadows.origin[i], shadows.normal[i], shadows.lpath[i], shadows.exclude[i]))
+      radiance[shadows.pixel[i]] += shadows.contrib[i];
+    if (cost)
+      cost[shadows.pixel[i]] += RayCaster::traversal_steps() - steps;
+  }
+}
+
+}  // namespace mcpt
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <Eigen/Eigen>
+
+#include "mcpt/common/geometry/bvh_tree.hpp"
+#include "mcpt/common/object/material.hpp"
+#include "mcpt/common/object/mesh.hpp"
+#include "mcpt/common/object/object.hpp"
+#include "mcpt/common/random.hpp"
+
+#include "mcpt/renderer/bxdf.hpp"
+#include "mcpt/renderer/light_sampler.hpp"
+#include "mcpt/renderer/monte_carlo.hpp"
+#include "mcpt/renderer/path_tracer.hpp"
+#include "mcpt/renderer/ray_caster.hpp"
+#include "mcpt/renderer/ray_sorter.hpp"
+
+namespace mcpt {
+
+// Wavefront (stream) Monte Carlo integrator class
+//
+// Computes the same estimator as `MonteCarlo' but breadth-first: a batch of paths is kept in SoA
+// queues and every stage (extension rays, material evaluation & light sampling, shadow rays) runs
+// over the whole queue before the next stage starts. Secondary rays are sorted by `RaySorter' before
+// extension to make the traversal coherent.
+class Wavefront {
+public:
+  // max number of paths alive in the queues at the same time
+  static constexpr size_t MAX_BATCH_SIZE = 1 << 16;
+  // primary rays are traced in packets of TILE_SIZE x TILE_SIZE pixels
+  static constexpr unsigned int TILE_SIZE = 4;
+
+  Wavefront(const MonteCarlo::Options& options,
+            const Object& object,
+            const BVHTree<float>& bvh_tree);
+
+  void SetBxDF(const BxDF& bxdf) {
+    m_bxdf = bxdf;
+    m_path_tracer.SetBxDF(bxdf);
+  }
+
+  // render one sample for each pixel in [first, last) of an image with `width' columns
+  // radiance of pixel i is written to radiance[i - first], returns the number of rays traced
+  // if `cost' is given, the BVH nodes visited for pixel i are written to cost[i - first]
+  MonteCarlo::RayCount Run(unsigned int width,
+                           size_t first,
+                           size_t last,
+                           Eigen::Vector3f radiance[],
+                           float cost[] = nullptr);
+
+  auto& options() const noexcept { return m_options; }
+
+private:
+  // rays to be extended
+  struct RayQueue {
+    std::vector<Eigen::Vector3f> origin;
+    std::vector<Eigen::Vector3f> direction;
+    std::vector<Eigen::Vector3f> throughput;
+    std::vector<unsigned int> pixel;
+    std::vector<unsigned char> after_diffusion;  // whether the last vertex is diffusive
+    std::vector<PrimitiveId> exclude;  // mesh of the last vertex
+
+    size_t size() const noexcept { return pixel.size(); }
+    void clear() noexcept;
+    void push_back(const Eigen::Vector3f& o,
+                   const Eigen::Vector3f& d,
+                   const Eigen::Vector3f& beta,
+                   unsigned int pix,
+                   bool diff,
+                   const PrimitiveId& ex);
+  };
+
+  // extension rays that hit some mesh, indexed into the ray queue
+  struct HitQueue {
+    std::vector<unsigned int> ray;
+    std::vector<PrimitiveId> primitive;
+    std::vector<Eigen::Vector3f> point;
+    std::vector<Eigen::Vector3f> normal;  // in the world space
+
+    size_t size() const noexcept { return ray.size(); }
+    void clear() noexcept;
+    void push_back(unsigned int r,
+                   const PrimitiveId& prim,
+                   const Eigen::Vector3f& p,
+                   const Eigen::Vector3f& n);
+  };
+
+  // shadow rays towards the sampled light points
+  struct ShadowQueue {
+    std::vector<Eigen::Vector3f> origin;
+    std::vector<Eigen::Vector3f> normal;  // geometric normal at the origin
+    std::vector<PrimitiveId> exclude;  // mesh at the origin
+    std::vector<PathToLight> lpath;
+    std::vector<Eigen::Vector3f> contrib;  // unoccluded contribution
+    std::vector<unsigned int> pixel;
+
+    size_t size() const noexcept { return pixel.size(); }
+    void clear() noexcept;
+    void push_back(const Eigen::Vector3f& o,
+                   const Eigen::Vector3f& n,
+                   const PrimitiveId& ex,
+                   const PathToLight& l,
+                   const Eigen::Vector3f& c,
+                   unsigned int pix);
+  };
+
+  // buffers of the stages local to a call of Run, so that the threads may share the runner
+  struct Scratch {
+    // the diffusion directions of all the hits, sampled in one pass by Shade
+    CosPowHemisphere<float> cos_pow_hemi;
+    std::vector<const Material*> hit_materials;
+    std::vector<float> hit_alphas;
+    SolidAngleBatch<float> diffusions;
+
+    // the BxDF evaluations of a stage, batched & indexed into the hit queue
+    ShadingBatch shading;
+    std::vector<unsigned int> shading_hits;
+    std::vector<PathToLight> shading_lpaths;
+    std::vector<ReversePath> shading_rpaths;
+  };
+
+  void GeneratePrimary(unsigned int width, size_t first, size_t last, RayQueue& rays);
+  void Extend(const RayQueue& rays,
+              HitQueue& hits,
+              RaySorter::Coherence& coherence,
+              float cost[]) const;
+  void ExtendPrimary(const RayQueue& rays, HitQueue& hits, float cost[]) const;
+  void SampleLights(const RayQueue& rays,
+                    const HitQueue& hits,
+                    Scratch& scratch,
+                    ShadowQueue& shadows);
+  // `depth' is the number of the path vertices at the hits
+  void Shade(const RayQueue& rays,
+             const HitQueue& hits,
+             Scratch& scratch,
+             size_t depth,
+             RayQueue& next_rays,
+             Eigen::Vector3f radiance[]);
+  void TraceShadows(const ShadowQueue& shadows, Eigen::Vector3f radiance[], float cost[]) const;
+
+private:
+  MonteCarlo::Options m_options;
+  BxDF m_bxdf;
+
+  std::reference_wrapper<const Object> m_associated_object;
+
+  Eigen::Matrix3f m_intrin_inv;
+  RayCaster m_ray_caster;
+  RaySorter m_ray_sorter;
+  PathTracer m_path_tracer;
+  LightSampler m_light_sampler;
+
+  Uniform<float> m_uni_subpixel;
+  Uniform<double> m_russian_roulette;
+};
+
+}  // namespace mcpt
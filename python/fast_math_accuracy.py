@@ -0,0 +1,121 @@
+import numpy as np
+
+from sample_hemisphere import CosinePowerHemisphere
+
+# numpy ports of the kernels in mcpt/common/fast_math.hpp, evaluated in single precision
+
+F = np.float32
+
+
+def Log2(x):
+    x = np.asarray(x, dtype=F)
+    bits = x.view(np.int32)
+    e = (bits - np.int32(0x3F3504F3)) >> 23
+    m = (bits - e * np.int32(1 << 23)).view(F)
+    s = (m - F(1.0)) / (m + F(1.0))
+    s2 = s * s
+    p = F(0.3205988979753252)
+    for c in [0.4121985831111324, 0.5770780163555853, 0.9617966939259756, 2.8853900817779268]:
+        p = F(c) + s2 * p
+    return e.astype(F) + s * p
+
+
+def Exp2(x):
+    x = np.asarray(x, dtype=F)
+    i = (x + np.where(x < 0.0, F(-0.5), F(0.5))).astype(np.int32)
+    f = x - i.astype(F)
+    i = np.clip(i, -127, 127)
+    p = F(1.525273380405984e-05)
+    for c in [
+        0.0001540353039338161,
+        0.0013333558146428443,
+        0.009618129107628477,
+        0.05550410866482158,
+        0.2402265069591007,
+        0.6931471805599453,
+        1.0,
+    ]:
+        p = F(c) + f * p
+    return p * ((i + np.int32(127)) << 23).view(F)
+
+
+def Pow(x, y):
+    x = np.asarray(x, dtype=F)
+    y = np.asarray(y, dtype=F)
+    with np.errstate(divide="ignore", invalid="ignore"):
+        r = Exp2(y * Log2(x))
+    return np.where((x > 0.0) | (y == 0.0), r, F(0.0))
+
+
+def SinCos(x):
+    x = np.asarray(x, dtype=F)
+    k_f = x * F(0.6366197723675814)
+    k = (k_f + np.where(k_f < 0.0, F(-0.5), F(0.5))).astype(np.int32)
+    k_f = k.astype(F)
+    r = ((x - k_f * F(1.5703125)) - k_f * F(4.837512969970703125e-4)) - k_f * F(
+        7.54978995489188216e-8
+    )
+    r2 = r * r
+    sin_p = F(2.755731922398589e-6)
+    for c in [-1.984126984126984e-4, 8.333333333333333e-3, -1.6666666666666666e-1]:
+        sin_p = F(c) + r2 * sin_p
+    cos_p = F(2.48015873015873e-5)
+    for c in [-1.388888888888889e-3, 4.1666666666666664e-2, -0.5, 1.0]:
+        cos_p = F(c) + r2 * cos_p
+    sin_r = r + r * r2 * sin_p
+    cos_r = cos_p
+    swap = (k & 1) == 1
+    s = np.where(swap, cos_r, sin_r)
+    c = np.where(swap, sin_r, cos_r)
+    return np.where(k & 2, -s, s), np.where((k + 1) & 2, -c, c)
+
+
+def Check(name, error, bound):
+    print(f"{name:8s} max error = {error:.3e}, bound = {bound:.1e}")
+    assert error < bound, name
+
+
+def main():
+    # every normal float, in steps of 97 ulps
+    bits = np.arange(0x00800000, 0x7F800000, 97, dtype=np.int32)
+    x = bits.view(F)
+    expected = np.log2(x.astype(np.float64))
+    error = np.abs(Log2(x) - expected) / np.maximum(1.0, np.abs(expected))
+    Check("log2", error.max(), 2.0e-7)
+
+    x = np.linspace(-125.9, 127.4, 10000000).astype(F)
+    expected = np.exp2(x.astype(np.float64))
+    Check("exp2", (np.abs(Exp2(x) - expected) / expected).max(), 2.0e-7)
+    assert Exp2(-200.0) == 0.0 and Pow(0.0, 2.0) == 0.0 and Pow(0.0, 0.0) == 1.0
+
+    # the error relative to the bound growing with the exponent, on the cosines of the BxDFs
+    x = np.linspace(1.0e-5, 1.0, 100000).astype(F)
+    ratio = 0.0
+    for y in [0.5, 1.0, 2.0, 7.3, 50.0, 1000.0]:
+        expected = np.power(x.astype(np.float64), y)
+        valid = expected > 1.0e-37
+        error = np.abs(Pow(x, y) - expected) / np.where(valid, expected, 1.0)
+        bound = 4.0e-7 + 2.0e-7 * np.abs(y * np.log2(x.astype(np.float64)))
+        ratio = max(ratio, (error / bound)[valid].max())
+    Check("pow", ratio, 1.0)
+
+    x = np.linspace(-8192.0, 8192.0, 20000000).astype(F)
+    sin, cos = SinCos(x)
+    error = np.maximum(
+        np.abs(sin - np.sin(x.astype(np.float64))), np.abs(cos - np.cos(x.astype(np.float64)))
+    )
+    Check("sincos", error.max(), 2.0e-7)
+
+    # the cosine power samples in cos/sin space follow the CDF 1-cos^(a+1)
+    np.random.seed(0)
+    for alpha in [0.0, 1.0, 5.0, 100.0]:
+        cos_azi, sin_azi, cos_dpr, sin_dpr, pdf = CosinePowerHemisphere(1000000, alpha)
+        assert np.allclose(cos_dpr**2 + sin_dpr**2, 1.0)
+        assert np.allclose(pdf, (alpha + 1.0) * np.power(cos_dpr, alpha) / (2.0 * np.pi))
+        cdf = 1.0 - np.power(np.sort(cos_dpr)[::-1], alpha + 1.0)
+        ks = np.abs(cdf - np.arange(1, cdf.size + 1) / cdf.size).max()
+        Check(f"cos^{alpha:g}", ks, 2.0e-3)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,15 +6,19 @@ TWO_PI = 2.0 * np.pi
 HALF_PI = np.pi / 2.0
 
 
+# the samples are kept as the cosines & sines of their azimuths & depressions, without acos
+
+
 def UniformHemisphere(n: int):
     u1 = np.random.rand(n)
     u2 = np.random.rand(n)
     # [0, 2pi)
     azi = 2.0 * np.pi * u1
-    # [0, pi/2)
-    dpr = np.arccos(1.0 - u2)
+    # [0, pi/2), cos = 1 - u2
+    cos_dpr = 1.0 - u2
+    sin_dpr = np.sqrt(u2 * (2.0 - u2))
     # PDF = 1.0 / (2pi)
-    return azi, dpr, 1.0 / TWO_PI
+    return np.cos(azi), np.sin(azi), cos_dpr, sin_dpr, 1.0 / TWO_PI
 
 
 def CosineHemisphere(n: int):
@@ -22,31 +26,33 @@ def CosineHemisphere(n: int):
     u2 = np.random.rand(n)
     # [0, 2pi)
     azi = 2.0 * np.pi * u1
-    # [0, pi/2)
-    dpr = np.arcsin(np.sqrt(u2))
+    # [0, pi/2), sin = sqrt(u2)
+    cos_dpr = np.sqrt(1.0 - u2)
+    sin_dpr = np.sqrt(u2)
     # PDF = cos(depression) / pi
-    pdf = np.cos(dpr) / np.pi
-    return azi, dpr, pdf
+    pdf = cos_dpr / np.pi
+    return np.cos(azi), np.sin(azi), cos_dpr, sin_dpr, pdf
 
 
 def CosinePowerHemisphere(n: int, alpha: float):
     alpha_1 = alpha + 1.0
     u1 = np.random.rand(n)
-    u2 = np.random.rand(n)
+    u2_1 = 1.0 - np.random.rand(n)
     # [0, 2pi)
     azi = 2.0 * np.pi * u1
-    # [0, pi/2)
-    dpr = np.arccos(np.power(1.0 - u2, 1.0 / alpha_1))
-    # PDF = (a+1)cos^a(depression)/(2pi)
-    pdf = alpha_1 * np.power(np.cos(dpr), alpha) / TWO_PI
-    return azi, dpr, pdf
+    # [0, pi/2), cos = (1-u2)^(1/(a+1))
+    cos_dpr = np.power(u2_1, 1.0 / alpha_1)
+    sin_dpr = np.sqrt(np.maximum(0.0, 1.0 - cos_dpr * cos_dpr))
+    # PDF = (a+1)cos^a(depression)/(2pi) = (a+1)(1-u2)/(2pi cos(depression))
+    pdf = alpha_1 * u2_1 / (TWO_PI * cos_dpr)
+    return np.cos(azi), np.sin(azi), cos_dpr, sin_dpr, pdf
 
 
 def MakePoints(gen: callable, count: int, **kwargs):
-    azi, dpr, pdf = gen(count, **kwargs)
-    xs = np.multiply(np.sin(dpr), np.cos(azi))
-    ys = np.multiply(np.sin(dpr), np.sin(azi))
-    zs = np.cos(dpr)
+    cos_azi, sin_azi, cos_dpr, sin_dpr, pdf = gen(count, **kwargs)
+    xs = np.multiply(sin_dpr, cos_azi)
+    ys = np.multiply(sin_dpr, sin_azi)
+    zs = cos_dpr
     return xs, ys, zs, pdf
 
 
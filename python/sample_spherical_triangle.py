@@ -0,0 +1,64 @@
+import sys
+
+import matplotlib as mpl
+import matplotlib.pyplot as plt
+import numpy as np
+
+
+def Normalize(vs):
+    return vs / np.linalg.norm(vs, axis=0)
+
+
+def Area(a, b, c):
+    # tan(area/2) = |a.(b x c)| / (1 + a.b + b.c + c.a)
+    triple = np.abs(np.dot(a, np.cross(b, c)))
+    return 2.0 * np.arctan2(triple, 1.0 + np.dot(a, b) + np.dot(b, c) + np.dot(c, a))
+
+
+def UniformSphericalTriangle(n: int, a, b, c):
+    # Arvo, "Stratified Sampling of Spherical Triangles"
+    area = Area(a, b, c)
+    cos_alpha = np.dot(Normalize(np.cross(a, b)), Normalize(np.cross(a, c)))
+    sin_alpha = np.sqrt(1.0 - cos_alpha * cos_alpha)
+
+    # point c' on the arc ac
+    area_hat = np.random.rand(n) * area
+    s = np.sin(area_hat - np.arccos(cos_alpha))
+    t = np.cos(area_hat - np.arccos(cos_alpha))
+    u = t - cos_alpha
+    v = s + sin_alpha * np.dot(a, b)
+    q = np.clip(((v * t - u * s) * cos_alpha - v) / ((v * s + u * t) * sin_alpha), -1.0, 1.0)
+    c_ortho = Normalize(c - np.dot(c, a) * a)
+    c_hat = np.outer(a, q) + np.outer(c_ortho, np.sqrt(1.0 - q * q))
+
+    # point on the arc bc'
+    z = 1.0 - np.random.rand(n) * (1.0 - np.dot(b, c_hat))
+    c_hat_ortho = Normalize(c_hat - np.outer(b, np.dot(b, c_hat)))
+    return Normalize(np.outer(b, z) + c_hat_ortho * np.sqrt(1.0 - z * z)), 1.0 / area
+
+
+def main():
+    assert len(sys.argv) == 2
+    n = int(sys.argv[1])
+
+    mpl.use("Qt5Agg")
+
+    fig, ax = plt.subplots(subplot_kw={"projection": "3d"})
+    fig.tight_layout()
+
+    # plot triangle projected onto the unit sphere
+    a, b, c = Normalize(np.random.rand(3, 3) - 0.5).T
+    ax.plot_trisurf(*np.stack([a, b, c], axis=1), alpha=0.1)
+
+    # plot uniform spherical triangle samples
+    pts, pdf = UniformSphericalTriangle(n, a, b, c)
+    ax.scatter(pts[0], pts[1], pts[2], s=0.5, marker=".")
+    ax.set_title(f"PDF = {pdf:.4f}")
+
+    # show plot
+    ax.set(xlabel="X", ylabel="Y", zlabel="Z", aspect="equal")
+    plt.show()
+
+
+if __name__ == "__main__":
+    main()
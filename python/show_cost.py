@@ -0,0 +1,36 @@
+import sys
+
+import matplotlib.pyplot as plt
+import numpy as np
+
+
+def ReadPFM(path: str):
+    with open(path, "rb") as f:
+        magic = f.readline().strip()
+        assert magic in (b"PF", b"Pf"), f"not a PFM image: {path}"
+        w, h = map(int, f.readline().split())
+        scale = float(f.readline())
+        dtype = "<f4" if scale < 0.0 else ">f4"
+        channels = 3 if magic == b"PF" else 1
+        im = np.fromfile(f, dtype=dtype, count=w * h * channels)
+    # rows are stored from bottom to top
+    return np.flipud(im.reshape(h, w, channels).squeeze())
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f"usage: {sys.argv[0]} spp_N_cost.pfm")
+        sys.exit(1)
+
+    cost = ReadPFM(sys.argv[1])
+    print(f"{cost.shape[1]}x{cost.shape[0]} min: {cost.min()} max: {cost.max()} avg: {cost.mean()}")
+
+    fig, ax = plt.subplots()
+    heatmap = ax.imshow(cost, cmap="inferno")
+    fig.colorbar(heatmap, ax=ax, label="BVH nodes visited per sample")
+    ax.set_title(sys.argv[1])
+    plt.show()
+
+
+if __name__ == "__main__":
+    main()